@@ -45,6 +45,9 @@
 #ifndef LVR_ROS__COLORS_H_
 #define LVR_ROS__COLORS_H_
 
+#include <cstddef>
+#include <string>
+
 #include <std_msgs/ColorRGBA.h>
 
 namespace lvr_ros
@@ -53,6 +56,41 @@ namespace lvr_ros
 
   void getRainbowColor(float value, float& r, float& g, float& b);
 
+  /// Colormaps for scalar values, each one is sampled into a lookup table once
+  enum class Colormap
+  {
+    RAINBOW,
+    VIRIDIS,
+    MAGMA,
+    GRAY
+  };
+
+  /// Parses "rainbow", "viridis", "magma" or "gray", returns false for unknown names
+  bool getColormap(const std::string& name, Colormap& colormap);
+
+  /**
+   * @brief Computes the minimum and maximum of the finite values in one parallel pass
+   *
+   * @return false if there is no finite value
+   */
+  bool getFiniteRange(const float* values, size_t size, float& min, float& max);
+
+  /**
+   * @brief Maps the values to the colors of the colormap lookup table
+   *
+   * The minimum is mapped to the first and the maximum to the last color, values outside are clamped. Non-finite
+   * values get a transparent black, like getRainbowColor. Large inputs are processed in parallel.
+   *
+   * @param colors  Output with room for size colors
+   */
+  void applyColormap(
+    const float* values,
+    size_t size,
+    float min,
+    float max,
+    Colormap colormap,
+    std_msgs::ColorRGBA* colors);
+
 } /* namespace lvr_ros */
 
 #endif /* colors.h */
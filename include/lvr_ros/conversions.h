@@ -30,7 +30,10 @@
 #ifndef LVR_ROS_CONVERSIONS_H_
 #define LVR_ROS_CONVERSIONS_H_
 
+#include <algorithm>
+#include <limits>
 #include <map>
+#include <vector>
 
 #include <ros/ros.h>
 #include <ros/console.h>
@@ -71,6 +74,9 @@
 
 #include <sensor_msgs/point_cloud2_iterator.h>
 
+#include "lvr_ros/CompactMeshGeometry.h"
+#include "lvr_ros/CompressedPointCloud.h"
+
 
 namespace lvr_ros
 {
@@ -92,45 +98,128 @@ typedef std::vector <boost::shared_ptr<MaterialGroup>> GroupVector;
 typedef boost::shared_ptr <MaterialGroup> MaterialGroupPtr;
 
 
+/**
+ * @brief Maps the used handle indices below capacity to consecutive indices, in parallel blocks
+ *
+ * @param capacity  Upper bound of the handle indices
+ * @param contains  Returns whether the handle with the given index is used
+ * @param remap     New index of every handle index, unused handles are mapped to max uint32_t
+ *
+ * @return The number of used handles
+ */
+template<typename ContainsFunc>
+inline size_t compactHandleIndices(size_t capacity, ContainsFunc contains, std::vector<uint32_t>& remap)
+{
+  const size_t block_size = 4096;
+  const size_t num_blocks = (capacity + block_size - 1) / block_size;
+  std::vector<size_t> block_offsets(num_blocks + 1, 0);
+  remap.resize(capacity);
+
+  #pragma omp parallel for
+  for(size_t block = 0; block < num_blocks; block++)
+  {
+    const size_t end = std::min(capacity, (block + 1) * block_size);
+    for(size_t i = block * block_size; i < end; i++)
+    {
+      block_offsets[block + 1] += contains(i) ? 1 : 0;
+    }
+  }
+  for(size_t block = 0; block < num_blocks; block++)
+  {
+    block_offsets[block + 1] += block_offsets[block];
+  }
+
+  #pragma omp parallel for
+  for(size_t block = 0; block < num_blocks; block++)
+  {
+    const size_t end = std::min(capacity, (block + 1) * block_size);
+    uint32_t k = block_offsets[block];
+    for(size_t i = block * block_size; i < end; i++)
+    {
+      remap[i] = contains(i) ? k++ : std::numeric_limits<uint32_t>::max();
+    }
+  }
+  return block_offsets[num_blocks];
+}
+
+/**
+ * @brief Converts a HalfEdgeMesh to a MeshGeometry message
+ *
+ * Vertices and faces are written in handle order, deleted handles are skipped. Handles are only remapped if
+ * the mesh has deleted vertices. Vertex normals are only written if there is one for every vertex.
+ * All arrays are filled in parallel.
+ */
 template<typename CoordType>
 inline const mesh_msgs::MeshGeometry toMeshGeometry(
     const lvr2::HalfEdgeMesh<lvr2::BaseVector<CoordType>>& hem,
     const lvr2::VertexMap<lvr2::Normal<CoordType>>& normals = lvr2::VertexMap<lvr2::Normal<CoordType>>())
 {
   mesh_msgs::MeshGeometry mesh_msg;
-  mesh_msg.vertices.reserve(hem.numVertices());
-  mesh_msg.faces.reserve(hem.numFaces());
-  mesh_msg.vertex_normals.reserve(normals.numValues());
+  const size_t num_vertices = hem.numVertices();
+  const size_t vertex_capacity = hem.nextVertexIndex();
+  const size_t face_capacity = hem.nextFaceIndex();
+
+  // Without deleted vertices, the handle index is the message index
+  std::vector<uint32_t> vertex_remap;
+  const bool remap_vertices = vertex_capacity != num_vertices;
+  if(remap_vertices)
+  {
+    compactHandleIndices(
+      vertex_capacity,
+      [&hem](size_t i) { return hem.containsVertex(lvr2::VertexHandle(i)); },
+      vertex_remap);
+  }
 
-  lvr2::DenseVertexMap<size_t> new_indices;
-  new_indices.reserve(hem.numVertices());
+  std::vector<uint32_t> face_remap;
+  const size_t num_faces = compactHandleIndices(
+    face_capacity,
+    [&hem](size_t i) { return hem.containsFace(lvr2::FaceHandle(i)); },
+    face_remap);
 
-  size_t k = 0;
-  for(auto vH : hem.vertices())
+  const bool has_normals = normals.numValues() == num_vertices;
+  mesh_msg.vertices.resize(num_vertices);
+  mesh_msg.vertex_normals.resize(has_normals ? num_vertices : 0);
+  mesh_msg.faces.resize(num_faces);
+
+  #pragma omp parallel for
+  for(size_t i = 0; i < vertex_capacity; i++)
   {
-    new_indices.insert(vH, k++);
+    const lvr2::VertexHandle vH(i);
+    if(remap_vertices && vertex_remap[i] == std::numeric_limits<uint32_t>::max())
+    {
+      continue;
+    }
+    const size_t index = remap_vertices ? vertex_remap[i] : i;
+
     const auto& pi = hem.getVertexPosition(vH);
-    geometry_msgs::Point p;
+    geometry_msgs::Point& p = mesh_msg.vertices[index];
     p.x = pi.x; p.y = pi.y; p.z = pi.z;
-    mesh_msg.vertices.push_back(p);
-  }
 
-  for(auto fH : hem.faces())
-  {
-    mesh_msgs::TriangleIndices indices;
-    auto vHs = hem.getVerticesOfFace(fH);
-    indices.vertex_indices[0] = new_indices[vHs[0]];
-    indices.vertex_indices[1] = new_indices[vHs[1]];
-    indices.vertex_indices[2] = new_indices[vHs[2]];
-    mesh_msg.faces.push_back(indices);
+    if(has_normals)
+    {
+      const auto n = normals.get(vH);
+      if(n)
+      {
+        geometry_msgs::Point& v = mesh_msg.vertex_normals[index];
+        v.x = n->x; v.y = n->y; v.z = n->z;
+      }
+    }
   }
 
-  for(auto vH : hem.vertices())
+  #pragma omp parallel for
+  for(size_t i = 0; i < face_capacity; i++)
   {
-    const auto& n = normals[vH];
-    geometry_msgs::Point v;
-    v.x = n.x; v.y = n.y; v.z = n.z;
-    mesh_msg.vertex_normals.push_back(v);
+    if(face_remap[i] == std::numeric_limits<uint32_t>::max())
+    {
+      continue;
+    }
+    const auto vHs = hem.getVerticesOfFace(lvr2::FaceHandle(i));
+    mesh_msgs::TriangleIndices& indices = mesh_msg.faces[face_remap[i]];
+    for(int k = 0; k < 3; k++)
+    {
+      const size_t vertex_index = vHs[k].idx();
+      indices.vertex_indices[k] = remap_vertices ? vertex_remap[vertex_index] : vertex_index;
+    }
   }
 
   return mesh_msg;
@@ -152,6 +241,30 @@ inline const mesh_msgs::MeshGeometryStamped toMeshGeometryStamped(
     return mesh_msg;
 }
 
+/**
+ * @brief Copies the values of a dense map with the handles 0 to size - 1 by index, in parallel for large maps
+ *
+ * @return false if a handle is missing, e.g. because the mesh has deleted vertices. The output is incomplete then.
+ */
+inline bool copyDenseVertexCosts(const lvr2::DenseVertexMap<float>& costs, size_t size, float* output)
+{
+  bool complete = true;
+  #pragma omp parallel for reduction(&&:complete) if(size > 65536)
+  for(size_t i = 0; i < size; i++)
+  {
+    const auto value = costs.get(lvr2::VertexHandle(i));
+    if(value)
+    {
+      output[i] = *value;
+    }
+    else
+    {
+      complete = false;
+    }
+  }
+  return complete;
+}
+
 inline const mesh_msgs::MeshVertexCosts toVertexCosts(
     const lvr2::VertexMap<float>& costs,
     const size_t num_values,
@@ -159,6 +272,15 @@ inline const mesh_msgs::MeshVertexCosts toVertexCosts(
 {
   mesh_msgs::MeshVertexCosts costs_msg;
   costs_msg.costs.resize(num_values, default_value);
+
+  // Dense maps without gaps are copied by index instead of iterating the handles
+  const auto dense_costs = dynamic_cast<const lvr2::DenseVertexMap<float>*>(&costs);
+  if(dense_costs && dense_costs->numValues() <= num_values
+     && copyDenseVertexCosts(*dense_costs, dense_costs->numValues(), costs_msg.costs.data()))
+  {
+    return costs_msg;
+  }
+
   for(auto vH : costs){
     costs_msg.costs[vH.idx()] = costs[vH];
   }
@@ -184,12 +306,20 @@ inline const mesh_msgs::MeshVertexCostsStamped toVertexCostsStamped(
   return mesh_msg;
 }
 
+/// The costs in handle order, which matches the vertex order of toMeshGeometry
 inline const mesh_msgs::MeshVertexCosts toVertexCosts(const lvr2::DenseVertexMap<float>& costs)
 {
     mesh_msgs::MeshVertexCosts costs_msg;
-    costs_msg.costs.reserve(costs.numValues());
+    costs_msg.costs.resize(costs.numValues());
+    if(copyDenseVertexCosts(costs, costs.numValues(), costs_msg.costs.data()))
+    {
+        return costs_msg;
+    }
+
+    // Deleted vertices leave gaps, the values are compacted in handle order
+    size_t k = 0;
     for(auto vH : costs){
-        costs_msg.costs.push_back(costs[vH]);
+        costs_msg.costs[k++] = costs[vH];
     }
     return costs_msg;
 }
@@ -211,6 +341,42 @@ inline const mesh_msgs::MeshVertexCostsStamped toVertexCostsStamped(
     return mesh_msg;
 }
 
+/**
+ * @brief Converts several cost layers of one mesh at once
+ *
+ * The layers are converted in parallel, every layer with the same dense fast path as toVertexCosts.
+ *
+ * @param layers  The cost layers by name
+ *
+ * @return One message per layer, in the order of the layer names
+ */
+inline std::vector<mesh_msgs::MeshVertexCostsStamped> toVertexCostsStamped(
+    const std::map<std::string, lvr2::DenseVertexMap<float>>& layers,
+    const std::string& frame_id,
+    const std::string& uuid,
+    const ros::Time& stamp = ros::Time::now()
+    )
+{
+    std::vector<const std::pair<const std::string, lvr2::DenseVertexMap<float>>*> entries;
+    entries.reserve(layers.size());
+    for(const auto& layer : layers)
+    {
+        entries.push_back(&layer);
+    }
+
+    std::vector<mesh_msgs::MeshVertexCostsStamped> costs_msgs(entries.size());
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        costs_msgs[i].mesh_vertex_costs = toVertexCosts(entries[i]->second);
+        costs_msgs[i].uuid = uuid;
+        costs_msgs[i].type = entries[i]->first;
+        costs_msgs[i].header.frame_id = frame_id;
+        costs_msgs[i].header.stamp = stamp;
+    }
+    return costs_msgs;
+}
+
 
 bool fromMeshBufferToMeshGeometryMessage(
     const lvr2::MeshBufferPtr& buffer,
@@ -284,11 +450,26 @@ bool fromTriangleMeshToMeshBuffer(
     lvr2::MeshBuffer& buffer
 );
 
-/* TODO
-void removeDuplicates(lvr2::MeshBuffer& buffer);
+/**
+ * @brief Welds duplicate vertices of the mesh buffer, see weldVertices
+ *
+ * Vertices are only merged if their texture coordinates are equal. The faces are remapped to the welded
+ * vertices, normals, colors, texture coordinates and intensities are taken from the first merged vertex.
+ * All faces are kept, also those which degenerate, so that per-face channels stay valid. If a face index is
+ * out of range, an error is logged and the buffer is left unchanged.
+ *
+ * @param buffer   The mesh buffer
+ * @param epsilon  Spacing of the quantization grid, 0 merges only vertices with equal coordinates
+ *
+ * @return The number of removed vertices, 0 for invalid face indices
+ */
+size_t removeDuplicates(lvr2::MeshBuffer& buffer, float epsilon = 0);
 
-void removeDuplicates(mesh_msgs::TriangleMesh& mesh);
-*/
+/**
+ * @brief Welds duplicate vertices of the triangle mesh, like removeDuplicates for the mesh buffer, a mesh with
+ *        out of range face indices is left unchanged
+ */
+size_t removeDuplicates(mesh_msgs::TriangleMesh& mesh, float epsilon = 0);
 
 /**
  * @brief Creates a LVR-MeshBufferPointer from a file
@@ -388,6 +569,17 @@ void intensityToVertexRainbowColors(
  */
 void intensityToVertexRainbowColors(const std::vector<float>& intensity, mesh_msgs::TriangleMesh& mesh);
 
+/**
+ * @brief Replaces the vertex colors with the intensity values as rainbow colors, scaled to the finite intensities
+ *
+ * @param intensity           Intensity values, one per vertex
+ * @param mesh_vertex_colors  The vertex colors message, non-finite intensities are transparent
+ */
+void intensityToVertexRainbowColors(
+    const std::vector<float>& intensity,
+    mesh_msgs::MeshVertexColors& mesh_vertex_colors
+);
+
 bool fromPointCloud2ToPointBuffer(const sensor_msgs::PointCloud2& cloud, PointBuffer& buffer);
 
 /**
@@ -401,6 +593,66 @@ bool fromMeshGeometryMessageToMeshBuffer(
     const lvr2::MeshBufferPtr& buffer
 );
 
+/**
+ * @brief Encodes a mesh geometry in the compact format of lvr_ros::CompactMeshGeometry
+ *
+ * @param mesh_geometry      The mesh to encode, header and uuid are copied
+ * @param compact            The encoded mesh
+ * @param position_bits      Bits per quantized vertex coordinate, from 1 to 24
+ * @param normal_bits        Bits per octahedral normal component, from 1 to 16, 0 drops the normals
+ * @param compression_level  zstd compression level, 0 disables compression. Ignored if built without zstd.
+ *
+ * @return bool success status
+ */
+bool fromMeshGeometryToCompactMeshGeometry(
+    const mesh_msgs::MeshGeometryStamped& mesh_geometry,
+    lvr_ros::CompactMeshGeometry& compact,
+    int position_bits = 16,
+    int normal_bits = 10,
+    int compression_level = 3
+);
+
+/**
+ * @brief Decodes a mesh geometry from the compact format of lvr_ros::CompactMeshGeometry
+ *
+ * @param compact        The encoded mesh
+ * @param mesh_geometry  The decoded mesh, header and uuid are copied
+ *
+ * @return bool success status, false for malformed data or zstd data if built without zstd
+ */
+bool fromCompactMeshGeometryToMeshGeometry(
+    const lvr_ros::CompactMeshGeometry& compact,
+    mesh_msgs::MeshGeometryStamped& mesh_geometry
+);
+
+/**
+ * @brief Encodes a point cloud in the compressed format of lvr_ros::CompressedPointCloud
+ *
+ * @param cloud              The cloud to encode, row padding is dropped
+ * @param compressed         The encoded cloud
+ * @param compression_level  zstd compression level, 0 disables compression. Ignored if built without zstd.
+ *
+ * @return bool success status
+ */
+bool fromPointCloud2ToCompressedPointCloud(
+    const sensor_msgs::PointCloud2& cloud,
+    lvr_ros::CompressedPointCloud& compressed,
+    int compression_level = 3
+);
+
+/**
+ * @brief Decodes a point cloud from the compressed format of lvr_ros::CompressedPointCloud
+ *
+ * @param compressed  The encoded cloud
+ * @param cloud       The decoded cloud
+ *
+ * @return bool success status, false for malformed data or zstd data if built without zstd
+ */
+bool fromCompressedPointCloudToPointCloud2(
+    const lvr_ros::CompressedPointCloud& compressed,
+    sensor_msgs::PointCloud2& cloud
+);
+
 } // end namespace
 
 #endif /* LVR_ROS_CONVERSIONS_H_ */
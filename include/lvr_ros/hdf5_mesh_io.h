@@ -0,0 +1,229 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * hdf5_mesh_io.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+#ifndef LVR_ROS_HDF5_MESH_IO_H_
+#define LVR_ROS_HDF5_MESH_IO_H_
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <hdf5.h>
+
+#include <mesh_msgs/MeshGeometry.h>
+#include <mesh_msgs/MeshMaterials.h>
+#include <mesh_msgs/MeshVertexColors.h>
+#include <mesh_msgs/MeshTexture.h>
+
+#include <lvr2/io/MeshBuffer.hpp>
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Reads meshes in the LVR2 HDF5 layout directly into mesh messages.
+ *
+ * All datasets of a mesh are stored in the group `/meshes/<mesh_name>`:
+ *
+ *   vertices             float32 [n x 3]
+ *   indices              uint32  [m x 3]
+ *   vertex_normals       float32 [n x 3]      (optional)
+ *   vertex_colors        uint8   [n x 3]      (optional, float32 [n x 4] if written from messages)
+ *   texture_coordinates  float32 [n x 2|3]    (optional)
+ *   face_materials       uint32  [m]          (optional)
+ *   material_colors      uint8   [k x 3]      (optional)
+ *   material_textures    int32   [k]          (optional, -1 for untextured materials)
+ *   textures/<i>         uint8   [h x w x c]  (optional)
+ *
+ * Large datasets are read in blocks of rows which are aligned to the dataset chunks, so that
+ * every chunk is decompressed only once. The next block is read while the current one is
+ * converted in parallel. Contiguous and unfiltered datasets are memory mapped if enabled and
+ * converted without any intermediate copy.
+ */
+class Hdf5MeshReader
+{
+public:
+    /**
+     * @param filename    The HDF5 file to read
+     * @param mesh_name   Name of the mesh group below `/meshes`
+     * @param block_rows  Number of rows read at once from chunked or filtered datasets
+     * @param use_mmap    Memory map contiguous datasets instead of reading them
+     */
+    Hdf5MeshReader(
+        const std::string& filename,
+        const std::string& mesh_name,
+        size_t block_rows = 1 << 20,
+        bool use_mmap = true
+    );
+
+    ~Hdf5MeshReader();
+
+    Hdf5MeshReader(const Hdf5MeshReader&) = delete;
+    Hdf5MeshReader& operator=(const Hdf5MeshReader&) = delete;
+
+    /// Returns true, if the file and the mesh group could be opened
+    bool isOpen() const;
+
+    /// Reads vertices, faces and, if available, vertex normals
+    bool readGeometry(mesh_msgs::MeshGeometry& mesh_geometry);
+
+    /// Reads materials, face clusters per material and texture coordinates
+    bool readMaterials(mesh_msgs::MeshMaterials& mesh_materials);
+
+    /// Reads vertex colors, returns false if the mesh has none
+    bool readVertexColors(mesh_msgs::MeshVertexColors& mesh_vertex_colors);
+
+    /// Reads the per-vertex intensities of the point cloud, returns false if the mesh has none
+    bool readVertexIntensities(std::vector<float>& vertex_intensities);
+
+    /// Reads all textures of the mesh
+    bool readTextures(std::vector<mesh_msgs::MeshTexture>& textures, const std::string& mesh_uuid);
+
+    /// Reads a string attribute of the mesh group, e.g. the "uuid"
+    bool readAttribute(const std::string& name, std::string& value);
+
+    /// Reads an unsigned integer array attribute of the mesh group
+    bool readAttribute(const std::string& name, std::vector<uint32_t>& values);
+
+private:
+    bool hasDataset(const std::string& name) const;
+
+    bool datasetShape(const std::string& name, hsize_t& rows, hsize_t& cols) const;
+
+    H5T_class_t datasetClass(const std::string& name) const;
+
+    /// Returns false if a contiguous dataset extends beyond the end of the file
+    bool datasetInFile(hid_t dataset, hsize_t rows, hsize_t cols, size_t element_size) const;
+
+    bool attributeInfo(
+        const std::string& name,
+        H5T_class_t& type_class,
+        size_t& type_size,
+        hsize_t& num_elements
+    ) const;
+
+    template<typename T, typename BlockFunc>
+    bool readRows(const std::string& name, hid_t mem_type, BlockFunc block_func);
+
+    template<typename T, typename BlockFunc>
+    bool mapRows(hid_t dataset, hid_t mem_type, hsize_t rows, hsize_t cols, BlockFunc& block_func);
+
+    template<typename T, typename BlockFunc>
+    bool readBlocks(hid_t dataset, hid_t mem_type, int rank, hsize_t rows, hsize_t cols, BlockFunc& block_func);
+
+    hid_t file;
+    int file_descriptor;
+    std::string group_path;
+    size_t block_rows;
+    bool use_mmap;
+};
+
+/**
+ * @brief Writes a lvr2::MeshBuffer or mesh messages in the layout read by the Hdf5MeshReader.
+ *
+ * All datasets are chunked and, if a compression level greater than zero is given, shuffled and
+ * deflate compressed. The file is written to a temporary file first and moved to its final name
+ * on close(), so that readers never see a partially written mesh. With a library mutex, every call into
+ * the HDF5 library holds it, and it is released between the chunks of a dataset, so that other threads
+ * can read while a large mesh is written.
+ */
+class Hdf5MeshWriter
+{
+public:
+    /**
+     * @param filename           The HDF5 file to create
+     * @param mesh_name          Name of the mesh group below `/meshes`
+     * @param compression_level  Deflate level from 0 (no compression) to 9
+     * @param chunk_rows         Number of rows per chunk
+     * @param library_mutex      Serializes the calls into the HDF5 library with other threads, if given
+     */
+    Hdf5MeshWriter(
+        const std::string& filename,
+        const std::string& mesh_name,
+        int compression_level = 4,
+        size_t chunk_rows = 1 << 16,
+        std::mutex* library_mutex = nullptr
+    );
+
+    ~Hdf5MeshWriter();
+
+    Hdf5MeshWriter(const Hdf5MeshWriter&) = delete;
+    Hdf5MeshWriter& operator=(const Hdf5MeshWriter&) = delete;
+
+    /// Returns true, if the file and the mesh group could be created
+    bool isOpen() const;
+
+    /// Writes geometry, normals, colors, materials, texture coordinates and textures of the buffer
+    bool write(const lvr2::MeshBufferPtr& buffer);
+
+    /**
+     * @brief Writes mesh messages, so that the Hdf5MeshReader reads the same messages again.
+     *
+     * If the mesh has clusters, every face has to belong to exactly one of them and every cluster to a
+     * different material, as read by the Hdf5MeshReader. Only
+     * "mono8", "rgb8" and "rgba8" textures can be written.
+     */
+    bool write(
+        const mesh_msgs::MeshGeometry& mesh_geometry,
+        const mesh_msgs::MeshMaterials& mesh_materials,
+        const mesh_msgs::MeshVertexColors& mesh_vertex_colors,
+        const std::vector<float>& vertex_intensities,
+        const std::vector<mesh_msgs::MeshTexture>& textures
+    );
+
+    /// Writes a string attribute to the mesh group
+    bool writeAttribute(const std::string& name, const std::string& value);
+
+    /// Writes an unsigned integer array attribute to the mesh group
+    bool writeAttribute(const std::string& name, const std::vector<uint32_t>& values);
+
+    /// Closes the file and moves it to its final name, returns false if anything failed
+    bool close();
+
+private:
+    std::unique_lock<std::mutex> lockLibrary() const;
+
+    hid_t createGroup(const std::string& name);
+
+    bool writeDataset(
+        hid_t location,
+        const std::string& name,
+        hid_t mem_type,
+        const void* data,
+        const std::vector<hsize_t>& dims
+    );
+
+    hid_t file;
+    hid_t group;
+    std::string filename;
+    std::string tmp_filename;
+    int compression_level;
+    size_t chunk_rows;
+    std::mutex* library_mutex;
+    bool success;
+};
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_HDF5_MESH_IO_H_ */
@@ -0,0 +1,111 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * hdf5_to_msg.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+#ifndef LVR_ROS_HDF5_TO_MSG_H_
+#define LVR_ROS_HDF5_TO_MSG_H_
+
+#include <atomic>
+#include <future>
+#include <memory>
+
+#include <ros/ros.h>
+#include <ros/console.h>
+#include <mesh_msgs/GetGeometry.h>
+#include <mesh_msgs/GetMaterials.h>
+#include <mesh_msgs/GetTexture.h>
+#include <mesh_msgs/GetUUID.h>
+#include <mesh_msgs/GetVertexColors.h>
+
+#include <mesh_msgs/MeshGeometryStamped.h>
+#include <mesh_msgs/MeshMaterialsStamped.h>
+#include <mesh_msgs/MeshVertexColorsStamped.h>
+#include <mesh_msgs/MeshTexture.h>
+
+#include "lvr_ros/hdf5_mesh_io.h"
+
+namespace lvr_ros
+{
+
+/**
+ * Loads a pre-built mesh from an LVR2 HDF5 file and offers it the same way the reconstruction node offers
+ * its results: The MeshGeometry is published on a latched topic and all parts of the mesh are served via
+ * the get_geometry, get_materials, get_texture, get_vertex_colors and get_uuid services.
+ *
+ * The geometry is loaded and published first. Materials, vertex colors and textures are loaded in the
+ * background afterwards, services for these attributes wait until loading has finished.
+ */
+class Hdf5ToMsg
+{
+public:
+    Hdf5ToMsg();
+
+    /// Loads and publishes the geometry and starts loading the attributes, returns false on failure
+    bool load();
+
+private:
+
+    // Service callbacks
+    bool service_getGeometry(mesh_msgs::GetGeometry::Request& req, mesh_msgs::GetGeometry::Response& res);
+    bool service_getMaterials(mesh_msgs::GetMaterials::Request& req, mesh_msgs::GetMaterials::Response& res);
+    bool service_getTexture(mesh_msgs::GetTexture::Request& req, mesh_msgs::GetTexture::Response& res);
+    bool service_getUUID(mesh_msgs::GetUUID::Request& req, mesh_msgs::GetUUID::Response& res);
+    bool service_getVertexColors(mesh_msgs::GetVertexColors::Request& req, mesh_msgs::GetVertexColors::Response& res);
+
+    /// Loads materials, vertex colors and textures, is executed in the background
+    bool loadAttributes();
+
+    /// Waits until the attributes are loaded, returns false if loading failed
+    bool attributesLoaded();
+
+    // Node, Publishers, Parameters
+    ros::NodeHandle node_handle;
+    ros::Publisher mesh_geometry_publisher;
+    std::string input_file;
+    std::string mesh_name;
+    std::string frame_id;
+    int block_size;
+    bool use_mmap;
+
+    // Services
+    ros::ServiceServer srv_get_geometry_;
+    ros::ServiceServer srv_get_materials_;
+    ros::ServiceServer srv_get_texture_;
+    ros::ServiceServer srv_get_uuid_;
+    ros::ServiceServer srv_get_vertex_colors_;
+
+    // Loaded mesh, the reader is used sequentially: first the geometry, then the attributes
+    std::unique_ptr<Hdf5MeshReader> reader;
+    std::atomic<bool> geometry_loaded{false};
+    std::shared_future<bool> attributes_future;
+    bool has_vertex_colors = false;
+    std::string uuid;
+    mesh_msgs::MeshGeometryStamped mesh_geometry_stamped;
+    mesh_msgs::MeshMaterialsStamped mesh_materials_stamped;
+    mesh_msgs::MeshVertexColorsStamped mesh_vertex_colors_stamped;
+    std::vector<mesh_msgs::MeshTexture> textures;
+};
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_HDF5_TO_MSG_H_ */
@@ -0,0 +1,147 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mesh_bvh.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#ifndef LVR_ROS_MESH_BVH_H_
+#define LVR_ROS_MESH_BVH_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <geometry_msgs/Point.h>
+#include <geometry_msgs/Vector3.h>
+#include <mesh_msgs/MeshGeometry.h>
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Bounding volume hierarchy over the faces of a mesh for spatial queries
+ *
+ * The tree is built with the surface area heuristic evaluated over binned face centroids. Nodes are stored
+ * depth-first in one array, the left child of an inner node directly follows its parent. The triangles are
+ * copied in leaf order, so that a leaf is tested without further indirection.
+ *
+ * All queries are const and can be run concurrently.
+ */
+class MeshBvh
+{
+public:
+    /// An empty tree, all queries fail
+    MeshBvh();
+
+    /**
+     * @param mesh_geometry  The mesh, only its vertices and faces are used
+     * @param max_leaf_size  Maximum number of faces per leaf
+     */
+    explicit MeshBvh(const mesh_msgs::MeshGeometry& mesh_geometry, size_t max_leaf_size = 4);
+
+    /**
+     * @brief Finds the face closest to a point
+     *
+     * @param query         The query point
+     * @param max_distance  Only faces within this distance are found
+     * @param face          The index of the closest face
+     * @param closest       The closest point on the face
+     * @param distance      The distance to the closest point
+     *
+     * @return true if a face within max_distance has been found
+     */
+    bool closestPoint(
+        const geometry_msgs::Point& query,
+        double max_distance,
+        uint32_t& face,
+        geometry_msgs::Point& closest,
+        double& distance
+    ) const;
+
+    /**
+     * @brief Finds the first face hit by a ray
+     *
+     * @param origin        The origin of the ray
+     * @param direction     The direction of the ray, does not need to be normalized
+     * @param max_distance  Only hits within this distance from the origin are found
+     * @param face          The index of the hit face
+     * @param hit           The hit point
+     * @param distance      The distance from the origin to the hit point
+     *
+     * @return true if a face has been hit within max_distance
+     */
+    bool raycast(
+        const geometry_msgs::Point& origin,
+        const geometry_msgs::Vector3& direction,
+        double max_distance,
+        uint32_t& face,
+        geometry_msgs::Point& hit,
+        double& distance
+    ) const;
+
+    /// Appends the indices of all faces which intersect the axis aligned box to faces
+    void facesInBox(
+        const geometry_msgs::Point& min,
+        const geometry_msgs::Point& max,
+        std::vector<uint32_t>& faces
+    ) const;
+
+    /// Number of faces in the tree
+    size_t numFaces() const;
+
+    struct Vec3
+    {
+        float x, y, z;
+    };
+
+    struct Triangle
+    {
+        Vec3 a, b, c;
+    };
+
+private:
+    // 32 bytes, two nodes per cache line
+    struct Node
+    {
+        float min[3];
+        float max[3];
+        // First triangle of a leaf or index of the right child of an inner node
+        uint32_t offset;
+        // Number of triangles of a leaf, 0 for inner nodes
+        uint32_t count;
+    };
+
+    struct BuildFace
+    {
+        Vec3 min, max, centroid;
+        uint32_t index;
+    };
+
+    uint32_t build(std::vector<BuildFace>& faces, size_t begin, size_t end, size_t max_leaf_size);
+
+    std::vector<Node> nodes;
+    std::vector<Triangle> triangles;
+    std::vector<uint32_t> face_indices;
+};
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_MESH_BVH_H_ */
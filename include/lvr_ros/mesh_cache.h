@@ -0,0 +1,124 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mesh_cache.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+#ifndef LVR_ROS_MESH_CACHE_H_
+#define LVR_ROS_MESH_CACHE_H_
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <mesh_msgs/MeshGeometryStamped.h>
+#include <mesh_msgs/MeshMaterialsStamped.h>
+#include <mesh_msgs/MeshVertexColorsStamped.h>
+#include <mesh_msgs/MeshVertexCostsStamped.h>
+#include <mesh_msgs/MeshTexture.h>
+#include <sensor_msgs/CompressedImage.h>
+
+#include "lvr_ros/MeshGeometryTile.h"
+#include "lvr_ros/mesh_bvh.h"
+
+namespace lvr_ros
+{
+
+/**
+ * All messages of one reconstructed mesh, as they are sent by the services.
+ *
+ * The messages are immutable once an entry is cached, entries are shared between the cache, the store and the
+ * services. Data derived from the messages is computed on first use and kept with the entry.
+ */
+struct MeshCacheEntry
+{
+    std::string uuid;
+    mesh_msgs::MeshGeometryStamped mesh_geometry_stamped;
+    mesh_msgs::MeshMaterialsStamped mesh_materials_stamped;
+    mesh_msgs::MeshVertexColorsStamped mesh_vertex_colors_stamped;
+    std::vector<mesh_msgs::MeshTexture> textures;
+
+    /// Point cloud intensity interpolated at every vertex, empty if the cloud had no intensities
+    std::vector<float> vertex_intensities;
+
+    /// Spatial tiles of the geometry, the mesh is partitioned once with the tile size of the first call
+    const std::vector<MeshGeometryTile>& geometryTiles(double tile_size) const;
+
+    /// Bounding volume hierarchy over the faces of the geometry, built on the first call
+    const MeshBvh& bvh() const;
+
+    /**
+     * A vertex cost layer of the geometry, see computeVertexCosts, or the "intensity" layer with the vertex
+     * intensities. Every layer is computed once, with the radius of its first request. Returns a null pointer
+     * for unknown or unavailable layers and for meshes with invalid faces.
+     */
+    mesh_msgs::MeshVertexCostsStampedConstPtr vertexCosts(const std::string& layer, double radius) const;
+
+    /**
+     * The texture at the given mipmap level, level 0 is the original texture. All levels of a texture are
+     * computed on the first request of a level greater than 0. Returns a null pointer for unknown textures.
+     *
+     * @param texture_index  Index of the texture
+     * @param level          The requested level, is clamped to the coarsest level
+     * @param num_levels     Number of levels of the texture
+     */
+    const mesh_msgs::MeshTexture* textureLevel(size_t texture_index, size_t& level, size_t& num_levels) const;
+
+    /**
+     * The texture level encoded as png, jpeg or webp, the encodings are computed once and cached up to a limit. The
+     * level is clamped like in textureLevel, jpeg and webp qualities are rounded to multiples of 10. Null if encoding
+     * failed.
+     */
+    sensor_msgs::CompressedImageConstPtr compressedTexture(
+        size_t texture_index,
+        size_t& level,
+        const std::string& format,
+        int quality
+    ) const;
+
+private:
+    mutable std::once_flag tiles_flag;
+    mutable std::vector<MeshGeometryTile> tiles;
+
+    mutable std::once_flag bvh_flag;
+    mutable MeshBvh face_bvh;
+
+    mutable std::mutex vertex_costs_mutex;
+    mutable std::map<std::string, mesh_msgs::MeshVertexCostsStampedConstPtr> vertex_costs;
+
+    mutable std::mutex mipmaps_mutex;
+    mutable std::map<size_t, boost::shared_ptr<const std::vector<mesh_msgs::MeshTexture>>> mipmaps;
+
+    typedef std::tuple<size_t, size_t, std::string, int> CompressedTextureKey;
+    mutable std::mutex compressed_textures_mutex;
+    mutable std::map<CompressedTextureKey, sensor_msgs::CompressedImageConstPtr> compressed_textures;
+};
+
+typedef boost::shared_ptr<MeshCacheEntry> MeshCacheEntryPtr;
+typedef boost::shared_ptr<const MeshCacheEntry> MeshCacheEntryConstPtr;
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_MESH_CACHE_H_ */
@@ -0,0 +1,117 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mesh_delta.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#ifndef LVR_ROS_MESH_DELTA_H_
+#define LVR_ROS_MESH_DELTA_H_
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <mesh_msgs/MeshGeometryStamped.h>
+
+#include "lvr_ros/MeshGeometryDelta.h"
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Encodes consecutive meshes as deltas to their predecessor
+ *
+ * Vertices are identified by their position rounded to a grid of the quantization size, faces by the
+ * identities of their vertices. Vertices and faces of the new mesh which were already part of the previous
+ * one are not transmitted again, only the normals of kept vertices which changed are. Removed elements are
+ * addressed by their index in the previous mesh. If the kept and added elements are not in the order of the new
+ * mesh, the delta contains the permutation to it, so that the subscribers end up with the mesh as it is cached.
+ *
+ * A keyframe with the complete mesh is encoded for the first mesh, if the frame changes, if the mesh gains or
+ * loses its normals, if the configured number of deltas has been sent or if a delta would change too much of the
+ * mesh to be worth it.
+ */
+class MeshDeltaEncoder
+{
+public:
+    /**
+     * @param quantization       Grid size to which vertex positions are rounded before they are compared
+     * @param keyframe_interval  Every n-th message is a keyframe, 0 only sends keyframes when necessary
+     * @param max_delta_ratio    A keyframe is sent if a delta changes more than this fraction of the mesh
+     */
+    MeshDeltaEncoder(double quantization = 0.001, int keyframe_interval = 10, double max_delta_ratio = 0.5);
+
+    /// Changes the parameters, the next message is a keyframe if the quantization changes
+    void setParameters(double quantization, int keyframe_interval, double max_delta_ratio);
+
+    /// Encodes the mesh as delta to the previously encoded mesh, or as keyframe if necessary or forced
+    MeshGeometryDelta encode(const mesh_msgs::MeshGeometryStamped& mesh, bool force_keyframe = false);
+
+    /// Forgets the previous mesh, the next message is a keyframe
+    void reset();
+
+private:
+    struct VertexKey
+    {
+        int64_t x, y, z;
+        // Distinguishes vertices at the same quantized position, e.g. duplicated texture seam vertices
+        uint32_t occurrence;
+
+        bool operator==(const VertexKey& other) const
+        {
+            return x == other.x && y == other.y && z == other.z && occurrence == other.occurrence;
+        }
+    };
+
+    struct VertexKeyHash
+    {
+        size_t operator()(const VertexKey& key) const;
+    };
+
+    typedef std::array<uint32_t, 3> Face;
+
+    struct FaceHash
+    {
+        size_t operator()(const Face& face) const;
+    };
+
+    std::vector<VertexKey> quantize(const std::vector<geometry_msgs::Point>& vertices) const;
+
+    MeshGeometryDelta encodeKeyframe(const mesh_msgs::MeshGeometryStamped& mesh, std::vector<VertexKey>& keys);
+
+    double quantization;
+    int keyframe_interval;
+    double max_delta_ratio;
+    int deltas_since_keyframe;
+
+    // The mesh as the subscribers see it after applying the last message
+    std::string uuid;
+    std::string frame_id;
+    std::vector<VertexKey> vertex_keys;
+    std::vector<geometry_msgs::Point> vertex_normals; // Empty if the mesh has no normals
+    std::vector<Face> faces;
+};
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_MESH_DELTA_H_ */
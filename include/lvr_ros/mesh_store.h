@@ -0,0 +1,125 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mesh_store.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+#ifndef LVR_ROS_MESH_STORE_H_
+#define LVR_ROS_MESH_STORE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <std_msgs/Header.h>
+
+#include "lvr_ros/mesh_cache.h"
+
+namespace lvr_ros
+{
+
+/**
+ * Persistent on-disk store of finished reconstructions, keyed by their UUID.
+ *
+ * Every mesh is written to "<directory>/<uuid>.h5" by a background thread, so that storing never delays the
+ * reconstruction. The messages of the cache entry are written as they are served, including packed texture
+ * atlases and colormapped vertex colors, so that a mesh loaded from disk answers all requests like before.
+ * Until a mesh is on disk, its cache entry is kept in memory. If the disk falls behind and too many meshes are
+ * pending, new meshes are not stored. Meshes which could not be written are dropped. The directory is indexed
+ * when the writer starts, meshes are only read from disk when they are requested. The most recently loaded
+ * meshes are kept in memory. Beyond the maximum number of stored meshes, the oldest files are removed.
+ */
+class MeshStore
+{
+public:
+    /**
+     * @param directory          Directory of the mesh files, is created if it does not exist
+     * @param compression_level  Deflate level from 0 (no compression) to 9
+     * @param max_loaded         Number of meshes loaded from disk that are kept in memory
+     * @param max_pending        Number of meshes waiting to be written, further meshes are not stored
+     * @param max_stored         Number of meshes kept in the directory, 0 keeps all of them
+     */
+    MeshStore(
+        const std::string& directory,
+        int compression_level,
+        size_t max_loaded,
+        size_t max_pending,
+        size_t max_stored
+    );
+
+    /// Writes all pending meshes before returning
+    ~MeshStore();
+
+    /// Queues the mesh for writing, returns immediately, false if the queue is full
+    bool store(const MeshCacheEntryConstPtr& entry);
+
+    /// Returns the cache entry of the mesh with the given uuid or a null pointer if it is unknown
+    MeshCacheEntryConstPtr load(const std::string& uuid);
+
+private:
+    void writerLoop();
+
+    bool write(const MeshCacheEntry& entry);
+
+    MeshCacheEntryConstPtr read(const std::string& uuid);
+
+    void indexDirectory();
+
+    /// Removes the oldest mesh files beyond the maximum number of stored meshes
+    void enforceRetention();
+
+    std::string filename(const std::string& uuid) const;
+
+    std::string directory;
+    int compression_level;
+    size_t max_loaded;
+    size_t max_pending;
+    size_t max_stored;
+
+    // The HDF5 library is not thread safe, its calls are serialized. A read holds the mutex until the mesh is
+    // loaded, the writer only for one chunk of a dataset at a time.
+    std::mutex hdf5_mutex;
+
+    std::mutex mutex;
+    std::condition_variable queue_condition;
+    std::deque<MeshCacheEntryConstPtr> queue;
+    std::map<std::string, MeshCacheEntryConstPtr> pending;
+    std::set<std::string> index;
+    std::deque<std::string> stored; // uuids of the indexed meshes, oldest first
+    std::list<MeshCacheEntryConstPtr> loaded;
+    bool indexed;
+    bool running;
+    std::thread writer;
+};
+
+typedef boost::shared_ptr<MeshStore> MeshStorePtr;
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_MESH_STORE_H_ */
@@ -0,0 +1,71 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mesh_tiles.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+#ifndef LVR_ROS_MESH_TILES_H_
+#define LVR_ROS_MESH_TILES_H_
+
+#include <vector>
+
+#include <geometry_msgs/Point.h>
+#include <mesh_msgs/MeshGeometry.h>
+
+#include "lvr_ros/MeshGeometryTile.h"
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Partitions a mesh into cubic tiles with the given edge length
+ *
+ * Every face is assigned to the tile which contains its centroid. Vertices shared by faces of different tiles
+ * are duplicated, so that every tile can be rendered on its own. The tiles are ordered by their grid cell.
+ *
+ * @param mesh_geometry  The mesh to partition
+ * @param tile_size      Edge length of the tiles
+ *
+ * @return The non-empty tiles of the mesh
+ */
+std::vector<MeshGeometryTile> partitionMeshGeometry(
+    const mesh_msgs::MeshGeometry& mesh_geometry,
+    double tile_size
+);
+
+/**
+ * @brief Selects all tiles whose bounding box intersects the given box
+ *
+ * @param tiles  The tiles of a mesh
+ * @param min    Minimum corner of the box, all tiles are selected if it is greater than max in any dimension
+ * @param max    Maximum corner of the box
+ *
+ * @return Indices of the selected tiles, ordered by the distance of the tile center to the center of the box
+ */
+std::vector<size_t> selectMeshTiles(
+    const std::vector<MeshGeometryTile>& tiles,
+    const geometry_msgs::Point& min,
+    const geometry_msgs::Point& max
+);
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_MESH_TILES_H_ */
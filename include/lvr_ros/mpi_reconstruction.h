@@ -0,0 +1,72 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mpi_reconstruction.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+
+#ifndef LVR_ROS_MPI_RECONSTRUCTION_H_
+#define LVR_ROS_MPI_RECONSTRUCTION_H_
+
+#include <lvr2/io/MeshBuffer.hpp>
+#include <lvr2/io/PointBuffer.hpp>
+
+#include "lvr_ros/ReconstructionConfig.h"
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Initializes MPI for the distributed reconstruction
+ *
+ * Rank 0 runs the reconstruction node, all other ranks are tile workers.
+ *
+ * @return The rank of this process
+ */
+int initDistributedReconstruction(int& argc, char**& argv);
+
+/// Reconstructs the tiles sent by rank 0 until it stops the workers
+void runTileWorker();
+
+/// Stops the tile workers if called on rank 0 and finalizes MPI
+void finishDistributedReconstruction();
+
+/**
+ * @brief Reconstructs a mesh with all MPI ranks, called on rank 0
+ *
+ * The cloud is split into one tile per rank, every rank reconstructs its tile with reconstructMeshBuffer on a
+ * common voxel lattice, and the parts of the tile meshes within their tile cores are stitched together by
+ * welding the border vertices. Dangling clusters, contours, holes and planes are handled once on the stitched mesh
+ * with postProcessMeshBuffer, so these steps do not open the seams. Textures are not supported in the distributed
+ * mode.
+ *
+ * @return false if the reconstruction of rank 0 failed
+ */
+bool reconstructDistributed(
+    const ReconstructionConfig& config,
+    lvr2::PointBufferPtr& point_buffer,
+    lvr2::MeshBufferPtr& mesh_buffer
+);
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_MPI_RECONSTRUCTION_H_ */
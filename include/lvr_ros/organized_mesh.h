@@ -0,0 +1,64 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * organized_mesh.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#ifndef LVR_ROS_ORGANIZED_MESH_H_
+#define LVR_ROS_ORGANIZED_MESH_H_
+
+#include <lvr2/io/MeshBuffer.hpp>
+#include <sensor_msgs/PointCloud2.h>
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Meshes an organized point cloud in image space, without search tree and voxel grid
+ *
+ * Neighboring pixels are known from the image, so every cell of 2 x 2 pixels is split into up to two triangles
+ * of its valid pixels. An edge is only created between pixels whose distances to the sensor differ by at most
+ * max_depth_jump times the smaller distance, so that there are no faces across depth discontinuities. Cells
+ * with four pixels are split along the diagonal that gives more faces, the shorter one on a tie.
+ *
+ * The vertex normals are computed with integral images of the points: the normal of a pixel is the cross
+ * product of the differences of the mean points right and left of it and below and above it, in windows of
+ * normal_window pixels. They are oriented towards the sensor, so the cloud has to be in the sensor frame. The
+ * faces are oriented like the normals. Colors and intensities of the points are kept for the vertices.
+ *
+ * @param cloud           An organized cloud with float x, y and z fields, invalid pixels are NaN
+ * @param mesh_buffer     The mesh of the pixels which belong to a face
+ * @param max_depth_jump  Maximum relative difference of the distances of neighboring pixels
+ * @param normal_window   Number of pixels on either side of a pixel averaged for its normal
+ *
+ * @return false if the cloud is not organized or has no float coordinates
+ */
+bool organizedCloudToMeshBuffer(
+    const sensor_msgs::PointCloud2& cloud,
+    lvr2::MeshBuffer& mesh_buffer,
+    float max_depth_jump = 0.05f,
+    int normal_window = 3
+);
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_ORGANIZED_MESH_H_ */
@@ -28,10 +28,20 @@
 #include <actionlib/server/simple_action_server.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <ros/console.h>
 #include <dynamic_reconfigure/server.h>
 #include "lvr_ros/ReconstructionConfig.h"
 #include "lvr_ros/ReconstructAction.h"
+#include "lvr_ros/ReconstructBatchAction.h"
+#include "lvr_ros/PostProcessAction.h"
+#include "lvr_ros/GetClosestFaces.h"
+#include "lvr_ros/GetCompactGeometry.h"
+#include "lvr_ros/GetCompressedTexture.h"
+#include "lvr_ros/GetFacesInBox.h"
+#include "lvr_ros/GetGeometryTiles.h"
+#include "lvr_ros/GetRayIntersections.h"
+#include "lvr_ros/GetTextureLevel.h"
 #include <mesh_msgs/GetGeometry.h>
 #include <mesh_msgs/GetMaterials.h>
 #include <mesh_msgs/GetTexture.h>
@@ -49,6 +59,15 @@
 #include <lvr2/io/PointBuffer.hpp>
 #include <lvr2/io/MeshBuffer.hpp>
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "lvr_ros/mesh_delta.h"
+#include "lvr_ros/mesh_store.h"
+#include "lvr_ros/reconstruction_budget.h"
+
 
 namespace lvr_ros
 {
@@ -64,6 +83,7 @@ class Reconstruction
 {
 public:
     Reconstruction();
+    ~Reconstruction();
 
 private:
 
@@ -80,16 +100,68 @@ private:
      */
     void reconstruct(const lvr_ros::ReconstructGoalConstPtr& goal);
 
+    /**
+     * Reconstruct batch action callback
+     *
+     * Reconstructs the compressed clouds of the goal one after another. The next cloud is decompressed and converted
+     * and the previous mesh is cached and published while the current cloud is reconstructed. The result holds the
+     * UUIDs of all meshes in the order of the clouds.
+     */
+    void reconstructBatch(const lvr_ros::ReconstructBatchGoalConstPtr& goal);
+
+    /**
+     * Post process action callback
+     *
+     * Runs the selected optimization steps on the given mesh and caches the result under a new UUID, like the
+     * reconstruct action. Refining a mesh this way costs only the post processing time.
+     */
+    void postProcess(const lvr_ros::PostProcessGoalConstPtr& goal);
+
     // Service callbacks
     bool service_getGeometry(mesh_msgs::GetGeometry::Request& req, mesh_msgs::GetGeometry::Response& res);
+    bool service_getCompactGeometry(
+        lvr_ros::GetCompactGeometry::Request& req,
+        lvr_ros::GetCompactGeometry::Response& res
+    );
+    bool service_getGeometryTiles(
+        lvr_ros::GetGeometryTiles::Request& req,
+        lvr_ros::GetGeometryTiles::Response& res
+    );
+    bool service_getClosestFaces(
+        lvr_ros::GetClosestFaces::Request& req,
+        lvr_ros::GetClosestFaces::Response& res
+    );
+    bool service_getRayIntersections(
+        lvr_ros::GetRayIntersections::Request& req,
+        lvr_ros::GetRayIntersections::Response& res
+    );
+    bool service_getFacesInBox(
+        lvr_ros::GetFacesInBox::Request& req,
+        lvr_ros::GetFacesInBox::Response& res
+    );
     bool service_getMaterials(mesh_msgs::GetMaterials::Request& req, mesh_msgs::GetMaterials::Response& res);
     bool service_getTexture(mesh_msgs::GetTexture::Request& req, mesh_msgs::GetTexture::Response& res);
+    bool service_getCompressedTexture(
+        lvr_ros::GetCompressedTexture::Request& req,
+        lvr_ros::GetCompressedTexture::Response& res
+    );
+    bool service_getTextureLevel(
+        lvr_ros::GetTextureLevel::Request& req,
+        lvr_ros::GetTextureLevel::Response& res
+    );
     bool service_getUUID(mesh_msgs::GetUUID::Request& req, mesh_msgs::GetUUID::Response& res);
     bool service_getVertexColors(mesh_msgs::GetVertexColors::Request& req, mesh_msgs::GetVertexColors::Response& res);
+    bool service_getVertexCosts(mesh_msgs::GetVertexCosts::Request& req, mesh_msgs::GetVertexCosts::Response& res);
 
     // Subscriber callback
     void pointCloudCallback(const sensor_msgs::PointCloud2::ConstPtr& cloud);
 
+    /// Publishes the changes to the previously published mesh, if anybody listens
+    void publishMeshDelta(const mesh_msgs::MeshGeometryStamped& mesh_geometry_stamped);
+
+    /// A new subscriber of the delta topic has no base mesh, the next delta is a keyframe
+    void deltaSubscriberConnected(const ros::SingleSubscriberPublisher& publisher);
+
     /**
      * This method will generate
      *   - a TriangleMesh message
@@ -100,9 +172,38 @@ private:
      * Please note: For future versions, it is not intended to keep both messages around. TriangleMesh will be
      * discontinued in favor of the new message structure. To ensure a smooth transition between both APIs, this
      * version of LVR_ROS will be able to generate both messages.
+     *
+     * With a positive time budget in seconds, the resolution is chosen by the cost model to fit the budget. The
+     * chosen settings are returned in choice, if given.
      */
-    bool createMeshMessageFromPointCloud(const sensor_msgs::PointCloud2& cloud, mesh_msgs::TriangleMeshStamped& mesh);
-    bool createMeshBufferFromPointBuffer(PointBufferPtr& point_buffer, lvr2::MeshBufferPtr& mesh_buffer);
+    bool createMeshMessageFromPointCloud(
+        const sensor_msgs::PointCloud2& cloud,
+        mesh_msgs::TriangleMeshStamped& mesh,
+        MeshCacheEntryConstPtr& entry,
+        double time_budget = 0.0,
+        ReconstructionBudgetChoice* choice = nullptr
+    );
+    bool createMeshBufferFromPointBuffer(
+        const ReconstructionConfig& config,
+        PointBufferPtr& point_buffer,
+        lvr2::MeshBufferPtr& mesh_buffer
+    );
+
+    /**
+     * Converts the mesh buffer to the mesh messages, makes them the current cache entry and hands the mesh
+     * over to the result store. Returns a null pointer if the conversion failed.
+     */
+    MeshCacheEntryConstPtr cacheMeshBuffer(
+        const lvr2::MeshBufferPtr& mesh_buffer,
+        const std::string& uuid,
+        const std_msgs::Header& header
+    );
+
+    /// Returns the cached mesh or the stored one for older uuids, a null pointer if the uuid is unknown
+    MeshCacheEntryConstPtr findCacheEntry(const std::string& uuid);
+
+    /// The current parameters, copied under the lock as the reconfigure callback runs in parallel
+    ReconstructionConfig currentConfig();
 
     // Utility
     float *getStatsCoeffs(std::string filename) const;
@@ -110,32 +211,85 @@ private:
     typedef dynamic_reconfigure::Server <lvr_ros::ReconstructionConfig> DynReconfigureServer;
     typedef boost::shared_ptr <DynReconfigureServer> DynReconfigureServerPtr;
     typedef actionlib::SimpleActionServer<lvr_ros::ReconstructAction> ActionServer;
+    typedef actionlib::SimpleActionServer<lvr_ros::ReconstructBatchAction> BatchActionServer;
+    typedef actionlib::SimpleActionServer<lvr_ros::PostProcessAction> PostProcessActionServer;
     DynReconfigureServerPtr reconfigure_server_ptr;
     DynReconfigureServer::CallbackType callback_type;
 
+    /**
+     * Callback queues: services and reconfigure requests are answered by their own threads, so they are never
+     * blocked by the point cloud and action callbacks. The reconstruction queue serves the point clouds and the
+     * goals, the action servers execute the goals on threads of their own.
+     */
+    ros::CallbackQueue service_queue;
+    ros::CallbackQueue reconstruction_queue;
+    std::unique_ptr<ros::AsyncSpinner> service_spinner;
+    std::unique_ptr<ros::AsyncSpinner> reconstruction_spinner;
+
     // Node, Publishers, Subscribers, Config
     ros::NodeHandle node_handle;
+    ros::NodeHandle service_node_handle;
+    ros::NodeHandle reconstruction_node_handle;
     ros::Publisher mesh_publisher;          // Is used to publish old TriangleMesh
     ros::Publisher mesh_geometry_publisher; // Is used to publish new MeshGeometry
+    ros::Publisher mesh_geometry_delta_publisher; // Is used to publish changes of the MeshGeometry
+    ros::Publisher mesh_geometry_compact_publisher; // Is used to publish compact encoded MeshGeometry
+    ros::Publisher mesh_vertex_costs_publisher; // Is used to publish the vertex cost layers
     ros::Subscriber cloud_subscriber;
     ReconstructionConfig config;
+    std::mutex config_mutex;
 
     // ActionServer and Services
     ActionServer as_;
+    BatchActionServer as_batch_;
+    PostProcessActionServer as_post_process_;
     ros::ServiceServer srv_get_geometry_;
+    ros::ServiceServer srv_get_compact_geometry_;
+    ros::ServiceServer srv_get_geometry_tiles_;
+    ros::ServiceServer srv_get_closest_faces_;
+    ros::ServiceServer srv_get_ray_intersections_;
+    ros::ServiceServer srv_get_faces_in_box_;
     ros::ServiceServer srv_get_materials_;
     ros::ServiceServer srv_get_texture_;
+    ros::ServiceServer srv_get_compressed_texture_;
+    ros::ServiceServer srv_get_texture_level_;
     ros::ServiceServer srv_get_uuid_;
     ros::ServiceServer srv_get_vertex_colors_;
+    ros::ServiceServer srv_get_vertex_costs_;
 
     // ROS message cache
-    // Reconstruction will write these messages to cache, services will send them
-    bool cache_initialized = false;
-    mesh_msgs::MeshGeometryStamped cache_mesh_geometry_stamped;
-    mesh_msgs::MeshMaterialsStamped cache_mesh_materials_stamped;
-    mesh_msgs::MeshVertexColorsStamped cache_mesh_vertex_colors_stamped;
-    std::string cache_uuid;
-    std::vector<mesh_msgs::MeshTexture> cache_textures;
+    // Reconstruction will write the messages of the latest mesh to cache, services will send them
+    std::mutex cache_mutex;
+    MeshCacheEntryConstPtr cache_entry;
+
+    // Persistent store of all finished meshes, disabled if no store directory is configured
+    MeshStorePtr mesh_store;
+
+    // Reconstruction time estimates for time budgets, calibrated with every reconstruction
+    ReconstructionCostModel cost_model;
+
+    /**
+     * Holds one of the reconstructionThreads slots while it is in scope. The action servers have threads of their own
+     * and the batch goals convert and cache in the background, the slots bound the reconstructions of the point cloud
+     * callback and all actions together.
+     */
+    class ReconstructionSlot
+    {
+    public:
+        explicit ReconstructionSlot(Reconstruction& node);
+        ~ReconstructionSlot();
+    private:
+        Reconstruction& node;
+    };
+    std::mutex slot_mutex;
+    std::condition_variable slot_condition;
+    int free_reconstruction_slots = 1;
+
+    // Delta encoding of consecutive meshes for the delta topic, each delta is published under the lock, so
+    // subscribers receive the deltas in the order they were encoded
+    std::mutex delta_mutex;
+    MeshDeltaEncoder mesh_delta_encoder;
+    std::atomic<bool> delta_keyframe_requested{false};
 
 };
 
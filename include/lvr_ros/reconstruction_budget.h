@@ -0,0 +1,115 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_budget.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#ifndef LVR_ROS_RECONSTRUCTION_BUDGET_H_
+#define LVR_ROS_RECONSTRUCTION_BUDGET_H_
+
+#include <cstddef>
+#include <mutex>
+
+#include <lvr2/io/PointBuffer.hpp>
+
+namespace lvr_ros
+{
+
+/// Resolution of a reconstruction chosen for a time budget
+struct ReconstructionBudgetChoice
+{
+    float voxelsize;
+    size_t num_points;
+
+    /// Estimated time in seconds
+    double estimated_time;
+
+    /// False if even the cheapest resolution is estimated to exceed the budget
+    bool fits;
+};
+
+/**
+ * Linear model of the time from a converted point cloud to the cached mesh:
+ *
+ *   time = c0 + c1 * points + c2 * cells
+ *
+ * The number of voxel grid cells on the surface is estimated from the bounding box of the points and the voxel
+ * size. The coefficients start from rough defaults and are calibrated with every finished reconstruction by
+ * recursive least squares. Older jobs fade out, so the model follows changes of the load and of the other
+ * parameters. All methods are thread-safe.
+ */
+class ReconstructionCostModel
+{
+public:
+    /// @param forgetting  Weight of the previous jobs in every update, in (0, 1]
+    explicit ReconstructionCostModel(double forgetting = 0.95);
+
+    /// Estimated time in seconds for the given number of points, extent of their bounding box and voxel size
+    double estimate(size_t num_points, const float extent[3], float voxelsize) const;
+
+    /// Calibrates the model with the measured time of a finished reconstruction
+    void update(size_t num_points, const float extent[3], float voxelsize, double seconds);
+
+    /**
+     * @brief Chooses the finest resolution whose estimated time fits into the budget
+     *
+     * Starting at the given voxel size and all points, the voxel size grows in steps of sqrt(2) up to 16 times
+     * the given one. For every voxel size, the points are halved down to about one point per surface cell, but
+     * not below min_points. If nothing fits, the cheapest of these choices is returned.
+     */
+    ReconstructionBudgetChoice choose(
+        size_t num_points,
+        const float extent[3],
+        float voxelsize,
+        double budget,
+        size_t min_points
+    ) const;
+
+    /// Number of reconstructions the model has been calibrated with
+    size_t numSamples() const;
+
+private:
+    /// Estimate for the features, the lock has to be held
+    double estimateFeatures(const double x[3]) const;
+
+    mutable std::mutex mutex;
+    double forgetting;
+    double coefficients[3];
+    double covariance[3][3];
+    size_t num_samples = 0;
+};
+
+/**
+ * Estimated number of voxel grid cells on the surface within a bounding box of the given extent. The voxel size is
+ * clamped to a small positive minimum.
+ */
+double estimateSurfaceCells(const float extent[3], float voxelsize);
+
+/// Extent of the bounding box of the points of the buffer
+void pointBufferExtent(const lvr2::PointBufferPtr& point_buffer, float extent[3]);
+
+/// Keeps num_points evenly spread points of the buffer with their normals, colors and intensities
+lvr2::PointBufferPtr subsamplePointBuffer(const lvr2::PointBufferPtr& point_buffer, size_t num_points);
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_RECONSTRUCTION_BUDGET_H_ */
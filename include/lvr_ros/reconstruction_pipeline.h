@@ -0,0 +1,105 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_pipeline.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+
+#ifndef LVR_ROS_RECONSTRUCTION_PIPELINE_H_
+#define LVR_ROS_RECONSTRUCTION_PIPELINE_H_
+
+#include <functional>
+#include <string>
+
+#include <lvr2/geometry/BaseVector.hpp>
+#include <lvr2/geometry/BoundingBox.hpp>
+#include <lvr2/io/MeshBuffer.hpp>
+#include <lvr2/io/PointBuffer.hpp>
+
+#include "lvr_ros/PostProcessAction.h"
+#include "lvr_ros/ReconstructionConfig.h"
+
+namespace lvr_ros
+{
+
+/// Called with the name of every pipeline stage right before the stage starts
+typedef std::function<void(const std::string& stage)> ReconstructionStageCallback;
+
+/**
+ * @brief Reconstructs a mesh from a point cloud with the given configuration
+ *
+ * This is the complete pipeline of the reconstruction node, usable without a running node. The stages are
+ * "surface", "normals", "grid", "marching_cubes", "cleanup", "planes", "vertex_normals", "colors", "finalize"
+ * and "intensity", they are reported to the stage callback in this order. Normals are added to the point
+ * buffer if they have to be computed.
+ *
+ * @param config        The reconstruction parameters
+ * @param point_buffer  The point cloud
+ * @param mesh_buffer   The finalized mesh
+ * @param stage         Optional callback for the begin of every stage
+ * @param grid_bounds   Bounds of the voxel grid if valid, the bounding box of the points otherwise. Grids of
+ *                      tiles which are reconstructed separately line up if their minimum is on the same lattice.
+ *
+ * @return false if the configuration is not supported
+ */
+bool reconstructMeshBuffer(
+    const ReconstructionConfig& config,
+    lvr2::PointBufferPtr& point_buffer,
+    lvr2::MeshBufferPtr& mesh_buffer,
+    const ReconstructionStageCallback& stage = ReconstructionStageCallback(),
+    const lvr2::BoundingBox<lvr2::BaseVector<float>>& grid_bounds = lvr2::BoundingBox<lvr2::BaseVector<float>>()
+);
+
+/**
+ * @brief Runs optimization steps of the reconstruction on a finalized mesh
+ *
+ * Builds a HalfEdgeMesh from the mesh buffer, runs the steps of the goal on it with the parameters of the config
+ * and finalizes it again. Faces which are degenerate or would make the mesh non-manifold are skipped. The vertex
+ * normals are interpolated from the faces, the "intensity" channel is kept for the remaining vertices.
+ *
+ * @return false if the mesh is empty
+ */
+bool postProcessMeshBuffer(
+    const ReconstructionConfig& config,
+    const PostProcessGoal& goal,
+    lvr2::MeshBufferPtr& mesh_buffer
+);
+
+/**
+ * @brief Sets the parameter of the given name from its string representation
+ *
+ * @return false if the parameter is unknown or the value does not match its type
+ */
+bool setReconstructionParameter(ReconstructionConfig& config, const std::string& name, const std::string& value);
+
+/**
+ * @brief Loads the parameters of a flat parameter file like config/lvr_params.yaml on top of the defaults
+ *
+ * Parameters which are missing in the file keep their default values, unknown ones are reported and skipped.
+ *
+ * @return false if the file could not be read
+ */
+bool loadReconstructionConfig(const std::string& filename, ReconstructionConfig& config);
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_RECONSTRUCTION_PIPELINE_H_ */
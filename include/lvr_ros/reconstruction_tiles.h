@@ -0,0 +1,96 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_tiles.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+
+#ifndef LVR_ROS_RECONSTRUCTION_TILES_H_
+#define LVR_ROS_RECONSTRUCTION_TILES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lvr_ros
+{
+
+/// A part of a point cloud which is reconstructed on its own
+struct ReconstructionTile
+{
+    /// Core of the tile, infinite towards the outside of the cloud, the cores of all tiles are disjoint
+    float min[3];
+    float max[3];
+
+    /// Indices of the points in the core and in the overlap around it
+    std::vector<uint32_t> point_indices;
+};
+
+/// The part of a reconstructed mesh which belongs to a tile
+struct TileMesh
+{
+    std::vector<float> vertices;
+    std::vector<float> normals;
+    std::vector<float> intensities;
+    std::vector<uint32_t> faces;
+};
+
+/**
+ * @brief Splits a point cloud into tiles with about the same number of points
+ *
+ * The cloud is bisected recursively at the median of the longest axis of its points. Each tile gets the points
+ * within the overlap distance around its core as well, so the surfaces of neighboring tiles agree at the border.
+ *
+ * @param points      xyz of every point
+ * @param num_points  Number of points
+ * @param num_tiles   Number of tiles, at least 1
+ * @param overlap     Distance by which the points of a tile reach beyond its core
+ * @param tiles       The tiles
+ */
+void partitionPoints(
+    const float* points,
+    size_t num_points,
+    size_t num_tiles,
+    float overlap,
+    std::vector<ReconstructionTile>& tiles
+);
+
+/**
+ * @brief Extracts the faces of a tile mesh whose centroid lies in the core of the tile
+ *
+ * Every face of the stitched mesh is taken from exactly one tile this way. Only the vertices of the kept faces
+ * are copied, normals and intensities may be null.
+ */
+void cropTileMesh(
+    const ReconstructionTile& tile,
+    const float* vertices,
+    const float* normals,
+    const float* intensities,
+    size_t num_vertices,
+    const unsigned int* faces,
+    size_t num_faces,
+    TileMesh& mesh
+);
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_RECONSTRUCTION_TILES_H_ */
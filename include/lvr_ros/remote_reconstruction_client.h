@@ -0,0 +1,94 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * remote_reconstruction_client.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#ifndef LVR_ROS_REMOTE_RECONSTRUCTION_CLIENT_H_
+#define LVR_ROS_REMOTE_RECONSTRUCTION_CLIENT_H_
+
+#include <deque>
+
+#include <actionlib/client/simple_action_client.h>
+#include <ros/ros.h>
+#include <ros/console.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <std_msgs/String.h>
+
+#include "lvr_ros/ReconstructBatchAction.h"
+
+namespace lvr_ros
+{
+
+/**
+ * Robot side of a remote reconstruction: Collects numClouds point clouds, compresses them and sends them as one
+ * goal to the reconstruct_batch action of an off-board reconstruction node. The UUIDs of the resulting meshes are
+ * published on the mesh_uuid topic, the meshes are published and served by the reconstruction node. All of them
+ * can only be requested if the reconstruction node stores its results in a storeDirectory.
+ *
+ * Only one batch is reconstructed at a time. Batches completed in the meantime wait in a queue of up to
+ * maxPendingBatches batches, the oldest one is dropped if the worker can not keep up.
+ */
+class RemoteReconstructionClient
+{
+public:
+    RemoteReconstructionClient();
+
+private:
+    typedef actionlib::SimpleActionClient<lvr_ros::ReconstructBatchAction> BatchActionClient;
+
+    // Subscriber callback
+    void pointCloudCallback(const sensor_msgs::PointCloud2::ConstPtr& cloud);
+
+    // Action client callbacks
+    void batchDone(
+        const actionlib::SimpleClientGoalState& state,
+        const lvr_ros::ReconstructBatchResultConstPtr& result
+    );
+    void batchFeedback(const lvr_ros::ReconstructBatchFeedbackConstPtr& feedback);
+
+    /// Retries to send pending batches while the worker is not connected
+    void retryCallback(const ros::TimerEvent& event);
+
+    /// Sends the oldest pending batch if the worker is idle
+    void sendNextBatch();
+
+    // Node, Publishers, Subscribers, Parameters
+    ros::NodeHandle node_handle;
+    ros::Subscriber cloud_subscriber;
+    ros::Publisher uuid_publisher;
+    ros::Timer retry_timer;
+    int num_clouds;
+    int compression_level;
+    int max_pending_batches;
+
+    // All callbacks are called by the spinner of main, so the state needs no locking
+    BatchActionClient action_client;
+    lvr_ros::ReconstructBatchGoal current_batch;
+    std::deque<lvr_ros::ReconstructBatchGoal> pending_batches;
+    bool batch_active = false;
+    ros::WallTime batch_start;
+};
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_REMOTE_RECONSTRUCTION_CLIENT_H_ */
@@ -0,0 +1,96 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * textures.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#ifndef LVR_ROS_TEXTURES_H_
+#define LVR_ROS_TEXTURES_H_
+
+#include <string>
+#include <vector>
+
+#include <mesh_msgs/MeshGeometry.h>
+#include <mesh_msgs/MeshMaterials.h>
+#include <mesh_msgs/MeshTexture.h>
+#include <sensor_msgs/CompressedImage.h>
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Packs the textures of a mesh into a few large atlas pages
+ *
+ * The textures are placed on shelves, from the highest to the lowest one. Every texture is surrounded by a border
+ * of replicated edge texels, so that filtering does not bleed between neighbouring textures. The texture
+ * coordinates of all vertices of textured faces and the texture indices of the materials are rewritten to refer
+ * to the pages. Texture coordinates are expected relative to their texture, with v along the image rows.
+ *
+ * @param mesh_geometry   The faces of the mesh
+ * @param mesh_materials  Materials, clusters and texture coordinates of the mesh, rewritten for the pages
+ * @param textures        The textures of the mesh, replaced by the pages
+ * @param page_size       Edge length of the pages, larger textures get a page of their own
+ * @param padding         Width of the border around every texture
+ *
+ * @return false if the mesh is left unchanged, because a vertex is shared by faces with different textures or
+ *         the textures have different or unsupported encodings
+ */
+bool packTextureAtlas(
+    const mesh_msgs::MeshGeometry& mesh_geometry,
+    mesh_msgs::MeshMaterials& mesh_materials,
+    std::vector<mesh_msgs::MeshTexture>& textures,
+    int page_size,
+    int padding
+);
+
+/**
+ * @brief Creates the mipmap levels of a texture
+ *
+ * Every level halves the size of the previous one, rounded up, until a size of 1x1 is reached. The texels are
+ * averaged with an area filter.
+ *
+ * @param texture  The texture, with mono8, rgb8, bgr8, rgba8 or bgra8 encoding
+ *
+ * @return The levels from 1 to the 1x1 level, empty if the encoding is not supported
+ */
+std::vector<mesh_msgs::MeshTexture> createTextureMipmaps(const mesh_msgs::MeshTexture& texture);
+
+/**
+ * @brief Encodes a texture image as png, jpeg or webp
+ *
+ * @param texture  The texture to encode, with mono8, rgb8, bgr8, rgba8 or bgra8 encoding
+ * @param format   One of "png", "jpeg" or "webp"
+ * @param quality  jpeg and webp quality from 1 to 100, png compression level from 0 to 9
+ * @param image    The encoded image
+ *
+ * @return bool success status
+ */
+bool compressTexture(
+    const mesh_msgs::MeshTexture& texture,
+    const std::string& format,
+    int quality,
+    sensor_msgs::CompressedImage& image
+);
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_TEXTURES_H_ */
@@ -0,0 +1,105 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * trace.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+
+#ifndef LVR_ROS_TRACE_H_
+#define LVR_ROS_TRACE_H_
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Starts recording spans, a running recording is written to its file first
+ *
+ * The recording is kept in memory and written as Chrome trace event JSON, which can be opened with
+ * chrome://tracing or https://ui.perfetto.dev.
+ *
+ * @return false if the previous recording could not be written
+ */
+bool startTrace(const std::string& filename);
+
+/// Stops recording and writes the trace file, returns false if it could not be written
+bool stopTrace();
+
+/// Whether spans are recorded right now
+bool isTracing();
+
+/// Quotes the text and escapes it as JSON string, for trace events and the JSON reports of the benchmarks
+std::string jsonString(const std::string& text);
+
+/**
+ * @brief A span from construction to destruction on the current thread
+ *
+ * The name has to outlive the span, usually it is a string literal.
+ * Spans cost a single atomic load if no trace is recorded. Use the LVR_ROS_TRACE_* macros, which compile to
+ * nothing without LVR_ROS_TRACING.
+ */
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char* name);
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    /// Adds an argument which is shown with the span
+    void arg(const char* key, const std::string& value);
+    void arg(const char* key, double value);
+
+    template<typename Integer, typename = typename std::enable_if<std::is_integral<Integer>::value>::type>
+    void arg(const char* key, Integer value)
+    {
+        if (active)
+        {
+            appendArg(key, std::to_string(value));
+        }
+    }
+
+private:
+    /// Appends the key with the value, which already is formatted as JSON
+    void appendArg(const char* key, const std::string& json_value);
+
+    const char* name;
+    bool active;
+    int64_t start;
+    std::string args;
+};
+
+} // namespace lvr_ros
+
+#ifdef LVR_ROS_TRACING
+    #define LVR_ROS_TRACE_SPAN(span, name) lvr_ros::TraceSpan span(name)
+    #define LVR_ROS_TRACE_ARG(span, key, value) span.arg(key, value)
+#else
+    #define LVR_ROS_TRACE_SPAN(span, name)
+    #define LVR_ROS_TRACE_ARG(span, key, value)
+#endif
+
+#endif /* LVR_ROS_TRACE_H_ */
@@ -0,0 +1,71 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * vertex_costs.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#ifndef LVR_ROS_VERTEX_COSTS_H_
+#define LVR_ROS_VERTEX_COSTS_H_
+
+#include <string>
+#include <vector>
+
+#include <mesh_msgs/MeshGeometry.h>
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Splits a comma separated list of vertex cost layer names, unknown names are dropped with a warning
+ */
+std::vector<std::string> parseVertexCostLayers(const std::string& layers);
+
+/**
+ * @brief Computes a per-vertex cost layer of a mesh for navigation
+ *
+ * Supported layers, the z axis of the mesh frame is assumed to point up:
+ *   - "slope":       Angle between the vertex normal and the z axis in radians
+ *   - "roughness":   Mean angle between the vertex normal and the normals of all vertices within the radius
+ *   - "height_diff": Difference between the highest and the lowest vertex within the radius
+ *   - "border":      1 for vertices on the border of the mesh, 0 otherwise
+ *
+ * The neighborhood of a vertex consists of all vertices within the radius which are connected to it by edges
+ * within the radius. The given vertex normals are used if there is one per vertex, otherwise they are computed
+ * from the faces. The vertices are processed in parallel.
+ *
+ * @param mesh_geometry  The mesh
+ * @param layer          Name of the layer
+ * @param radius         Radius of the vertex neighborhood
+ * @param costs          The cost of every vertex
+ *
+ * @return false if the layer is unknown or the faces index vertices which do not exist
+ */
+bool computeVertexCosts(
+    const mesh_msgs::MeshGeometry& mesh_geometry,
+    const std::string& layer,
+    double radius,
+    std::vector<float>& costs
+);
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_VERTEX_COSTS_H_ */
@@ -0,0 +1,84 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * vertex_welding.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#ifndef LVR_ROS_VERTEX_WELDING_H_
+#define LVR_ROS_VERTEX_WELDING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Finds duplicate vertices of a mesh for welding
+ *
+ * Every vertex is rounded to the nearest point of a grid with the spacing epsilon, vertices rounded to the same
+ * point are merged. With an epsilon of 0 only vertices with equal coordinates are merged. Vertices with different
+ * attributes, e.g. texture coordinates on a seam, are never merged. The quantized keys are sorted in parallel, every group of
+ * equal keys is represented by its vertex with the lowest index, so the welded vertices keep their order.
+ *
+ * @param positions        xyz of every vertex
+ * @param num_vertices     Number of vertices
+ * @param epsilon          Spacing of the quantization grid
+ * @param attributes       Per-vertex attributes which have to be equal for merging, may be null
+ * @param attribute_width  Number of attribute values per vertex, at most 3
+ * @param remap            The index of every vertex in the welded mesh
+ * @param kept             The index of the representing vertex of every welded vertex
+ *
+ * @return The number of welded vertices
+ */
+size_t weldVertices(
+    const float* positions,
+    size_t num_vertices,
+    float epsilon,
+    const float* attributes,
+    unsigned attribute_width,
+    std::vector<uint32_t>& remap,
+    std::vector<uint32_t>& kept
+);
+
+/**
+ * @brief Gathers the values of the kept vertices from a per-vertex array with width values per vertex
+ *
+ * @param result  Output with room for kept.size() * width values
+ */
+template<typename T>
+void gatherVertexValues(const T* values, unsigned width, const std::vector<uint32_t>& kept, T* result)
+{
+    #pragma omp parallel for
+    for (size_t i = 0; i < kept.size(); i++)
+    {
+        for (unsigned k = 0; k < width; k++)
+        {
+            result[i * width + k] = values[static_cast<size_t>(kept[i]) * width + k];
+        }
+    }
+}
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_VERTEX_WELDING_H_ */
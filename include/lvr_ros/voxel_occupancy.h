@@ -0,0 +1,72 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * voxel_occupancy.h
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#ifndef LVR_ROS_VOXEL_OCCUPANCY_H_
+#define LVR_ROS_VOXEL_OCCUPANCY_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace lvr_ros
+{
+
+/// Numbers of voxels which contain points, for voxel sizes which double from level to level
+struct VoxelOccupancy
+{
+    /// Voxel size of level 0, the finest level
+    float voxelsize;
+
+    /// Number of occupied voxels of every level, the voxel size of level k is voxelsize * 2^k
+    std::vector<size_t> occupied;
+};
+
+/**
+ * @brief Counts the voxels occupied by the points for all voxel sizes from the finest level up to one voxel
+ *
+ * The points are sorted once by the Morton code of their voxel at the finest level, which divides the longest
+ * side of the bounding box into 2^20 voxels. The voxels of the coarser levels are the Morton code prefixes, so
+ * every further level only needs a linear pass over the occupied voxels of the previous one.
+ */
+void computeVoxelOccupancy(const float* points, size_t num_points, VoxelOccupancy& occupancy);
+
+/**
+ * @brief Estimates the voxel size at which about the given number of voxels is occupied
+ *
+ * The number of occupied voxels is interpolated log-linearly between the levels. The voxel size is limited to
+ * sizes at which there are on average at least two points per occupied voxel, finer voxels only add holes.
+ */
+float voxelsizeForOccupiedVoxels(const VoxelOccupancy& occupancy, size_t num_points, double occupied_voxels);
+
+/**
+ * @brief Estimates the voxel size at which marching cubes creates about the given number of faces
+ *
+ * Marching cubes creates about two faces per voxel the surface passes through, which are estimated by the
+ * voxels occupied by the points.
+ */
+float voxelsizeForTargetFaces(const float* points, size_t num_points, size_t target_faces);
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_VOXEL_OCCUPANCY_H_ */
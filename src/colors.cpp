@@ -45,6 +45,8 @@
 #include "lvr_ros/colors.h"
 #include <math.h>
 #include <algorithm>
+#include <array>
+#include <limits>
 #include <std_msgs/ColorRGBA.h>
 
 namespace lvr_ros
@@ -78,4 +80,162 @@ void getRainbowColor(float value, float &r, float &g, float &b)
   else if (i >= 5) r = 1, g = n, b = 0;
 }
 
+/// Number of colors of a lookup table
+static const size_t COLORMAP_SIZE = 1024;
+
+/// Values below this count are mapped without starting threads
+static const size_t PARALLEL_THRESHOLD = 1 << 16;
+
+typedef std::array<std_msgs::ColorRGBA, COLORMAP_SIZE> ColormapTable;
+
+/**
+ * Polynomial fits of the matplotlib colormaps with coefficients for r, g and b of degree 0 to 6,
+ * by Matt Zucker (https://www.shadertoy.com/view/WlfXRN)
+ */
+static const float VIRIDIS_COEFFS[7][3] = {
+  {0.2777273272234177f, 0.005407344544966578f, 0.3340998053353061f},
+  {0.1050930431085774f, 1.404613529898575f, 1.384590162594685f},
+  {-0.3308618287255563f, 0.214847559468213f, 0.09509516302823659f},
+  {-4.634230498983486f, -5.799100973351585f, -19.33244095627987f},
+  {6.228269936347081f, 14.17993336680509f, 56.69055260068105f},
+  {4.776384997670288f, -13.74514537774601f, -65.35303263337234f},
+  {-5.435455855934631f, 4.645852612178535f, 26.3124352495832f}
+};
+
+static const float MAGMA_COEFFS[7][3] = {
+  {-0.002136485053939582f, -0.000749655052795221f, -0.005386127855323933f},
+  {0.2516605407371642f, 0.6775232436837668f, 2.494026599312351f},
+  {8.353717279216625f, -3.577719514958484f, 0.3144679030132573f},
+  {-27.66873308576866f, 14.26473078096533f, -13.64921318813922f},
+  {52.17613981234068f, -27.94360607168351f, 12.94416944238394f},
+  {-50.76852536473588f, 29.04658282127291f, 4.23415299384598f},
+  {18.65570506591883f, -11.48977351997711f, -5.601961508734096f}
+};
+
+static float evaluatePolynomial(const float coeffs[7][3], int channel, float t)
+{
+  float value = 0;
+  for (int degree = 6; degree >= 0; degree--)
+  {
+    value = value * t + coeffs[degree][channel];
+  }
+  return std::min(std::max(value, 0.0f), 1.0f);
+}
+
+static ColormapTable createColormapTable(Colormap colormap)
+{
+  ColormapTable table;
+  for (size_t i = 0; i < COLORMAP_SIZE; i++)
+  {
+    const float t = static_cast<float>(i) / (COLORMAP_SIZE - 1);
+    std_msgs::ColorRGBA& color = table[i];
+    color.a = 1;
+    switch (colormap)
+    {
+      case Colormap::RAINBOW:
+        getRainbowColor(t, color.r, color.g, color.b);
+        break;
+      case Colormap::VIRIDIS:
+        color.r = evaluatePolynomial(VIRIDIS_COEFFS, 0, t);
+        color.g = evaluatePolynomial(VIRIDIS_COEFFS, 1, t);
+        color.b = evaluatePolynomial(VIRIDIS_COEFFS, 2, t);
+        break;
+      case Colormap::MAGMA:
+        color.r = evaluatePolynomial(MAGMA_COEFFS, 0, t);
+        color.g = evaluatePolynomial(MAGMA_COEFFS, 1, t);
+        color.b = evaluatePolynomial(MAGMA_COEFFS, 2, t);
+        break;
+      case Colormap::GRAY:
+        color.r = color.g = color.b = t;
+        break;
+    }
+  }
+  return table;
+}
+
+static const ColormapTable& getColormapTable(Colormap colormap)
+{
+  // Static locals are initialized once, even with concurrent callers
+  static const ColormapTable rainbow = createColormapTable(Colormap::RAINBOW);
+  static const ColormapTable viridis = createColormapTable(Colormap::VIRIDIS);
+  static const ColormapTable magma = createColormapTable(Colormap::MAGMA);
+  static const ColormapTable gray = createColormapTable(Colormap::GRAY);
+  switch (colormap)
+  {
+    case Colormap::VIRIDIS:
+      return viridis;
+    case Colormap::MAGMA:
+      return magma;
+    case Colormap::GRAY:
+      return gray;
+    default:
+      return rainbow;
+  }
+}
+
+bool getColormap(const std::string& name, Colormap& colormap)
+{
+  if (name == "rainbow")
+    colormap = Colormap::RAINBOW;
+  else if (name == "viridis")
+    colormap = Colormap::VIRIDIS;
+  else if (name == "magma")
+    colormap = Colormap::MAGMA;
+  else if (name == "gray")
+    colormap = Colormap::GRAY;
+  else
+    return false;
+  return true;
+}
+
+bool getFiniteRange(const float* values, size_t size, float& min, float& max)
+{
+  float range_min = std::numeric_limits<float>::max();
+  float range_max = std::numeric_limits<float>::lowest();
+
+  // Non-finite values are replaced by the neutral element, so that the loop stays branch free
+  #pragma omp parallel for reduction(min:range_min) reduction(max:range_max) if(size > PARALLEL_THRESHOLD)
+  for (size_t i = 0; i < size; i++)
+  {
+    const bool finite = std::isfinite(values[i]);
+    range_min = std::min(range_min, finite ? values[i] : std::numeric_limits<float>::max());
+    range_max = std::max(range_max, finite ? values[i] : std::numeric_limits<float>::lowest());
+  }
+
+  if (range_min > range_max)
+    return false;
+  min = range_min;
+  max = range_max;
+  return true;
+}
+
+void applyColormap(
+  const float* values,
+  size_t size,
+  float min,
+  float max,
+  Colormap colormap,
+  std_msgs::ColorRGBA* colors)
+{
+  const ColormapTable& table = getColormapTable(colormap);
+  const float range = max - min;
+  const float scale = range > 0 ? (COLORMAP_SIZE - 1) / range : 0;
+  const std_msgs::ColorRGBA invalid;
+
+  #pragma omp parallel for if(size > PARALLEL_THRESHOLD)
+  for (size_t i = 0; i < size; i++)
+  {
+    const float position = (values[i] - min) * scale;
+    if (std::isfinite(position))
+    {
+      const float clamped = std::min(std::max(position, 0.0f), static_cast<float>(COLORMAP_SIZE - 1));
+      colors[i] = table[static_cast<size_t>(clamped + 0.5f)];
+    }
+    else
+    {
+      colors[i] = invalid;
+    }
+  }
+}
+
 } /* namespace lvr_ros */
\ No newline at end of file
@@ -0,0 +1,151 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * compact_geometry_benchmark.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "lvr_ros/conversions.h"
+#include "lvr_ros/hdf5_mesh_io.h"
+
+/*
+ * Measures size and encode / decode throughput of the compact mesh encoding.
+ *
+ * Usage: compact_benchmark [mesh.h5 [mesh_name [iterations]]]
+ *
+ * Without a file, a synthetic terrain mesh is used.
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static mesh_msgs::MeshGeometryStamped createTerrain(size_t size)
+{
+    mesh_msgs::MeshGeometryStamped mesh;
+    auto& geometry = mesh.mesh_geometry;
+    for (size_t y = 0; y < size; y++)
+    {
+        for (size_t x = 0; x < size; x++)
+        {
+            geometry_msgs::Point v, n;
+            v.x = x * 0.05;
+            v.y = y * 0.05;
+            v.z = std::sin(v.x) * std::cos(v.y * 0.7);
+            n.x = -std::cos(v.x) * std::cos(v.y * 0.7);
+            n.y = 0.7 * std::sin(v.x) * std::sin(v.y * 0.7);
+            n.z = 1;
+            const double length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+            n.x /= length;
+            n.y /= length;
+            n.z /= length;
+            geometry.vertices.push_back(v);
+            geometry.vertex_normals.push_back(n);
+        }
+    }
+    for (uint32_t y = 0; y + 1 < size; y++)
+    {
+        for (uint32_t x = 0; x + 1 < size; x++)
+        {
+            const uint32_t i = y * size + x;
+            mesh_msgs::TriangleIndices a, b;
+            a.vertex_indices = {{i, i + 1, i + static_cast<uint32_t>(size)}};
+            b.vertex_indices = {{i + 1, i + static_cast<uint32_t>(size) + 1, i + static_cast<uint32_t>(size)}};
+            geometry.faces.push_back(a);
+            geometry.faces.push_back(b);
+        }
+    }
+    return mesh;
+}
+
+static double throughput(size_t bytes, Clock::duration duration, int iterations)
+{
+    return bytes * iterations / std::chrono::duration<double>(duration).count() / (1 << 20);
+}
+
+int main(int argc, char **args)
+{
+    const std::string filename = argc > 1 ? args[1] : "";
+    const std::string mesh_name = argc > 2 ? args[2] : "triangle_mesh";
+    const int iterations = argc > 3 ? std::max(1, std::atoi(args[3])) : 10;
+
+    mesh_msgs::MeshGeometryStamped mesh;
+    if (filename.empty())
+    {
+        mesh = createTerrain(1000);
+    }
+    else
+    {
+        lvr_ros::Hdf5MeshReader reader(filename, mesh_name);
+        if (!reader.readGeometry(mesh.mesh_geometry))
+        {
+            std::cerr << "Could not read mesh \"" << mesh_name << "\" from \"" << filename << "\"!" << std::endl;
+            return 1;
+        }
+    }
+
+    const auto& geometry = mesh.mesh_geometry;
+    // Payload of the MeshGeometry message: three float64 per vertex and normal, three uint32 per face
+    const size_t message_size = 24 * (geometry.vertices.size() + geometry.vertex_normals.size())
+        + 12 * geometry.faces.size();
+
+    std::cout << geometry.vertices.size() << " vertices, " << geometry.faces.size() << " faces, "
+        << message_size / 1024 << " KiB as MeshGeometry" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+
+    for (int compression_level : {0, 1, 3, 9})
+    {
+        for (int normal_bits : {8, 10, 16})
+        {
+            lvr_ros::CompactMeshGeometry compact;
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < iterations; i++)
+            {
+                lvr_ros::fromMeshGeometryToCompactMeshGeometry(mesh, compact, 16, normal_bits, compression_level);
+            }
+            Clock::duration encode_time = Clock::now() - start;
+
+            mesh_msgs::MeshGeometryStamped decoded;
+            start = Clock::now();
+            for (int i = 0; i < iterations; i++)
+            {
+                if (!lvr_ros::fromCompactMeshGeometryToMeshGeometry(compact, decoded))
+                {
+                    std::cerr << "Decoding failed!" << std::endl;
+                    return 1;
+                }
+            }
+            Clock::duration decode_time = Clock::now() - start;
+
+            std::cout << "zstd " << compression_level << ", normal bits " << std::setw(2) << normal_bits << ": "
+                << std::setw(8) << compact.data.size() / 1024 << " KiB, "
+                << std::setw(5) << static_cast<double>(message_size) / compact.data.size() << "x smaller, "
+                << "encode " << std::setw(7) << throughput(message_size, encode_time, iterations) << " MiB/s, "
+                << "decode " << std::setw(7) << throughput(message_size, decode_time, iterations) << " MiB/s"
+                << std::endl;
+        }
+    }
+    return 0;
+}
@@ -29,7 +29,13 @@
 
 #include "lvr_ros/conversions.h"
 #include "lvr_ros/colors.h"
+#include "lvr_ros/vertex_welding.h"
 #include <cmath>
+#include <type_traits>
+
+#ifdef ZSTD_FOUND
+    #include <zstd.h>
+#endif
 
 namespace lvr_ros
 {
@@ -101,21 +107,27 @@ bool fromMeshBufferToMeshMessages(
     // copy vertices, faces and normals
     fromMeshBufferToMeshGeometryMessage(buffer, mesh_geometry);
 
-    //size_t n_clusters = buffer->; TODO Clusters?
-    // Copy clusters
-    /*auto buffer_clusters = buffer->get;
-    mesh_materials.clusters.resize(n_clusters);
-    for (unsigned int i = 0; i < n_clusters; i++)
+    // Group the faces into one cluster per material
+    size_t n_face_materials;
+    unsigned face_materials_width;
+    auto buffer_face_materials = buffer->getIndexArray("face_materials", n_face_materials, face_materials_width);
+    mesh_materials.clusters.clear();
+    mesh_materials.cluster_materials.clear();
+    if (buffer_face_materials && face_materials_width > 0)
     {
-        int n = buffer_clusters[i].size();
-        mesh_materials.clusters[i].face_indices.resize(n);
-        for (unsigned int j = 0; j < n; j++)
+        std::map<uint32_t, size_t> cluster_of_material;
+        for (size_t i = 0; i < std::min(n_face_materials, n_faces); i++)
         {
-            mesh_materials.clusters[i].face_indices[j] = buffer_clusters[i][j];
+            const uint32_t material = buffer_face_materials[i * face_materials_width];
+            auto inserted = cluster_of_material.insert(std::make_pair(material, mesh_materials.clusters.size()));
+            if (inserted.second)
+            {
+                mesh_materials.clusters.emplace_back();
+                mesh_materials.cluster_materials.push_back(material);
+            }
+            mesh_materials.clusters[inserted.first->second].face_indices.push_back(i);
         }
     }
-    buffer_clusters.clear();
-    */
 
     size_t n_materials = buffer->getMaterials().size();
     size_t n_textures = buffer->getTextures().size();
@@ -153,26 +165,18 @@ bool fromMeshBufferToMeshMessages(
     }
     buffer_materials.clear();
 
-    // Copy cluster material indices TODO Cluster Materials?
-    /*
-    auto buffer_cluster_materials = buffer->getClusterMaterialIndices();
-    mesh_materials.materials.resize(n_clusters);
-    for (unsigned int i = 0; i < n_clusters; i++)
-    {
-        mesh_materials.cluster_materials[i] = buffer_cluster_materials[i];
-    }
-    buffer_cluster_materials.clear();
-    */
-
     // Copy vertex tex coords
-    auto buffer_texcoords = buffer->getTextureCoordinates();
+    size_t n_tex_coords;
+    unsigned tex_coords_width;
+    auto buffer_texcoords = buffer->getFloatArray("texture_coordinates", n_tex_coords, tex_coords_width);
+    mesh_materials.vertex_tex_coords.clear();
+    if (buffer_texcoords && tex_coords_width >= 2)
     {
         mesh_materials.vertex_tex_coords.resize(n_vertices);
-
-        for (unsigned int i = 0; i < n_vertices; i++)
+        for (size_t i = 0; i < std::min(n_tex_coords, n_vertices); i++)
         {
-            mesh_materials.vertex_tex_coords[i].u = buffer_texcoords[i * 3];
-            mesh_materials.vertex_tex_coords[i].v = buffer_texcoords[i * 3 + 1];
+            mesh_materials.vertex_tex_coords[i].u = buffer_texcoords[i * tex_coords_width];
+            mesh_materials.vertex_tex_coords[i].v = buffer_texcoords[i * tex_coords_width + 1];
         }
     }
 
@@ -289,7 +293,7 @@ bool fromMeshGeometryToMeshBuffer(
     const mesh_msgs::MeshGeometryConstPtr& mesh_geometry_ptr,
     lvr2::MeshBuffer& buffer)
 {
-    fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, buffer);
+    return fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, buffer);
 }
 
 bool fromMeshGeometryToMeshBuffer(
@@ -297,7 +301,7 @@ bool fromMeshGeometryToMeshBuffer(
     lvr2::MeshBufferPtr& buffer_ptr)
 {
     if(!buffer_ptr) buffer_ptr = lvr2::MeshBufferPtr(new lvr2::MeshBuffer);
-    fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, *buffer_ptr);
+    return fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, *buffer_ptr);
 }
 
 bool fromMeshGeometryToMeshBuffer(
@@ -305,14 +309,14 @@ bool fromMeshGeometryToMeshBuffer(
     lvr2::MeshBufferPtr& buffer_ptr)
 {
     if(!buffer_ptr) buffer_ptr = lvr2::MeshBufferPtr(new lvr2::MeshBuffer);
-    fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, *buffer_ptr);
+    return fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, *buffer_ptr);
 }
 
 bool fromMeshGeometryToMeshBuffer(
     const mesh_msgs::MeshGeometryPtr& mesh_geometry_ptr,
     lvr2::MeshBuffer& buffer)
 {
-    fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, buffer);
+    return fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, buffer);
 }
 
 bool fromMeshGeometryToMeshBuffer(
@@ -320,7 +324,7 @@ bool fromMeshGeometryToMeshBuffer(
     lvr2::MeshBufferPtr& buffer_ptr)
 {
     if(!buffer_ptr) buffer_ptr = lvr2::MeshBufferPtr(new lvr2::MeshBuffer);
-    fromMeshGeometryToMeshBuffer(mesh_geometry, *buffer_ptr);
+    return fromMeshGeometryToMeshBuffer(mesh_geometry, *buffer_ptr);
 }
 
 bool fromMeshGeometryToMeshBuffer(
@@ -331,7 +335,7 @@ bool fromMeshGeometryToMeshBuffer(
     const size_t numVertices = mesh_geometry.vertices.size();
     lvr2::floatArr vertices( new float[ numVertices * 3 ] );
     const auto& mg_vertices = mesh_geometry.vertices;
-    for(size_t i; i<numVertices; i++)
+    for(size_t i = 0; i<numVertices; i++)
     {
         vertices[ i * 3 + 0 ] = static_cast<float>(mg_vertices[i].x);
         vertices[ i * 3 + 1 ] = static_cast<float>(mg_vertices[i].y);
@@ -340,9 +344,9 @@ bool fromMeshGeometryToMeshBuffer(
     buffer.setVertices(vertices, numVertices);
 
     const size_t numFaces = mesh_geometry.faces.size();
-    lvr2::indexArray faces( new unsigned int[ numVertices * 3 ] );
+    lvr2::indexArray faces( new unsigned int[ numFaces * 3 ] );
     const auto& mg_faces = mesh_geometry.faces;
-    for(size_t i; i<numFaces; i++)
+    for(size_t i = 0; i<numFaces; i++)
     {
         faces[ i * 3 + 0 ] = mg_faces[i].vertex_indices[0];
         faces[ i * 3 + 1 ] = mg_faces[i].vertex_indices[1];
@@ -350,16 +354,20 @@ bool fromMeshGeometryToMeshBuffer(
     }
     buffer.setFaceIndices(faces, numFaces);
 
+    // Normals are optional, but the buffer expects one per vertex
     const size_t numNormals = mesh_geometry.vertex_normals.size();
-    lvr2::floatArr normals( new float[ numNormals * 3 ] );
-    const auto& mg_normals = mesh_geometry.vertex_normals;
-    for(size_t i; i<numNormals; i++)
+    if(numNormals == numVertices)
     {
-        normals[ i * 3 + 0 ] = static_cast<float>(mg_normals[i].x);
-        normals[ i * 3 + 1 ] = static_cast<float>(mg_normals[i].y);
-        normals[ i * 3 + 2 ] = static_cast<float>(mg_normals[i].z);
+        lvr2::floatArr normals( new float[ numNormals * 3 ] );
+        const auto& mg_normals = mesh_geometry.vertex_normals;
+        for(size_t i = 0; i<numNormals; i++)
+        {
+            normals[ i * 3 + 0 ] = static_cast<float>(mg_normals[i].x);
+            normals[ i * 3 + 1 ] = static_cast<float>(mg_normals[i].y);
+            normals[ i * 3 + 2 ] = static_cast<float>(mg_normals[i].z);
+        }
+        buffer.setVertexNormals(normals);
     }
-    buffer.setVertexNormals(normals);
 
     return true;
 }
@@ -371,7 +379,7 @@ bool fromTriangleMeshToMeshBuffer(
     const size_t numVertices = mesh.vertices.size();
     lvr2::floatArr vertices( new float[ numVertices * 3 ] );
     const auto& mg_vertices = mesh.vertices;
-    for(size_t i; i<numVertices; i++)
+    for(size_t i = 0; i<numVertices; i++)
     {
         vertices[ i * 3 + 0 ] = static_cast<float>(mg_vertices[i].x);
         vertices[ i * 3 + 1 ] = static_cast<float>(mg_vertices[i].y);
@@ -380,9 +388,9 @@ bool fromTriangleMeshToMeshBuffer(
     buffer.setVertices(vertices, numVertices);
 
     const size_t numFaces = mesh.triangles.size();
-    lvr2::indexArray faces( new unsigned int[ numVertices * 3 ] );
+    lvr2::indexArray faces( new unsigned int[ numFaces * 3 ] );
     const auto& mg_faces = mesh.triangles;
-    for(size_t i; i<numFaces; i++)
+    for(size_t i = 0; i<numFaces; i++)
     {
         faces[ i * 3 + 0 ] = mg_faces[i].vertex_indices[0];
         faces[ i * 3 + 1 ] = mg_faces[i].vertex_indices[1];
@@ -390,16 +398,20 @@ bool fromTriangleMeshToMeshBuffer(
     }
     buffer.setFaceIndices(faces, numFaces);
 
+    // Normals are optional, but the buffer expects one per vertex
     const size_t numNormals = mesh.vertex_normals.size();
-    lvr2::floatArr normals( new float[ numNormals * 3 ] );
-    const auto& mg_normals = mesh.vertex_normals;
-    for(size_t i; i<numNormals; i++)
+    if(numNormals == numVertices)
     {
-        normals[ i * 3 + 0 ] = static_cast<float>(mg_normals[i].x);
-        normals[ i * 3 + 1 ] = static_cast<float>(mg_normals[i].y);
-        normals[ i * 3 + 2 ] = static_cast<float>(mg_normals[i].z);
+        lvr2::floatArr normals( new float[ numNormals * 3 ] );
+        const auto& mg_normals = mesh.vertex_normals;
+        for(size_t i = 0; i<numNormals; i++)
+        {
+            normals[ i * 3 + 0 ] = static_cast<float>(mg_normals[i].x);
+            normals[ i * 3 + 1 ] = static_cast<float>(mg_normals[i].y);
+            normals[ i * 3 + 2 ] = static_cast<float>(mg_normals[i].z);
+        }
+        buffer.setVertexNormals(normals);
     }
-    buffer.setVertexNormals(normals);
 
     return true;
 }
@@ -451,69 +463,193 @@ bool writeTriangleMesh(mesh_msgs::TriangleMesh& mesh, string path)
     return false;
 }
 
-/*
-void removeDuplicates(lvr2::MeshBuffer& buffer)
+/// Replaces a per-vertex float channel by the values of the kept vertices
+static void weldFloatChannel(
+    lvr2::MeshBuffer& buffer,
+    const std::string& name,
+    size_t num_vertices,
+    const std::vector<uint32_t>& kept
+)
+{
+    size_t n;
+    unsigned w;
+    lvr2::floatArr values = buffer.getFloatArray(name, n, w);
+    if (!values || n != num_vertices)
+    {
+        return;
+    }
+    lvr2::floatArr welded(new float[kept.size() * w]);
+    gatherVertexValues(values.get(), w, kept, welded.get());
+    buffer.addFloatChannel(welded, name, kept.size(), w);
+}
+
+/// Returns true if all face indices reference one of the vertices
+static bool checkFaceIndices(const unsigned int* faces, size_t num_indices, size_t num_vertices)
 {
-    lvr2::floatArr old_vertexBuffer;
-    lvr2::uintArr old_indexBuffer;
-    std::vector<float> new_vertexBuffer;
-    std::vector<unsigned int> new_indexBuffer;
+    bool valid = true;
+    #pragma omp parallel for reduction(&&:valid)
+    for (size_t i = 0; i < num_indices; i++)
+    {
+        valid = valid && faces[i] < num_vertices;
+    }
+    return valid;
+}
+
+size_t removeDuplicates(lvr2::MeshBuffer& buffer, float epsilon)
+{
+    const size_t num_vertices = buffer.numVertices();
+    const size_t num_faces = buffer.numFaces();
+    lvr2::floatArr vertices = buffer.getVertices();
+    lvr2::indexArray faces = buffer.getFaceIndices();
+    if (!vertices || num_vertices == 0)
+    {
+        return 0;
+    }
+    if (faces && !checkFaceIndices(faces.get(), num_faces * 3, num_vertices))
+    {
+        ROS_ERROR_STREAM("Invalid vertex index in face, can not remove duplicate vertices!");
+        return 0;
+    }
 
-    size_t old_numVertices, old_numIndices;
-    size_t new_numVertices, new_numIndices;
+    size_t n;
+    unsigned w;
+    lvr2::floatArr tex_coords = buffer.getFloatArray("texture_coordinates", n, w);
+    const bool has_tex_coords = tex_coords && n == num_vertices;
+
+    std::vector<uint32_t> remap, kept;
+    const size_t num_welded = weldVertices(
+        vertices.get(),
+        num_vertices,
+        epsilon,
+        has_tex_coords ? tex_coords.get() : nullptr,
+        has_tex_coords ? w : 0,
+        remap,
+        kept
+    );
+    if (num_welded == num_vertices)
+    {
+        return 0;
+    }
 
-    old_vertexBuffer = buffer.getVertexArray(old_numVertices);
-    old_indexBuffer = buffer.getFaceArray(old_numIndices);
+    lvr2::floatArr welded_vertices(new float[num_welded * 3]);
+    gatherVertexValues(vertices.get(), 3, kept, welded_vertices.get());
+    buffer.setVertices(welded_vertices, num_welded);
+    weldFloatChannel(buffer, "vertex_normals", num_vertices, kept);
+    weldFloatChannel(buffer, "texture_coordinates", num_vertices, kept);
+    weldFloatChannel(buffer, "intensity", num_vertices, kept);
 
-    std::map<lvr::Vertex<float>, unsigned int> vertexMap;
-    size_t pos;
-    int index;
+    lvr2::ucharArr colors = buffer.getUCharArray("vertex_colors", n, w);
+    if (colors && n == num_vertices)
+    {
+        lvr2::ucharArr welded_colors(new unsigned char[num_welded * w]);
+        gatherVertexValues(colors.get(), w, kept, welded_colors.get());
+        buffer.addUCharChannel(welded_colors, "vertex_colors", num_welded, w);
+    }
 
-    for (int i = 0; i < old_numIndices; i++)
+    if (faces)
     {
-        for (int j = 0; j < 3; j++)
+        lvr2::indexArray welded_faces(new unsigned int[num_faces * 3]);
+        #pragma omp parallel for
+        for (size_t i = 0; i < num_faces * 3; i++)
         {
-            index = old_indexBuffer[3 * i + j];
+            welded_faces[i] = remap[faces[i]];
+        }
+        buffer.setFaceIndices(welded_faces, num_faces);
+    }
 
-            lvr::Vertex<float> vertex =
-                lvr::Vertex<float>(old_vertexBuffer[3 * index],
-                                   old_vertexBuffer[3 * index + 1],
-                                   old_vertexBuffer[3 * index + 2]);
+    return num_vertices - num_welded;
+}
 
-            if (vertexMap.find(vertex) != vertexMap.end())
+size_t removeDuplicates(mesh_msgs::TriangleMesh& mesh, float epsilon)
+{
+    const size_t num_vertices = mesh.vertices.size();
+    for (const auto& triangle : mesh.triangles)
+    {
+        for (const auto index : triangle.vertex_indices)
+        {
+            if (index >= num_vertices)
             {
-                pos = vertexMap[vertex];
+                ROS_ERROR_STREAM("Invalid vertex index in triangle, can not remove duplicate vertices!");
+                return 0;
             }
-            else
-            {
-                pos = new_vertexBuffer.size() / 3;
-                new_vertexBuffer.push_back(vertex[0]);
-                new_vertexBuffer.push_back(vertex[1]);
-                new_vertexBuffer.push_back(vertex[2]);
+        }
+    }
 
-                vertexMap.insert(pair<lvr::Vertex<float>, unsigned int>(vertex, pos));
-            }
+    std::vector<float> positions(num_vertices * 3);
+    #pragma omp parallel for
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        positions[3 * i + 0] = static_cast<float>(mesh.vertices[i].x);
+        positions[3 * i + 1] = static_cast<float>(mesh.vertices[i].y);
+        positions[3 * i + 2] = static_cast<float>(mesh.vertices[i].z);
+    }
 
-            new_indexBuffer.push_back(pos);
+    std::vector<float> tex_coords;
+    if (mesh.vertex_texture_coords.size() == num_vertices)
+    {
+        tex_coords.resize(num_vertices * 2);
+        for (size_t i = 0; i < num_vertices; i++)
+        {
+            tex_coords[2 * i + 0] = static_cast<float>(mesh.vertex_texture_coords[i].x);
+            tex_coords[2 * i + 1] = static_cast<float>(mesh.vertex_texture_coords[i].y);
         }
     }
-    buffer.setVertexArray(new_vertexBuffer);
-    buffer.setFaceArray(new_indexBuffer);
+
+    std::vector<uint32_t> remap, kept;
+    const size_t num_welded = weldVertices(
+        positions.data(),
+        num_vertices,
+        epsilon,
+        tex_coords.empty() ? nullptr : tex_coords.data(),
+        2,
+        remap,
+        kept
+    );
+    if (num_welded == num_vertices)
+    {
+        return 0;
+    }
+
+    // Per-vertex arrays of a different length are left alone, like in the other conversions
+    auto weld = [&kept, num_vertices](auto& values)
+    {
+        if (values.size() == num_vertices)
+        {
+            typename std::remove_reference<decltype(values)>::type welded(kept.size());
+            gatherVertexValues(values.data(), 1, kept, welded.data());
+            values.swap(welded);
+        }
+    };
+    weld(mesh.vertices);
+    weld(mesh.vertex_normals);
+    weld(mesh.vertex_colors);
+    weld(mesh.vertex_texture_coords);
+
+    #pragma omp parallel for
+    for (size_t i = 0; i < mesh.triangles.size(); i++)
+    {
+        for (auto& index : mesh.triangles[i].vertex_indices)
+        {
+            index = remap[index];
+        }
+    }
+
+    return num_vertices - num_welded;
 }
-*/
 
-/*
-TODO
-void removeDuplicates(mesh_msgs::TriangleMesh& mesh)
+/// Appends the colormapped values to the colors, which are resized once
+static void appendRainbowColors(
+    const float* values,
+    size_t size,
+    float min,
+    float max,
+    std::vector<std_msgs::ColorRGBA>& colors
+)
 {
-    lvr::MeshBuffer buffer;
-    fromTriangleMeshToMeshBuffer(mesh, buffer);
-    removeDuplicates(buffer);
-
-    lvr::MeshBufferPtr buffer_ptr = boost::make_shared<lvr::MeshBuffer>(buffer);
-    fromMeshBufferToTriangleMesh(buffer_ptr, mesh);
+    const size_t offset = colors.size();
+    colors.resize(offset + size);
+    applyColormap(values, size, min, max, Colormap::RAINBOW, colors.data() + offset);
 }
-*/
 
 void intensityToTriangleRainbowColors(
     const std::vector<float>& intensity,
@@ -522,35 +658,13 @@ void intensityToTriangleRainbowColors(
     float max
 )
 {
-    float range = max - min;
-
-    float r, g, b;
-    float a = 1;
-
-    for (size_t i = 0; i < intensity.size(); i++)
-    {
-        float norm = (intensity[i] - min) / range;
-        getRainbowColor(norm, r, g, b);
-        std_msgs::ColorRGBA color;
-        color.a = a;
-        color.r = r;
-        color.g = g;
-        color.b = b;
-        mesh.triangle_colors.push_back(color);
-    }
+    appendRainbowColors(intensity.data(), intensity.size(), min, max, mesh.triangle_colors);
 }
 
 void intensityToTriangleRainbowColors(const std::vector<float>& intensity, mesh_msgs::TriangleMesh& mesh)
 {
-    float min = std::numeric_limits<float>::max();
-    float max = std::numeric_limits<float>::min();
-
-    for (size_t i = 0; i < intensity.size(); i++)
-    {
-        if (!std::isfinite(intensity[i])) continue;
-        if (min > intensity[i]) min = intensity[i];
-        if (max < intensity[i]) max = intensity[i];
-    }
+    float min = 0, max = 0;
+    getFiniteRange(intensity.data(), intensity.size(), min, max);
     intensityToTriangleRainbowColors(intensity, mesh, min, max);
 }
 
@@ -561,22 +675,7 @@ void intensityToVertexRainbowColors(
     float max
 )
 {
-    float range = max - min;
-
-    float r, g, b;
-    float a = 1;
-
-    for (size_t i = 0; i < intensity.size(); i++)
-    {
-        float norm = (intensity[i] - min) / range;
-        getRainbowColor(norm, r, g, b);
-        std_msgs::ColorRGBA color;
-        color.a = a;
-        color.r = r;
-        color.g = g;
-        color.b = b;
-        mesh.vertex_colors.push_back(color);
-    }
+    appendRainbowColors(intensity.data(), intensity.size(), min, max, mesh.vertex_colors);
 }
 
 void intensityToVertexRainbowColors(
@@ -586,38 +685,44 @@ void intensityToVertexRainbowColors(
     float max
 )
 {
-    float range = max - min;
-
-    float r, g, b;
-    float a = 1;
-
-    for (auto intensity_val: intensity)
+    // Dense maps may have gaps of deleted vertices, the values are gathered by handle index
+    std::vector<float> values(intensity.numValues(), std::numeric_limits<float>::quiet_NaN());
+    for (auto vH : intensity)
     {
-        float norm = (intensity[intensity_val] - min) / range;
-        getRainbowColor(norm, r, g, b);
-        std_msgs::ColorRGBA color;
-        color.a = a;
-        color.r = r;
-        color.g = g;
-        color.b = b;
-        mesh.triangle_colors.push_back(color);
+        if (vH.idx() >= values.size())
+        {
+            values.resize(vH.idx() + 1, std::numeric_limits<float>::quiet_NaN());
+        }
+        values[vH.idx()] = intensity[vH];
     }
+    appendRainbowColors(values.data(), values.size(), min, max, mesh.vertex_colors);
 }
 
 void intensityToVertexRainbowColors(const std::vector<float>& intensity, mesh_msgs::TriangleMesh& mesh)
 {
-    float min = std::numeric_limits<float>::max();
-    float max = std::numeric_limits<float>::min();
-
-    for (size_t i = 0; i < intensity.size(); i++)
-    {
-        if (!std::isfinite(intensity[i])) continue;
-        if (min > intensity[i]) min = intensity[i];
-        if (max < intensity[i]) max = intensity[i];
-    }
+    float min = 0, max = 0;
+    getFiniteRange(intensity.data(), intensity.size(), min, max);
     intensityToVertexRainbowColors(intensity, mesh, min, max);
 }
 
+void intensityToVertexRainbowColors(
+    const std::vector<float>& intensity,
+    mesh_msgs::MeshVertexColors& mesh_vertex_colors
+)
+{
+    float min = 0, max = 0;
+    getFiniteRange(intensity.data(), intensity.size(), min, max);
+    mesh_vertex_colors.vertex_colors.resize(intensity.size());
+    applyColormap(
+        intensity.data(),
+        intensity.size(),
+        min,
+        max,
+        Colormap::RAINBOW,
+        mesh_vertex_colors.vertex_colors.data()
+    );
+}
+
 static inline bool hasCloudChannel(const sensor_msgs::PointCloud2& cloud, const std::string& field_name)
 {
     // Get the index we need
@@ -808,7 +913,7 @@ bool fromMeshGeometryMessageToMeshBuffer(
         faces[i+2] = face.vertex_indices[2];
         i += 3;
     }
-    buffer->setFaceIndices(faces, mesh_geometry.faces.size() * 3);
+    buffer->setFaceIndices(faces, mesh_geometry.faces.size());
 
     if(mesh_geometry.vertex_normals.size() == mesh_geometry.vertices.size())
     {
@@ -832,4 +937,542 @@ bool fromMeshGeometryMessageToMeshBuffer(
     }
     return true;
 }
+
+static inline uint64_t zigzagEncode(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static inline int64_t zigzagDecode(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+static inline void writeVarint(std::vector<uint8_t>& data, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        data.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    data.push_back(static_cast<uint8_t>(value));
+}
+
+static inline bool readVarint(const uint8_t*& pos, const uint8_t* end, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < end; shift += 7)
+    {
+        const uint8_t byte = *pos++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline double signNotZero(double value)
+{
+    return value >= 0 ? 1.0 : -1.0;
+}
+
+/// Maps a unit vector onto the octahedron and unfolds it to [-1, 1]^2
+static inline void octahedralEncode(const geometry_msgs::Point& normal, double& u, double& v)
+{
+    const double norm = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (norm == 0)
+    {
+        u = v = 0;
+        return;
+    }
+    u = normal.x / norm;
+    v = normal.y / norm;
+    if (normal.z < 0)
+    {
+        const double folded_u = (1 - std::abs(v)) * signNotZero(u);
+        v = (1 - std::abs(u)) * signNotZero(v);
+        u = folded_u;
+    }
+}
+
+static inline void octahedralDecode(double u, double v, geometry_msgs::Point& normal)
+{
+    normal.x = u;
+    normal.y = v;
+    normal.z = 1 - std::abs(u) - std::abs(v);
+    if (normal.z < 0)
+    {
+        normal.x = (1 - std::abs(v)) * signNotZero(u);
+        normal.y = (1 - std::abs(u)) * signNotZero(v);
+    }
+    const double length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+    normal.x /= length;
+    normal.y /= length;
+    normal.z /= length;
+}
+
+bool fromMeshGeometryToCompactMeshGeometry(
+    const mesh_msgs::MeshGeometryStamped& mesh_geometry,
+    lvr_ros::CompactMeshGeometry& compact,
+    int position_bits,
+    int normal_bits,
+    int compression_level
+)
+{
+    if (position_bits < 1 || position_bits > 24 || normal_bits < 0 || normal_bits > 16)
+    {
+        ROS_ERROR_STREAM("Invalid compact mesh precision of " << position_bits << " position bits and "
+            << normal_bits << " normal bits!");
+        return false;
+    }
+
+    const auto& vertices = mesh_geometry.mesh_geometry.vertices;
+    const auto& normals = mesh_geometry.mesh_geometry.vertex_normals;
+    const auto& faces = mesh_geometry.mesh_geometry.faces;
+    const size_t num_vertices = vertices.size();
+    const bool has_normals = normal_bits > 0 && num_vertices > 0 && normals.size() == num_vertices;
+
+    compact.header = mesh_geometry.header;
+    compact.uuid = mesh_geometry.uuid;
+    compact.num_vertices = static_cast<uint32_t>(num_vertices);
+    compact.num_faces = static_cast<uint32_t>(faces.size());
+    compact.position_bits = static_cast<uint8_t>(position_bits);
+    compact.normal_bits = static_cast<uint8_t>(has_normals ? normal_bits : 0);
+    compact.compression = lvr_ros::CompactMeshGeometry::COMPRESSION_NONE;
+    compact.bbox_min = geometry_msgs::Point();
+    compact.bbox_max = geometry_msgs::Point();
+
+    if (num_vertices > 0)
+    {
+        compact.bbox_min = compact.bbox_max = vertices[0];
+        for (const auto& v : vertices)
+        {
+            compact.bbox_min.x = std::min(compact.bbox_min.x, v.x);
+            compact.bbox_min.y = std::min(compact.bbox_min.y, v.y);
+            compact.bbox_min.z = std::min(compact.bbox_min.z, v.z);
+            compact.bbox_max.x = std::max(compact.bbox_max.x, v.x);
+            compact.bbox_max.y = std::max(compact.bbox_max.y, v.y);
+            compact.bbox_max.z = std::max(compact.bbox_max.z, v.z);
+        }
+    }
+
+    // Quantize the positions relative to the bounding box
+    const double max_value = static_cast<double>((1u << position_bits) - 1);
+    const double min[3] = {compact.bbox_min.x, compact.bbox_min.y, compact.bbox_min.z};
+    const double extent[3] = {
+        compact.bbox_max.x - compact.bbox_min.x,
+        compact.bbox_max.y - compact.bbox_min.y,
+        compact.bbox_max.z - compact.bbox_min.z
+    };
+    double scale[3];
+    for (int k = 0; k < 3; k++)
+    {
+        scale[k] = extent[k] > 0 ? max_value / extent[k] : 0;
+    }
+
+    std::vector<uint32_t> quantized(num_vertices * 3);
+    #pragma omp parallel for
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        quantized[i * 3] = static_cast<uint32_t>(std::lround((vertices[i].x - min[0]) * scale[0]));
+        quantized[i * 3 + 1] = static_cast<uint32_t>(std::lround((vertices[i].y - min[1]) * scale[1]));
+        quantized[i * 3 + 2] = static_cast<uint32_t>(std::lround((vertices[i].z - min[2]) * scale[2]));
+    }
+
+    std::vector<uint8_t> data;
+    data.reserve(num_vertices * (has_normals ? 10 : 6) + faces.size() * 4);
+
+    int64_t previous[3] = {0, 0, 0};
+    for (size_t i = 0; i < quantized.size(); i += 3)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            writeVarint(data, zigzagEncode(static_cast<int64_t>(quantized[i + k]) - previous[k]));
+            previous[k] = quantized[i + k];
+        }
+    }
+
+    if (has_normals)
+    {
+        const size_t bytes = normal_bits <= 8 ? 1 : 2;
+        const double max_normal = static_cast<double>((1u << normal_bits) - 1);
+        const size_t offset = data.size();
+        data.resize(offset + num_vertices * 2 * bytes);
+        uint8_t* normal_data = data.data() + offset;
+
+        #pragma omp parallel for
+        for (size_t i = 0; i < num_vertices; i++)
+        {
+            double uv[2];
+            octahedralEncode(normals[i], uv[0], uv[1]);
+            for (int k = 0; k < 2; k++)
+            {
+                const uint32_t value = static_cast<uint32_t>(std::lround((uv[k] * 0.5 + 0.5) * max_normal));
+                uint8_t* out = normal_data + (i * 2 + k) * bytes;
+                out[0] = static_cast<uint8_t>(value);
+                if (bytes == 2)
+                {
+                    out[1] = static_cast<uint8_t>(value >> 8);
+                }
+            }
+        }
+    }
+
+    int64_t previous_first = 0;
+    for (const auto& face : faces)
+    {
+        const auto& indices = face.vertex_indices;
+        if (indices[0] >= num_vertices || indices[1] >= num_vertices || indices[2] >= num_vertices)
+        {
+            ROS_ERROR_STREAM("Invalid vertex index in face, can not encode the mesh!");
+            return false;
+        }
+        const int64_t first = indices[0];
+        writeVarint(data, zigzagEncode(first - previous_first));
+        writeVarint(data, zigzagEncode(static_cast<int64_t>(indices[1]) - first));
+        writeVarint(data, zigzagEncode(static_cast<int64_t>(indices[2]) - first));
+        previous_first = first;
+    }
+
+    compact.uncompressed_size = static_cast<uint32_t>(data.size());
+
+#ifdef ZSTD_FOUND
+    if (compression_level > 0 && !data.empty())
+    {
+        std::vector<uint8_t> compressed(ZSTD_compressBound(data.size()));
+        const size_t size = ZSTD_compress(
+            compressed.data(),
+            compressed.size(),
+            data.data(),
+            data.size(),
+            compression_level
+        );
+        if (ZSTD_isError(size))
+        {
+            ROS_WARN_STREAM("zstd compression failed: " << ZSTD_getErrorName(size) << ", send uncompressed.");
+        }
+        else
+        {
+            compressed.resize(size);
+            data.swap(compressed);
+            compact.compression = lvr_ros::CompactMeshGeometry::COMPRESSION_ZSTD;
+        }
+    }
+#endif
+
+    compact.data.swap(data);
+    return true;
+}
+
+bool fromCompactMeshGeometryToMeshGeometry(
+    const lvr_ros::CompactMeshGeometry& compact,
+    mesh_msgs::MeshGeometryStamped& mesh_geometry
+)
+{
+    if (compact.position_bits < 1 || compact.position_bits > 24 || compact.normal_bits > 16)
+    {
+        ROS_ERROR_STREAM("Invalid compact mesh precision of " << int(compact.position_bits) << " position bits and "
+            << int(compact.normal_bits) << " normal bits!");
+        return false;
+    }
+
+    const uint8_t* pos = compact.data.data();
+    const uint8_t* end = pos + compact.data.size();
+
+#ifdef ZSTD_FOUND
+    std::vector<uint8_t> decompressed;
+#endif
+    if (compact.compression == lvr_ros::CompactMeshGeometry::COMPRESSION_ZSTD)
+    {
+#ifdef ZSTD_FOUND
+        // The size of the message has to match the frame, before it is allocated
+        if (ZSTD_getFrameContentSize(compact.data.data(), compact.data.size()) != compact.uncompressed_size)
+        {
+            ROS_ERROR_STREAM("The compact mesh size does not match its zstd frame!");
+            return false;
+        }
+        decompressed.resize(compact.uncompressed_size);
+        const size_t size = ZSTD_decompress(
+            decompressed.data(),
+            decompressed.size(),
+            compact.data.data(),
+            compact.data.size()
+        );
+        if (ZSTD_isError(size) || size != compact.uncompressed_size)
+        {
+            ROS_ERROR_STREAM("Could not decompress the compact mesh!");
+            return false;
+        }
+        pos = decompressed.data();
+        end = pos + decompressed.size();
+#else
+        ROS_ERROR_STREAM("The compact mesh is zstd compressed, but lvr_ros was built without zstd!");
+        return false;
+#endif
+    }
+    else if (compact.compression != lvr_ros::CompactMeshGeometry::COMPRESSION_NONE)
+    {
+        ROS_ERROR_STREAM("Unknown compact mesh compression " << int(compact.compression) << "!");
+        return false;
+    }
+
+    // Every coordinate and every index takes at least one byte, corrupt counts must not allocate more than that
+    const size_t num_vertices = compact.num_vertices;
+    const size_t num_faces = compact.num_faces;
+    const size_t normal_bytes = compact.normal_bits == 0 ? 0 : (compact.normal_bits <= 8 ? 1 : 2);
+    if (static_cast<size_t>(end - pos) < num_vertices * (3 + 2 * normal_bytes) + num_faces * 3)
+    {
+        ROS_ERROR_STREAM("Compact mesh data is too short for " << num_vertices << " vertices and "
+            << num_faces << " faces!");
+        return false;
+    }
+
+    auto& vertices = mesh_geometry.mesh_geometry.vertices;
+    auto& normals = mesh_geometry.mesh_geometry.vertex_normals;
+    auto& faces = mesh_geometry.mesh_geometry.faces;
+
+    mesh_geometry.header = compact.header;
+    mesh_geometry.uuid = compact.uuid;
+    vertices.resize(num_vertices);
+    normals.clear();
+    faces.resize(num_faces);
+
+    const double max_value = static_cast<double>((1u << compact.position_bits) - 1);
+    const double step[3] = {
+        (compact.bbox_max.x - compact.bbox_min.x) / max_value,
+        (compact.bbox_max.y - compact.bbox_min.y) / max_value,
+        (compact.bbox_max.z - compact.bbox_min.z) / max_value
+    };
+
+    int64_t quantized[3] = {0, 0, 0};
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            uint64_t value;
+            if (!readVarint(pos, end, value))
+            {
+                ROS_ERROR_STREAM("Compact mesh data ends within the vertices!");
+                return false;
+            }
+            quantized[k] += zigzagDecode(value);
+        }
+        vertices[i].x = compact.bbox_min.x + quantized[0] * step[0];
+        vertices[i].y = compact.bbox_min.y + quantized[1] * step[1];
+        vertices[i].z = compact.bbox_min.z + quantized[2] * step[2];
+    }
+
+    if (compact.normal_bits > 0)
+    {
+        if (static_cast<size_t>(end - pos) < num_vertices * 2 * normal_bytes)
+        {
+            ROS_ERROR_STREAM("Compact mesh data ends within the normals!");
+            return false;
+        }
+        const double max_normal = static_cast<double>((1u << compact.normal_bits) - 1);
+        const uint8_t* normal_data = pos;
+        normals.resize(num_vertices);
+
+        #pragma omp parallel for
+        for (size_t i = 0; i < num_vertices; i++)
+        {
+            double uv[2];
+            for (int k = 0; k < 2; k++)
+            {
+                const uint8_t* in = normal_data + (i * 2 + k) * normal_bytes;
+                const uint32_t value = normal_bytes == 2 ? (in[0] | (uint32_t(in[1]) << 8)) : in[0];
+                uv[k] = value / max_normal * 2.0 - 1.0;
+            }
+            octahedralDecode(uv[0], uv[1], normals[i]);
+        }
+        pos += num_vertices * 2 * normal_bytes;
+    }
+
+    int64_t first = 0;
+    for (auto& face : faces)
+    {
+        uint64_t values[3];
+        if (!readVarint(pos, end, values[0]) || !readVarint(pos, end, values[1]) || !readVarint(pos, end, values[2]))
+        {
+            ROS_ERROR_STREAM("Compact mesh data ends within the faces!");
+            return false;
+        }
+        first += zigzagDecode(values[0]);
+        const int64_t indices[3] = {first, first + zigzagDecode(values[1]), first + zigzagDecode(values[2])};
+        for (int k = 0; k < 3; k++)
+        {
+            if (indices[k] < 0 || static_cast<size_t>(indices[k]) >= num_vertices)
+            {
+                ROS_ERROR_STREAM("Invalid vertex index in compact mesh data!");
+                return false;
+            }
+            face.vertex_indices[k] = static_cast<uint32_t>(indices[k]);
+        }
+    }
+    return true;
+}
+
+/// Copies the points of the cloud without row padding, as byte planes if shuffle is set
+static void copyCloudPoints(const sensor_msgs::PointCloud2& cloud, std::vector<uint8_t>& data, bool shuffle)
+{
+    const size_t width = cloud.width;
+    const size_t point_step = cloud.point_step;
+    const size_t num_points = width * cloud.height;
+    data.resize(num_points * point_step);
+    for (size_t row = 0; row < cloud.height; row++)
+    {
+        const uint8_t* in = cloud.data.data() + row * cloud.row_step;
+        if (!shuffle)
+        {
+            std::copy(in, in + width * point_step, data.begin() + row * width * point_step);
+            continue;
+        }
+        for (size_t i = 0; i < width; i++)
+        {
+            const size_t index = row * width + i;
+            for (size_t k = 0; k < point_step; k++)
+            {
+                data[k * num_points + index] = in[i * point_step + k];
+            }
+        }
+    }
+}
+
+bool fromPointCloud2ToCompressedPointCloud(
+    const sensor_msgs::PointCloud2& cloud,
+    lvr_ros::CompressedPointCloud& compressed,
+    int compression_level
+)
+{
+    const size_t num_points = static_cast<size_t>(cloud.width) * cloud.height;
+    const size_t size = num_points * cloud.point_step;
+    if (cloud.row_step < static_cast<size_t>(cloud.width) * cloud.point_step
+        || cloud.data.size() < static_cast<size_t>(cloud.row_step) * cloud.height)
+    {
+        ROS_ERROR_STREAM("The point cloud data is smaller than its dimensions, can not compress it!");
+        return false;
+    }
+    if (size > std::numeric_limits<uint32_t>::max())
+    {
+        ROS_ERROR_STREAM("The point cloud is too large to compress it!");
+        return false;
+    }
+
+    compressed.header = cloud.header;
+    compressed.height = cloud.height;
+    compressed.width = cloud.width;
+    compressed.fields = cloud.fields;
+    compressed.is_bigendian = cloud.is_bigendian;
+    compressed.point_step = cloud.point_step;
+    compressed.is_dense = cloud.is_dense;
+    compressed.compression = lvr_ros::CompressedPointCloud::COMPRESSION_NONE;
+    compressed.uncompressed_size = static_cast<uint32_t>(size);
+
+#ifdef ZSTD_FOUND
+    if (compression_level > 0 && size > 0)
+    {
+        std::vector<uint8_t> planes;
+        copyCloudPoints(cloud, planes, true);
+        compressed.data.resize(ZSTD_compressBound(size));
+        const size_t compressed_size = ZSTD_compress(
+            compressed.data.data(),
+            compressed.data.size(),
+            planes.data(),
+            planes.size(),
+            compression_level
+        );
+        if (ZSTD_isError(compressed_size))
+        {
+            ROS_WARN_STREAM("zstd compression failed: " << ZSTD_getErrorName(compressed_size)
+                << ", send uncompressed.");
+        }
+        else
+        {
+            compressed.data.resize(compressed_size);
+            compressed.compression = lvr_ros::CompressedPointCloud::COMPRESSION_ZSTD;
+            return true;
+        }
+    }
+#endif
+
+    copyCloudPoints(cloud, compressed.data, false);
+    return true;
+}
+
+bool fromCompressedPointCloudToPointCloud2(
+    const lvr_ros::CompressedPointCloud& compressed,
+    sensor_msgs::PointCloud2& cloud
+)
+{
+    const size_t num_points = static_cast<size_t>(compressed.width) * compressed.height;
+    const size_t point_step = compressed.point_step;
+    if (compressed.uncompressed_size != num_points * point_step)
+    {
+        ROS_ERROR_STREAM("The size of the compressed point cloud does not match its dimensions!");
+        return false;
+    }
+
+    cloud.header = compressed.header;
+    cloud.height = compressed.height;
+    cloud.width = compressed.width;
+    cloud.fields = compressed.fields;
+    cloud.is_bigendian = compressed.is_bigendian;
+    cloud.point_step = compressed.point_step;
+    cloud.row_step = compressed.width * compressed.point_step;
+    cloud.is_dense = compressed.is_dense;
+
+    if (compressed.compression == lvr_ros::CompressedPointCloud::COMPRESSION_NONE)
+    {
+        if (compressed.data.size() != compressed.uncompressed_size)
+        {
+            ROS_ERROR_STREAM("The size of the point cloud data does not match its dimensions!");
+            return false;
+        }
+        cloud.data = compressed.data;
+        return true;
+    }
+    if (compressed.compression != lvr_ros::CompressedPointCloud::COMPRESSION_ZSTD)
+    {
+        ROS_ERROR_STREAM("Unknown point cloud compression " << int(compressed.compression) << "!");
+        return false;
+    }
+
+#ifdef ZSTD_FOUND
+    // The size of the message has to match the frame, before it is allocated
+    if (ZSTD_getFrameContentSize(compressed.data.data(), compressed.data.size()) != compressed.uncompressed_size)
+    {
+        ROS_ERROR_STREAM("The size of the point cloud does not match its zstd frame!");
+        return false;
+    }
+    std::vector<uint8_t> planes(compressed.uncompressed_size);
+    const size_t size = ZSTD_decompress(
+        planes.data(),
+        planes.size(),
+        compressed.data.data(),
+        compressed.data.size()
+    );
+    if (ZSTD_isError(size) || size != compressed.uncompressed_size)
+    {
+        ROS_ERROR_STREAM("Could not decompress the point cloud!");
+        return false;
+    }
+
+    cloud.data.resize(planes.size());
+    for (size_t k = 0; k < point_step; k++)
+    {
+        const uint8_t* plane = planes.data() + k * num_points;
+        for (size_t i = 0; i < num_points; i++)
+        {
+            cloud.data[i * point_step + k] = plane[i];
+        }
+    }
+    return true;
+#else
+    ROS_ERROR_STREAM("The point cloud is zstd compressed, but lvr_ros was built without zstd!");
+    return false;
+#endif
+}
+
 } // end namespace
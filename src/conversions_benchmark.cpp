@@ -0,0 +1,382 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * conversions_benchmark.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/PointField.h>
+
+#include "lvr_ros/colors.h"
+#include "lvr_ros/conversions.h"
+
+/*
+ * Micro benchmarks of the conversions library on synthetic point clouds and meshes.
+ *
+ * Usage: conversions_benchmark [--benchmark_filter=<regex>] [further Google Benchmark options]
+ *
+ * Runs offline, no ROS master is needed. Besides the throughput, every benchmark reports the number of heap
+ * allocations per iteration.
+ */
+
+// Heap allocations of the whole process, counted by the replaced global operator new
+static std::atomic<size_t> num_allocations(0);
+
+void* operator new(size_t size)
+{
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+/// Counts the allocations between construction and report
+class AllocationCounter
+{
+public:
+    AllocationCounter() : start(num_allocations.load()) {}
+
+    void report(benchmark::State& state) const
+    {
+        state.counters["allocs"] = benchmark::Counter(
+            static_cast<double>(num_allocations.load() - start),
+            benchmark::Counter::kAvgIterations
+        );
+    }
+
+private:
+    size_t start;
+};
+
+/// Field layouts of the synthetic clouds, combined as bit flags in the second benchmark argument
+enum CloudLayout
+{
+    CLOUD_NANS = 1,
+    CLOUD_NORMALS = 2,
+    CLOUD_COLORS = 4,
+    CLOUD_INTENSITIES = 8
+};
+
+static void addField(sensor_msgs::PointCloud2& cloud, const std::string& name, uint8_t datatype, uint32_t size)
+{
+    sensor_msgs::PointField field;
+    field.name = name;
+    field.offset = cloud.point_step;
+    field.datatype = datatype;
+    field.count = 1;
+    cloud.fields.push_back(field);
+    cloud.point_step += size;
+}
+
+/// A noisy plane with the given fields, every tenth point is NaN if requested
+static sensor_msgs::PointCloud2 createCloud(size_t num_points, int layout)
+{
+    sensor_msgs::PointCloud2 cloud;
+    cloud.height = 1;
+    cloud.width = num_points;
+    cloud.is_dense = !(layout & CLOUD_NANS);
+    cloud.point_step = 0;
+    for (const char* name : {"x", "y", "z"})
+    {
+        addField(cloud, name, sensor_msgs::PointField::FLOAT32, 4);
+    }
+    if (layout & CLOUD_NORMALS)
+    {
+        for (const char* name : {"normal_x", "normal_y", "normal_z"})
+        {
+            addField(cloud, name, sensor_msgs::PointField::FLOAT32, 4);
+        }
+    }
+    if (layout & CLOUD_COLORS)
+    {
+        addField(cloud, "rgb", sensor_msgs::PointField::FLOAT32, 4);
+    }
+    if (layout & CLOUD_INTENSITIES)
+    {
+        addField(cloud, "intensities", sensor_msgs::PointField::FLOAT32, 4);
+    }
+    cloud.row_step = cloud.point_step * cloud.width;
+    cloud.data.resize(cloud.row_step);
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> noise(-0.01f, 0.01f);
+    const size_t side = std::max<size_t>(1, std::sqrt(num_points));
+    for (size_t i = 0; i < num_points; i++)
+    {
+        float values[8] = {
+            (i % side) * 0.01f,
+            (i / side) * 0.01f,
+            noise(random),
+            0.0f, 0.0f, 1.0f,
+            0.0f,
+            static_cast<float>(i % 256)
+        };
+        if ((layout & CLOUD_NANS) && i % 10 == 0)
+        {
+            values[0] = values[1] = values[2] = std::numeric_limits<float>::quiet_NaN();
+        }
+        const uint8_t rgb[4] = {static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8), 128, 0};
+        std::memcpy(&values[6], rgb, sizeof(rgb));
+
+        uint8_t* point = &cloud.data[i * cloud.point_step];
+        std::memcpy(point, values, 12);
+        size_t offset = 12;
+        if (layout & CLOUD_NORMALS)
+        {
+            std::memcpy(point + offset, &values[3], 12);
+            offset += 12;
+        }
+        if (layout & CLOUD_COLORS)
+        {
+            std::memcpy(point + offset, &values[6], 4);
+            offset += 4;
+        }
+        if (layout & CLOUD_INTENSITIES)
+        {
+            std::memcpy(point + offset, &values[7], 4);
+        }
+    }
+    return cloud;
+}
+
+/// A grid mesh with size x size vertices, with normals and colors
+static lvr2::MeshBufferPtr createMeshBuffer(size_t size)
+{
+    const size_t num_vertices = size * size;
+    const size_t num_faces = 2 * (size - 1) * (size - 1);
+    lvr2::floatArr vertices(new float[num_vertices * 3]);
+    lvr2::floatArr normals(new float[num_vertices * 3]);
+    lvr2::ucharArr colors(new unsigned char[num_vertices * 3]);
+    lvr2::indexArray faces(new unsigned int[num_faces * 3]);
+
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        vertices[3 * i] = (i % size) * 0.05f;
+        vertices[3 * i + 1] = (i / size) * 0.05f;
+        vertices[3 * i + 2] = std::sin(vertices[3 * i]) * 0.2f;
+        normals[3 * i] = 0;
+        normals[3 * i + 1] = 0;
+        normals[3 * i + 2] = 1;
+        colors[3 * i] = i % 256;
+        colors[3 * i + 1] = 128;
+        colors[3 * i + 2] = 255 - i % 256;
+    }
+
+    size_t f = 0;
+    for (unsigned int y = 0; y + 1 < size; y++)
+    {
+        for (unsigned int x = 0; x + 1 < size; x++)
+        {
+            const unsigned int i = y * size + x;
+            const unsigned int indices[6] = {i, i + 1, i + size, i + 1, i + size + 1, i + size};
+            std::memcpy(&faces[f], indices, sizeof(indices));
+            f += 6;
+        }
+    }
+
+    lvr2::MeshBufferPtr buffer(new lvr2::MeshBuffer);
+    buffer->setVertices(vertices, num_vertices);
+    buffer->setFaceIndices(faces, num_faces);
+    buffer->setVertexNormals(normals);
+    buffer->setVertexColors(colors);
+    return buffer;
+}
+
+static void BM_PointCloud2ToPointBuffer(benchmark::State& state)
+{
+    const sensor_msgs::PointCloud2 cloud = createCloud(state.range(0), state.range(1));
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        lvr2::PointBuffer buffer;
+        benchmark::DoNotOptimize(lvr_ros::fromPointCloud2ToPointBuffer(cloud, buffer));
+    }
+    allocations.report(state);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * cloud.data.size());
+}
+static void cloudArguments(benchmark::internal::Benchmark* benchmark)
+{
+    const int all = CLOUD_NORMALS | CLOUD_COLORS | CLOUD_INTENSITIES;
+    for (int num_points : {10000, 100000, 1000000})
+    {
+        for (int layout : {0, static_cast<int>(CLOUD_NANS), all, CLOUD_NANS | all})
+        {
+            benchmark->Args({num_points, layout});
+        }
+    }
+}
+BENCHMARK(BM_PointCloud2ToPointBuffer)->Apply(cloudArguments)->Unit(benchmark::kMillisecond);
+
+static void BM_MeshBufferToMeshMessages(benchmark::State& state)
+{
+    const lvr2::MeshBufferPtr buffer = createMeshBuffer(state.range(0));
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        mesh_msgs::MeshGeometry geometry;
+        mesh_msgs::MeshMaterials materials;
+        mesh_msgs::MeshVertexColors colors;
+        std::vector<mesh_msgs::MeshTexture> textures;
+        benchmark::DoNotOptimize(
+            lvr_ros::fromMeshBufferToMeshMessages(buffer, geometry, materials, colors, textures, "benchmark")
+        );
+    }
+    allocations.report(state);
+    state.SetItemsProcessed(state.iterations() * buffer->numVertices());
+    // Vertices, normals and colors of the buffer plus the face indices
+    state.SetBytesProcessed(state.iterations() * (buffer->numVertices() * 27 + buffer->numFaces() * 12));
+}
+BENCHMARK(BM_MeshBufferToMeshMessages)->Arg(100)->Arg(300)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+static void BM_MeshGeometryToMeshBuffer(benchmark::State& state)
+{
+    mesh_msgs::MeshGeometry geometry;
+    lvr_ros::fromMeshBufferToMeshGeometryMessage(createMeshBuffer(state.range(0)), geometry);
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        lvr2::MeshBuffer buffer;
+        benchmark::DoNotOptimize(lvr_ros::fromMeshGeometryToMeshBuffer(geometry, buffer));
+    }
+    allocations.report(state);
+    state.SetItemsProcessed(state.iterations() * geometry.vertices.size());
+    state.SetBytesProcessed(state.iterations()
+        * (24 * (geometry.vertices.size() + geometry.vertex_normals.size()) + 12 * geometry.faces.size()));
+}
+BENCHMARK(BM_MeshGeometryToMeshBuffer)->Arg(100)->Arg(300)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+static void BM_ToMeshGeometry(benchmark::State& state)
+{
+    using Vec = lvr2::BaseVector<float>;
+    const size_t size = state.range(0);
+    lvr2::HalfEdgeMesh<Vec> mesh;
+    std::vector<lvr2::VertexHandle> handles;
+    for (size_t i = 0; i < size * size; i++)
+    {
+        handles.push_back(mesh.addVertex(Vec((i % size) * 0.05f, (i / size) * 0.05f, 0)));
+    }
+    for (size_t y = 0; y + 1 < size; y++)
+    {
+        for (size_t x = 0; x + 1 < size; x++)
+        {
+            const size_t i = y * size + x;
+            mesh.addFace(handles[i], handles[i + 1], handles[i + size]);
+            mesh.addFace(handles[i + 1], handles[i + size + 1], handles[i + size]);
+        }
+    }
+    lvr2::DenseVertexMap<lvr2::Normal<float>> normals;
+    for (auto vH : mesh.vertices())
+    {
+        normals.insert(vH, lvr2::Normal<float>(0, 0, 1));
+    }
+
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(lvr_ros::toMeshGeometry<float>(mesh, normals));
+    }
+    allocations.report(state);
+    state.SetItemsProcessed(state.iterations() * mesh.numVertices());
+    state.SetBytesProcessed(state.iterations() * (48 * mesh.numVertices() + 12 * mesh.numFaces()));
+}
+BENCHMARK(BM_ToMeshGeometry)->Arg(100)->Arg(300)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+static std::vector<float> createIntensities(size_t size)
+{
+    std::vector<float> intensities(size);
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> distribution(0, 1000);
+    for (float& intensity : intensities)
+    {
+        intensity = distribution(random);
+    }
+    return intensities;
+}
+
+static void BM_IntensityToVertexRainbowColors(benchmark::State& state)
+{
+    const std::vector<float> intensities = createIntensities(state.range(0));
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        mesh_msgs::TriangleMesh mesh;
+        lvr_ros::intensityToVertexRainbowColors(intensities, mesh);
+        benchmark::DoNotOptimize(mesh.vertex_colors.data());
+    }
+    allocations.report(state);
+    state.SetItemsProcessed(state.iterations() * intensities.size());
+    state.SetBytesProcessed(state.iterations() * intensities.size() * (sizeof(float) + sizeof(std_msgs::ColorRGBA)));
+}
+BENCHMARK(BM_IntensityToVertexRainbowColors)->Range(1 << 12, 1 << 23)->Unit(benchmark::kMillisecond);
+
+static void BM_ApplyColormap(benchmark::State& state)
+{
+    const std::vector<float> values = createIntensities(state.range(0));
+    std::vector<std_msgs::ColorRGBA> colors(values.size());
+    AllocationCounter allocations;
+    for (auto _ : state)
+    {
+        float min, max;
+        lvr_ros::getFiniteRange(values.data(), values.size(), min, max);
+        lvr_ros::applyColormap(values.data(), values.size(), min, max, lvr_ros::Colormap::VIRIDIS, colors.data());
+        benchmark::DoNotOptimize(colors.data());
+    }
+    allocations.report(state);
+    state.SetItemsProcessed(state.iterations() * values.size());
+    state.SetBytesProcessed(state.iterations() * values.size() * (sizeof(float) + sizeof(std_msgs::ColorRGBA)));
+}
+BENCHMARK(BM_ApplyColormap)->Range(1 << 12, 1 << 23)->Unit(benchmark::kMillisecond);
+
+int main(int argc, char** argv)
+{
+    // Time stamps of the conversions work without a ROS master
+    ros::Time::init();
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,1229 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * hdf5_mesh_io.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+#include "lvr_ros/hdf5_mesh_io.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <limits>
+#include <map>
+#include <set>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <hdf5_hl.h>
+#include <ros/console.h>
+
+namespace lvr_ros
+{
+
+Hdf5MeshReader::Hdf5MeshReader(
+    const std::string& filename,
+    const std::string& mesh_name,
+    size_t block_rows,
+    bool use_mmap
+)
+    : file(-1),
+      file_descriptor(-1),
+      group_path("/meshes/" + mesh_name),
+      block_rows(std::max<size_t>(block_rows, 1)),
+      use_mmap(use_mmap)
+{
+    // HDF5 prints the whole error stack for every failing call, we report errors ourselves
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+
+    file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file < 0)
+    {
+        ROS_ERROR_STREAM("Could not open HDF5 file \"" << filename << "\"!");
+        return;
+    }
+
+    if (H5Lexists(file, "/meshes", H5P_DEFAULT) <= 0 || H5Lexists(file, group_path.c_str(), H5P_DEFAULT) <= 0)
+    {
+        ROS_ERROR_STREAM("HDF5 file \"" << filename << "\" contains no mesh group \"" << group_path << "\"!");
+        H5Fclose(file);
+        file = -1;
+        return;
+    }
+
+    if (use_mmap)
+    {
+        // Dataset addresses are relative to the end of the user block, only map files without one
+        hsize_t user_block = 0;
+        hid_t fcpl = H5Fget_create_plist(file);
+        H5Pget_userblock(fcpl, &user_block);
+        H5Pclose(fcpl);
+        if (user_block == 0)
+        {
+            file_descriptor = open(filename.c_str(), O_RDONLY);
+        }
+    }
+}
+
+Hdf5MeshReader::~Hdf5MeshReader()
+{
+    if (file_descriptor >= 0)
+    {
+        close(file_descriptor);
+    }
+    if (file >= 0)
+    {
+        H5Fclose(file);
+    }
+}
+
+bool Hdf5MeshReader::isOpen() const
+{
+    return file >= 0;
+}
+
+bool Hdf5MeshReader::hasDataset(const std::string& name) const
+{
+    return isOpen() && H5Lexists(file, (group_path + "/" + name).c_str(), H5P_DEFAULT) > 0;
+}
+
+bool Hdf5MeshReader::datasetShape(const std::string& name, hsize_t& rows, hsize_t& cols) const
+{
+    if (!hasDataset(name))
+    {
+        return false;
+    }
+    hid_t dataset = H5Dopen2(file, (group_path + "/" + name).c_str(), H5P_DEFAULT);
+    if (dataset < 0)
+    {
+        return false;
+    }
+    hid_t space = H5Dget_space(dataset);
+    hsize_t dims[2] = {0, 1};
+    int rank = H5Sget_simple_extent_ndims(space);
+    bool valid = rank == 1 || rank == 2;
+    if (valid)
+    {
+        H5Sget_simple_extent_dims(space, dims, NULL);
+    }
+    H5Sclose(space);
+    H5Dclose(dataset);
+
+    rows = dims[0];
+    cols = rank == 2 ? dims[1] : 1;
+    return valid;
+}
+
+H5T_class_t Hdf5MeshReader::datasetClass(const std::string& name) const
+{
+    if (!hasDataset(name))
+    {
+        return H5T_NO_CLASS;
+    }
+    hid_t dataset = H5Dopen2(file, (group_path + "/" + name).c_str(), H5P_DEFAULT);
+    if (dataset < 0)
+    {
+        return H5T_NO_CLASS;
+    }
+    hid_t type = H5Dget_type(dataset);
+    const H5T_class_t type_class = H5Tget_class(type);
+    H5Tclose(type);
+    H5Dclose(dataset);
+    return type_class;
+}
+
+bool Hdf5MeshReader::datasetInFile(hid_t dataset, hsize_t rows, hsize_t cols, size_t element_size) const
+{
+    // Only contiguous datasets have an offset, the library checks the chunks of the others
+    const haddr_t offset = H5Dget_offset(dataset);
+    if (offset == HADDR_UNDEF)
+    {
+        return true;
+    }
+
+    // The library only knows the size of the file when it was opened, the mapped file may have changed since
+    hsize_t file_size = 0;
+    struct stat file_stat;
+    if (file_descriptor >= 0 && fstat(file_descriptor, &file_stat) == 0)
+    {
+        file_size = static_cast<hsize_t>(file_stat.st_size);
+    }
+    else if (H5Fget_filesize(file, &file_size) < 0)
+    {
+        return true;
+    }
+
+    // Memory mapped pages beyond the end of a truncated file raise SIGBUS when they are read
+    const hsize_t max_rows = cols > 0 ? std::numeric_limits<hsize_t>::max() / cols / element_size : rows;
+    if (rows > max_rows || offset > file_size || rows * cols * element_size > file_size - offset)
+    {
+        ROS_ERROR_STREAM("Dataset of " << rows << " x " << cols << " elements ends beyond the end of the file, "
+            "the file is truncated!");
+        return false;
+    }
+    return true;
+}
+
+template<typename T, typename BlockFunc>
+bool Hdf5MeshReader::readRows(const std::string& name, hid_t mem_type, BlockFunc block_func)
+{
+    hid_t dataset = H5Dopen2(file, (group_path + "/" + name).c_str(), H5P_DEFAULT);
+    if (dataset < 0)
+    {
+        ROS_ERROR_STREAM("Could not open dataset \"" << group_path << "/" << name << "\"!");
+        return false;
+    }
+
+    hid_t space = H5Dget_space(dataset);
+    hsize_t dims[2] = {0, 1};
+    int rank = H5Sget_simple_extent_ndims(space);
+    if (rank == 1 || rank == 2)
+    {
+        H5Sget_simple_extent_dims(space, dims, NULL);
+    }
+    H5Sclose(space);
+
+    bool success = false;
+    if (rank == 1 || rank == 2)
+    {
+        const hsize_t rows = dims[0];
+        const hsize_t cols = rank == 2 ? dims[1] : 1;
+        success = datasetInFile(dataset, rows, cols, sizeof(T))
+            && (mapRows<T>(dataset, mem_type, rows, cols, block_func)
+                || readBlocks<T>(dataset, mem_type, rank, rows, cols, block_func));
+    }
+    H5Dclose(dataset);
+
+    if (!success)
+    {
+        ROS_ERROR_STREAM("Could not read dataset \"" << group_path << "/" << name << "\"!");
+    }
+    return success;
+}
+
+template<typename T, typename BlockFunc>
+bool Hdf5MeshReader::mapRows(hid_t dataset, hid_t mem_type, hsize_t rows, hsize_t cols, BlockFunc& block_func)
+{
+    if (file_descriptor < 0 || rows == 0)
+    {
+        return false;
+    }
+
+    // Only datasets stored as one plain block in native byte order can be used in place
+    hid_t dcpl = H5Dget_create_plist(dataset);
+    const bool contiguous = H5Pget_layout(dcpl) == H5D_CONTIGUOUS && H5Pget_nfilters(dcpl) == 0;
+    H5Pclose(dcpl);
+
+    hid_t file_type = H5Dget_type(dataset);
+    const bool native = H5Tequal(file_type, mem_type) > 0;
+    H5Tclose(file_type);
+
+    const haddr_t offset = H5Dget_offset(dataset);
+    if (!contiguous || !native || offset == HADDR_UNDEF)
+    {
+        return false;
+    }
+
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t page_offset = offset % page_size;
+    const size_t length = rows * cols * sizeof(T) + page_offset;
+
+    void* address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, file_descriptor, offset - page_offset);
+    if (address == MAP_FAILED)
+    {
+        return false;
+    }
+    madvise(address, length, MADV_SEQUENTIAL);
+
+    ROS_DEBUG_STREAM("Memory mapped " << rows << " x " << cols << " dataset.");
+    const T* data = reinterpret_cast<const T*>(static_cast<const char*>(address) + page_offset);
+    block_func(data, 0, rows, cols);
+
+    munmap(address, length);
+    return true;
+}
+
+template<typename T, typename BlockFunc>
+bool Hdf5MeshReader::readBlocks(
+    hid_t dataset,
+    hid_t mem_type,
+    int rank,
+    hsize_t rows,
+    hsize_t cols,
+    BlockFunc& block_func
+)
+{
+    if (rows == 0)
+    {
+        return true;
+    }
+
+    // Align the blocks to the chunk layout, so that every chunk is decompressed only once
+    hsize_t block = block_rows;
+    hid_t dcpl = H5Dget_create_plist(dataset);
+    if (H5Pget_layout(dcpl) == H5D_CHUNKED)
+    {
+        hsize_t chunk_dims[2] = {1, 1};
+        if (H5Pget_chunk(dcpl, rank, chunk_dims) > 0 && chunk_dims[0] > 0)
+        {
+            block = std::max<hsize_t>(1, block / chunk_dims[0]) * chunk_dims[0];
+        }
+    }
+    H5Pclose(dcpl);
+    block = std::min(block, rows);
+
+    hid_t file_space = H5Dget_space(dataset);
+    std::vector<T> buffers[2];
+    buffers[0].resize(block * cols);
+    buffers[1].resize(block * cols);
+
+    // Only one thread at a time calls into the HDF5 library: the reading one
+    auto read_block = [&](hsize_t first, hsize_t count, std::vector<T>* buffer)
+    {
+        hsize_t start[2] = {first, 0};
+        hsize_t extent[2] = {count, cols};
+        H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL, extent, NULL);
+        hid_t mem_space = H5Screate_simple(rank, extent, NULL);
+        herr_t status = H5Dread(dataset, mem_type, mem_space, file_space, H5P_DEFAULT, buffer->data());
+        H5Sclose(mem_space);
+        return status >= 0;
+    };
+
+    bool success = read_block(0, block, &buffers[0]);
+    hsize_t first = 0;
+    hsize_t count = block;
+    size_t current = 0;
+    while (success && count > 0)
+    {
+        const hsize_t next_first = first + count;
+        const hsize_t next_count = std::min(block, rows - next_first);
+
+        // Read the next block while the current one is converted
+        std::future<bool> next_block;
+        if (next_count > 0)
+        {
+            next_block = std::async(std::launch::async, read_block, next_first, next_count, &buffers[1 - current]);
+        }
+
+        block_func(buffers[current].data(), first, count, cols);
+
+        if (next_block.valid())
+        {
+            success = next_block.get();
+        }
+        first = next_first;
+        count = next_count;
+        current = 1 - current;
+    }
+
+    H5Sclose(file_space);
+    return success;
+}
+
+bool Hdf5MeshReader::readGeometry(mesh_msgs::MeshGeometry& mesh_geometry)
+{
+    hsize_t n_vertices, n_faces, cols;
+    if (!datasetShape("vertices", n_vertices, cols) || cols < 3)
+    {
+        ROS_ERROR_STREAM("Mesh \"" << group_path << "\" has no valid vertices!");
+        return false;
+    }
+    if (!datasetShape("indices", n_faces, cols) || cols < 3)
+    {
+        ROS_ERROR_STREAM("Mesh \"" << group_path << "\" has no valid face indices!");
+        return false;
+    }
+
+    ROS_DEBUG_STREAM("Read " << n_vertices << " vertices from \"" << group_path << "\".");
+    mesh_geometry.vertices.resize(n_vertices);
+    bool success = readRows<float>(
+        "vertices",
+        H5T_NATIVE_FLOAT,
+        [&mesh_geometry](const float* data, size_t first, size_t count, size_t cols)
+        {
+            #pragma omp parallel for
+            for (size_t i = 0; i < count; i++)
+            {
+                geometry_msgs::Point& p = mesh_geometry.vertices[first + i];
+                p.x = data[i * cols];
+                p.y = data[i * cols + 1];
+                p.z = data[i * cols + 2];
+            }
+        }
+    );
+
+    ROS_DEBUG_STREAM("Read " << n_faces << " faces from \"" << group_path << "\".");
+    mesh_geometry.faces.resize(n_faces);
+    bool valid_faces = true;
+    success = success && readRows<uint32_t>(
+        "indices",
+        H5T_NATIVE_UINT32,
+        [&mesh_geometry, &valid_faces, n_vertices](const uint32_t* data, size_t first, size_t count, size_t cols)
+        {
+            bool valid = true;
+            #pragma omp parallel for reduction(&&:valid)
+            for (size_t i = 0; i < count; i++)
+            {
+                mesh_msgs::TriangleIndices& face = mesh_geometry.faces[first + i];
+                face.vertex_indices[0] = data[i * cols];
+                face.vertex_indices[1] = data[i * cols + 1];
+                face.vertex_indices[2] = data[i * cols + 2];
+                valid = valid && face.vertex_indices[0] < n_vertices && face.vertex_indices[1] < n_vertices
+                    && face.vertex_indices[2] < n_vertices;
+            }
+            valid_faces = valid_faces && valid;
+        }
+    );
+    if (success && !valid_faces)
+    {
+        ROS_ERROR_STREAM("Mesh \"" << group_path << "\" has faces with vertex indices out of range!");
+        return false;
+    }
+
+    hsize_t n_normals;
+    if (success && datasetShape("vertex_normals", n_normals, cols) && n_normals == n_vertices && cols >= 3)
+    {
+        ROS_DEBUG_STREAM("Read vertex normals from \"" << group_path << "\".");
+        mesh_geometry.vertex_normals.resize(n_normals);
+        success = readRows<float>(
+            "vertex_normals",
+            H5T_NATIVE_FLOAT,
+            [&mesh_geometry](const float* data, size_t first, size_t count, size_t cols)
+            {
+                #pragma omp parallel for
+                for (size_t i = 0; i < count; i++)
+                {
+                    geometry_msgs::Point& n = mesh_geometry.vertex_normals[first + i];
+                    n.x = data[i * cols];
+                    n.y = data[i * cols + 1];
+                    n.z = data[i * cols + 2];
+                }
+            }
+        );
+    }
+    else
+    {
+        mesh_geometry.vertex_normals.clear();
+        ROS_DEBUG_STREAM("No vertex normals given!");
+    }
+
+    return success;
+}
+
+bool Hdf5MeshReader::readMaterials(mesh_msgs::MeshMaterials& mesh_materials)
+{
+    hsize_t rows, cols;
+    bool success = true;
+
+    mesh_materials.materials.clear();
+    if (datasetShape("material_colors", rows, cols) && cols >= 3)
+    {
+        mesh_materials.materials.resize(rows);
+        success = readRows<uint8_t>(
+            "material_colors",
+            H5T_NATIVE_UINT8,
+            [&mesh_materials](const uint8_t* data, size_t first, size_t count, size_t cols)
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    mesh_msgs::MeshMaterial& material = mesh_materials.materials[first + i];
+                    material.color.r = data[i * cols] / 255.0;
+                    material.color.g = data[i * cols + 1] / 255.0;
+                    material.color.b = data[i * cols + 2] / 255.0;
+                    material.color.a = 1.0;
+                    material.has_texture = false;
+                    material.texture_index = 0;
+                }
+            }
+        );
+
+        if (success && datasetShape("material_textures", rows, cols) && rows == mesh_materials.materials.size())
+        {
+            success = readRows<int32_t>(
+                "material_textures",
+                H5T_NATIVE_INT32,
+                [&mesh_materials](const int32_t* data, size_t first, size_t count, size_t cols)
+                {
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        mesh_msgs::MeshMaterial& material = mesh_materials.materials[first + i];
+                        material.has_texture = data[i * cols] >= 0;
+                        material.texture_index = material.has_texture ? data[i * cols] : 0;
+                    }
+                }
+            );
+        }
+    }
+
+    // Group the faces into one cluster per material
+    mesh_materials.clusters.clear();
+    mesh_materials.cluster_materials.clear();
+    if (success && datasetShape("face_materials", rows, cols))
+    {
+        std::vector<uint32_t> face_materials(rows);
+        success = readRows<uint32_t>(
+            "face_materials",
+            H5T_NATIVE_UINT32,
+            [&face_materials](const uint32_t* data, size_t first, size_t count, size_t cols)
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    face_materials[first + i] = data[i * cols];
+                }
+            }
+        );
+
+        std::map<uint32_t, size_t> cluster_of_material;
+        for (size_t i = 0; success && i < face_materials.size(); i++)
+        {
+            auto inserted = cluster_of_material.insert(
+                std::make_pair(face_materials[i], mesh_materials.clusters.size())
+            );
+            if (inserted.second)
+            {
+                mesh_materials.clusters.emplace_back();
+                mesh_materials.cluster_materials.push_back(face_materials[i]);
+            }
+            mesh_materials.clusters[inserted.first->second].face_indices.push_back(i);
+        }
+    }
+
+    mesh_materials.vertex_tex_coords.clear();
+    if (success && datasetShape("texture_coordinates", rows, cols) && cols >= 2)
+    {
+        mesh_materials.vertex_tex_coords.resize(rows);
+        success = readRows<float>(
+            "texture_coordinates",
+            H5T_NATIVE_FLOAT,
+            [&mesh_materials](const float* data, size_t first, size_t count, size_t cols)
+            {
+                #pragma omp parallel for
+                for (size_t i = 0; i < count; i++)
+                {
+                    mesh_msgs::MeshVertexTexCoords& tex_coords = mesh_materials.vertex_tex_coords[first + i];
+                    tex_coords.u = data[i * cols];
+                    tex_coords.v = data[i * cols + 1];
+                }
+            }
+        );
+    }
+
+    return success;
+}
+
+bool Hdf5MeshReader::readVertexColors(mesh_msgs::MeshVertexColors& mesh_vertex_colors)
+{
+    hsize_t rows, cols;
+    mesh_vertex_colors.vertex_colors.clear();
+    if (!datasetShape("vertex_colors", rows, cols) || cols < 3)
+    {
+        return false;
+    }
+
+    mesh_vertex_colors.vertex_colors.resize(rows);
+    if (datasetClass("vertex_colors") == H5T_FLOAT)
+    {
+        // Colors of messages, e.g. colormapped intensities, are stored unquantized
+        return readRows<float>(
+            "vertex_colors",
+            H5T_NATIVE_FLOAT,
+            [&mesh_vertex_colors](const float* data, size_t first, size_t count, size_t cols)
+            {
+                #pragma omp parallel for
+                for (size_t i = 0; i < count; i++)
+                {
+                    std_msgs::ColorRGBA& color = mesh_vertex_colors.vertex_colors[first + i];
+                    color.r = data[i * cols];
+                    color.g = data[i * cols + 1];
+                    color.b = data[i * cols + 2];
+                    color.a = cols > 3 ? data[i * cols + 3] : 1.0;
+                }
+            }
+        );
+    }
+
+    return readRows<uint8_t>(
+        "vertex_colors",
+        H5T_NATIVE_UINT8,
+        [&mesh_vertex_colors](const uint8_t* data, size_t first, size_t count, size_t cols)
+        {
+            #pragma omp parallel for
+            for (size_t i = 0; i < count; i++)
+            {
+                std_msgs::ColorRGBA& color = mesh_vertex_colors.vertex_colors[first + i];
+                color.r = data[i * cols] / 255.0;
+                color.g = data[i * cols + 1] / 255.0;
+                color.b = data[i * cols + 2] / 255.0;
+                color.a = 1.0;
+            }
+        }
+    );
+}
+
+bool Hdf5MeshReader::readVertexIntensities(std::vector<float>& vertex_intensities)
+{
+    hsize_t rows, cols;
+    vertex_intensities.clear();
+    if (!datasetShape("vertex_intensities", rows, cols) || cols != 1)
+    {
+        return false;
+    }
+
+    vertex_intensities.resize(rows);
+    return readRows<float>(
+        "vertex_intensities",
+        H5T_NATIVE_FLOAT,
+        [&vertex_intensities](const float* data, size_t first, size_t count, size_t cols)
+        {
+            std::copy(data, data + count, vertex_intensities.begin() + first);
+        }
+    );
+}
+
+bool Hdf5MeshReader::readTextures(std::vector<mesh_msgs::MeshTexture>& textures, const std::string& mesh_uuid)
+{
+    textures.clear();
+    const std::string textures_path = group_path + "/textures";
+    if (!isOpen() || H5Lexists(file, textures_path.c_str(), H5P_DEFAULT) <= 0)
+    {
+        return true;
+    }
+
+    hid_t group = H5Gopen2(file, textures_path.c_str(), H5P_DEFAULT);
+    H5G_info_t info;
+    if (group < 0 || H5Gget_info(group, &info) < 0)
+    {
+        ROS_ERROR_STREAM("Could not open texture group \"" << textures_path << "\"!");
+        return false;
+    }
+
+    bool success = true;
+    textures.resize(info.nlinks);
+    for (size_t i = 0; success && i < info.nlinks; i++)
+    {
+        const std::string name = std::to_string(i);
+        hid_t dataset = H5Dopen2(group, name.c_str(), H5P_DEFAULT);
+        if (dataset < 0)
+        {
+            ROS_ERROR_STREAM("Texture " << i << " is missing in \"" << textures_path << "\"!");
+            success = false;
+            break;
+        }
+
+        hid_t space = H5Dget_space(dataset);
+        hsize_t dims[3] = {0, 0, 1};
+        int rank = H5Sget_simple_extent_ndims(space);
+        if (rank == 2 || rank == 3)
+        {
+            H5Sget_simple_extent_dims(space, dims, NULL);
+        }
+        const hssize_t num_elements = H5Sget_simple_extent_npoints(space);
+        H5Sclose(space);
+
+        // The whole dataset is read into the image, its shape has to match
+        if ((rank != 2 && rank != 3) || num_elements < 0
+            || static_cast<hsize_t>(num_elements) != dims[0] * dims[1] * dims[2])
+        {
+            ROS_ERROR_STREAM("Texture " << i << " in \"" << textures_path << "\" is not an image!");
+            H5Dclose(dataset);
+            success = false;
+            break;
+        }
+
+        const size_t channels = rank == 3 ? dims[2] : 1;
+        std::string encoding;
+        if (channels == 1) encoding = "mono8";
+        else if (channels == 3) encoding = "rgb8";
+        else if (channels == 4) encoding = "rgba8";
+
+        mesh_msgs::MeshTexture& texture = textures[i];
+        texture.uuid = mesh_uuid;
+        texture.texture_index = i;
+        texture.image.height = dims[0];
+        texture.image.width = dims[1];
+        texture.image.encoding = encoding;
+        texture.image.is_bigendian = 0;
+        texture.image.step = dims[1] * channels;
+        texture.image.data.resize(dims[0] * dims[1] * channels);
+
+        success = !encoding.empty() && texture.image.data.size() == static_cast<size_t>(num_elements)
+            && H5Dread(dataset, H5T_NATIVE_UINT8, H5S_ALL, H5S_ALL, H5P_DEFAULT, texture.image.data.data()) >= 0;
+        H5Dclose(dataset);
+
+        if (!success)
+        {
+            ROS_ERROR_STREAM("Could not read texture " << i << " from \"" << textures_path << "\"!");
+        }
+    }
+    H5Gclose(group);
+    return success;
+}
+
+bool Hdf5MeshReader::attributeInfo(
+    const std::string& name,
+    H5T_class_t& type_class,
+    size_t& type_size,
+    hsize_t& num_elements
+) const
+{
+    if (!isOpen() || H5Aexists_by_name(file, group_path.c_str(), name.c_str(), H5P_DEFAULT) <= 0)
+    {
+        return false;
+    }
+    hid_t attribute = H5Aopen_by_name(file, group_path.c_str(), name.c_str(), H5P_DEFAULT, H5P_DEFAULT);
+    if (attribute < 0)
+    {
+        return false;
+    }
+
+    // Scalar attributes have one element, the dataspace gives the element count of every rank
+    hid_t type = H5Aget_type(attribute);
+    hid_t space = H5Aget_space(attribute);
+    type_class = H5Tget_class(type);
+    type_size = H5Tget_size(type);
+    const hssize_t num_points = H5Sget_simple_extent_npoints(space);
+    H5Sclose(space);
+    H5Tclose(type);
+    H5Aclose(attribute);
+
+    if (num_points < 0)
+    {
+        return false;
+    }
+    num_elements = static_cast<hsize_t>(num_points);
+    return true;
+}
+
+bool Hdf5MeshReader::readAttribute(const std::string& name, std::string& value)
+{
+    H5T_class_t type_class;
+    size_t type_size;
+    hsize_t num_elements;
+    if (!attributeInfo(name, type_class, type_size, num_elements) || type_class != H5T_STRING || num_elements != 1)
+    {
+        return false;
+    }
+
+    std::vector<char> buffer(type_size + 1, '\0');
+    if (H5LTget_attribute_string(file, group_path.c_str(), name.c_str(), buffer.data()) < 0)
+    {
+        return false;
+    }
+    value = buffer.data();
+    return true;
+}
+
+bool Hdf5MeshReader::readAttribute(const std::string& name, std::vector<uint32_t>& values)
+{
+    H5T_class_t type_class;
+    size_t type_size;
+    hsize_t num_elements;
+    if (!attributeInfo(name, type_class, type_size, num_elements) || type_class != H5T_INTEGER)
+    {
+        return false;
+    }
+
+    values.resize(num_elements);
+    return H5LTget_attribute_uint(file, group_path.c_str(), name.c_str(), values.data()) >= 0;
+}
+
+/**********************************************************************************************************************/
+// Writer
+
+/// Color channel of a message in the 8 bit range of the datasets
+static uint8_t colorByte(float value)
+{
+    return static_cast<uint8_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+}
+
+Hdf5MeshWriter::Hdf5MeshWriter(
+    const std::string& filename,
+    const std::string& mesh_name,
+    int compression_level,
+    size_t chunk_rows,
+    std::mutex* library_mutex
+)
+    : file(-1),
+      group(-1),
+      filename(filename),
+      tmp_filename(filename + ".tmp"),
+      compression_level(std::min(std::max(compression_level, 0), 9)),
+      chunk_rows(std::max<size_t>(chunk_rows, 1)),
+      library_mutex(library_mutex),
+      success(false)
+{
+    std::unique_lock<std::mutex> lock = lockLibrary();
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+
+    file = H5Fcreate(tmp_filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (file < 0)
+    {
+        ROS_ERROR_STREAM("Could not create HDF5 file \"" << tmp_filename << "\"!");
+        return;
+    }
+
+    hid_t meshes = H5Gcreate2(file, "/meshes", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    if (meshes >= 0)
+    {
+        group = H5Gcreate2(meshes, mesh_name.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        H5Gclose(meshes);
+    }
+    success = group >= 0;
+}
+
+Hdf5MeshWriter::~Hdf5MeshWriter()
+{
+    if (file >= 0)
+    {
+        // Not closed explicitly, discard the incomplete file
+        success = false;
+        close();
+    }
+}
+
+std::unique_lock<std::mutex> Hdf5MeshWriter::lockLibrary() const
+{
+    return library_mutex ? std::unique_lock<std::mutex>(*library_mutex) : std::unique_lock<std::mutex>();
+}
+
+bool Hdf5MeshWriter::isOpen() const
+{
+    return file >= 0 && group >= 0;
+}
+
+bool Hdf5MeshWriter::writeDataset(
+    hid_t location,
+    const std::string& name,
+    hid_t mem_type,
+    const void* data,
+    const std::vector<hsize_t>& dims
+)
+{
+    if (dims.empty() || dims[0] == 0 || !data)
+    {
+        return true;
+    }
+
+    std::vector<hsize_t> chunk_dims(dims);
+    chunk_dims[0] = std::min<hsize_t>(dims[0], chunk_rows);
+
+    hid_t space, dcpl, dataset;
+    size_t row_size;
+    {
+        std::unique_lock<std::mutex> lock = lockLibrary();
+        space = H5Screate_simple(dims.size(), dims.data(), NULL);
+        dcpl = H5Pcreate(H5P_DATASET_CREATE);
+        H5Pset_chunk(dcpl, chunk_dims.size(), chunk_dims.data());
+        if (compression_level > 0)
+        {
+            H5Pset_shuffle(dcpl);
+            H5Pset_deflate(dcpl, compression_level);
+        }
+        dataset = H5Dcreate2(location, name.c_str(), mem_type, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+        row_size = H5Tget_size(mem_type);
+    }
+    for (size_t d = 1; d < dims.size(); d++)
+    {
+        row_size *= dims[d];
+    }
+
+    // One chunk at a time, so that other threads can use the library between the chunks of a large dataset
+    bool written = dataset >= 0;
+    std::vector<hsize_t> start(dims.size(), 0);
+    std::vector<hsize_t> extent(dims);
+    for (hsize_t first = 0; written && first < dims[0]; first += chunk_dims[0])
+    {
+        start[0] = first;
+        extent[0] = std::min<hsize_t>(chunk_dims[0], dims[0] - first);
+        const char* rows = static_cast<const char*>(data) + first * row_size;
+
+        std::unique_lock<std::mutex> lock = lockLibrary();
+        H5Sselect_hyperslab(space, H5S_SELECT_SET, start.data(), NULL, extent.data(), NULL);
+        hid_t mem_space = H5Screate_simple(extent.size(), extent.data(), NULL);
+        written = H5Dwrite(dataset, mem_type, mem_space, space, H5P_DEFAULT, rows) >= 0;
+        H5Sclose(mem_space);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock = lockLibrary();
+        if (dataset >= 0)
+        {
+            H5Dclose(dataset);
+        }
+        H5Pclose(dcpl);
+        H5Sclose(space);
+    }
+
+    if (!written)
+    {
+        ROS_ERROR_STREAM("Could not write dataset \"" << name << "\" to \"" << tmp_filename << "\"!");
+    }
+    return written;
+}
+
+bool Hdf5MeshWriter::write(const lvr2::MeshBufferPtr& buffer)
+{
+    if (!isOpen() || !buffer)
+    {
+        return false;
+    }
+
+    const hsize_t n_vertices = buffer->numVertices();
+    const hsize_t n_faces = buffer->numFaces();
+
+    success = success
+        && writeDataset(group, "vertices", H5T_NATIVE_FLOAT, buffer->getVertices().get(), {n_vertices, 3})
+        && writeDataset(group, "indices", H5T_NATIVE_UINT32, buffer->getFaceIndices().get(), {n_faces, 3});
+
+    if (success && buffer->hasVertexNormals())
+    {
+        success = writeDataset(
+            group, "vertex_normals", H5T_NATIVE_FLOAT, buffer->getVertexNormals().get(), {n_vertices, 3}
+        );
+    }
+
+    if (success && buffer->hasVertexColors())
+    {
+        size_t color_channels = 3;
+        auto colors = buffer->getVertexColors(color_channels);
+        success = writeDataset(
+            group, "vertex_colors", H5T_NATIVE_UINT8, colors.get(), {n_vertices, color_channels}
+        );
+    }
+
+    size_t n;
+    unsigned w;
+    lvr2::floatArr intensities = buffer->getFloatArray("intensity", n, w);
+    if (success && intensities && n == n_vertices && w == 1)
+    {
+        success = writeDataset(group, "vertex_intensities", H5T_NATIVE_FLOAT, intensities.get(), {n, 1});
+    }
+
+    lvr2::floatArr tex_coords = buffer->getFloatArray("texture_coordinates", n, w);
+    if (success && tex_coords)
+    {
+        success = writeDataset(group, "texture_coordinates", H5T_NATIVE_FLOAT, tex_coords.get(), {n, w});
+    }
+
+    lvr2::indexArray face_materials = buffer->getIndexArray("face_materials", n, w);
+    if (success && face_materials)
+    {
+        success = writeDataset(group, "face_materials", H5T_NATIVE_UINT32, face_materials.get(), {n});
+    }
+
+    const auto& materials = buffer->getMaterials();
+    if (success && !materials.empty())
+    {
+        std::vector<uint8_t> material_colors(materials.size() * 3, 255);
+        std::vector<int32_t> material_textures(materials.size(), -1);
+        for (size_t i = 0; i < materials.size(); i++)
+        {
+            const lvr2::Material& m = materials[i];
+            if (m.m_color)
+            {
+                material_colors[i * 3 + 0] = m.m_color.get()[0];
+                material_colors[i * 3 + 1] = m.m_color.get()[1];
+                material_colors[i * 3 + 2] = m.m_color.get()[2];
+            }
+            if (m.m_texture)
+            {
+                material_textures[i] = static_cast<int32_t>(m.m_texture.get().idx());
+            }
+        }
+        success = writeDataset(
+                group, "material_colors", H5T_NATIVE_UINT8, material_colors.data(), {materials.size(), 3}
+            )
+            && writeDataset(
+                group, "material_textures", H5T_NATIVE_INT32, material_textures.data(), {materials.size()}
+            );
+    }
+
+    const auto& textures = buffer->getTextures();
+    if (success && !textures.empty())
+    {
+        hid_t textures_group = createGroup("textures");
+        success = textures_group >= 0;
+        for (size_t i = 0; success && i < textures.size(); i++)
+        {
+            const lvr2::Texture& texture = textures[i];
+            // The reader and the texture messages only know 8 bit images
+            if (texture.m_numBytesPerChan != 1)
+            {
+                ROS_ERROR_STREAM("Texture " << i << " has " << static_cast<int>(texture.m_numBytesPerChan)
+                    << " bytes per channel, only 8 bit textures can be stored!");
+                success = false;
+                break;
+            }
+            success = writeDataset(
+                textures_group,
+                std::to_string(i),
+                H5T_NATIVE_UINT8,
+                texture.m_data,
+                {texture.m_height, texture.m_width, texture.m_numChannels}
+            );
+        }
+        if (textures_group >= 0)
+        {
+            std::unique_lock<std::mutex> lock = lockLibrary();
+            H5Gclose(textures_group);
+        }
+    }
+
+    return success;
+}
+
+bool Hdf5MeshWriter::write(
+    const mesh_msgs::MeshGeometry& mesh_geometry,
+    const mesh_msgs::MeshMaterials& mesh_materials,
+    const mesh_msgs::MeshVertexColors& mesh_vertex_colors,
+    const std::vector<float>& vertex_intensities,
+    const std::vector<mesh_msgs::MeshTexture>& textures
+)
+{
+    if (!isOpen())
+    {
+        return false;
+    }
+
+    const hsize_t n_vertices = mesh_geometry.vertices.size();
+    const hsize_t n_faces = mesh_geometry.faces.size();
+
+    std::vector<float> vertices(n_vertices * 3);
+    #pragma omp parallel for
+    for (size_t i = 0; i < n_vertices; i++)
+    {
+        vertices[i * 3 + 0] = mesh_geometry.vertices[i].x;
+        vertices[i * 3 + 1] = mesh_geometry.vertices[i].y;
+        vertices[i * 3 + 2] = mesh_geometry.vertices[i].z;
+    }
+    std::vector<uint32_t> indices(n_faces * 3);
+    #pragma omp parallel for
+    for (size_t i = 0; i < n_faces; i++)
+    {
+        std::copy_n(mesh_geometry.faces[i].vertex_indices.begin(), 3, indices.begin() + i * 3);
+    }
+    success = success
+        && writeDataset(group, "vertices", H5T_NATIVE_FLOAT, vertices.data(), {n_vertices, 3})
+        && writeDataset(group, "indices", H5T_NATIVE_UINT32, indices.data(), {n_faces, 3});
+
+    if (success && mesh_geometry.vertex_normals.size() == n_vertices)
+    {
+        #pragma omp parallel for
+        for (size_t i = 0; i < n_vertices; i++)
+        {
+            vertices[i * 3 + 0] = mesh_geometry.vertex_normals[i].x;
+            vertices[i * 3 + 1] = mesh_geometry.vertex_normals[i].y;
+            vertices[i * 3 + 2] = mesh_geometry.vertex_normals[i].z;
+        }
+        success = writeDataset(group, "vertex_normals", H5T_NATIVE_FLOAT, vertices.data(), {n_vertices, 3});
+    }
+
+    const std::vector<std_msgs::ColorRGBA>& vertex_colors = mesh_vertex_colors.vertex_colors;
+    if (success && vertex_colors.size() == n_vertices)
+    {
+        std::vector<float> colors(n_vertices * 4);
+        #pragma omp parallel for
+        for (size_t i = 0; i < n_vertices; i++)
+        {
+            colors[i * 4 + 0] = vertex_colors[i].r;
+            colors[i * 4 + 1] = vertex_colors[i].g;
+            colors[i * 4 + 2] = vertex_colors[i].b;
+            colors[i * 4 + 3] = vertex_colors[i].a;
+        }
+        success = writeDataset(group, "vertex_colors", H5T_NATIVE_FLOAT, colors.data(), {n_vertices, 4});
+    }
+
+    if (success && vertex_intensities.size() == n_vertices)
+    {
+        success = writeDataset(
+            group, "vertex_intensities", H5T_NATIVE_FLOAT, vertex_intensities.data(), {n_vertices, 1}
+        );
+    }
+
+    const std::vector<mesh_msgs::MeshVertexTexCoords>& vertex_tex_coords = mesh_materials.vertex_tex_coords;
+    if (success && !vertex_tex_coords.empty())
+    {
+        std::vector<float> tex_coords(vertex_tex_coords.size() * 2);
+        for (size_t i = 0; i < vertex_tex_coords.size(); i++)
+        {
+            tex_coords[i * 2 + 0] = vertex_tex_coords[i].u;
+            tex_coords[i * 2 + 1] = vertex_tex_coords[i].v;
+        }
+        success = writeDataset(
+            group, "texture_coordinates", H5T_NATIVE_FLOAT, tex_coords.data(), {vertex_tex_coords.size(), 2}
+        );
+    }
+
+    // The reader groups the faces by their material, clusters are stored as the material of every face
+    const size_t n_clusters = mesh_materials.clusters.size();
+    if (success && n_clusters > 0)
+    {
+        const uint32_t no_material = std::numeric_limits<uint32_t>::max();
+        std::vector<uint32_t> face_materials(n_faces, no_material);
+        std::set<uint32_t> cluster_materials;
+        size_t n_clustered = 0;
+        bool valid = mesh_materials.cluster_materials.size() == n_clusters;
+        for (size_t c = 0; valid && c < n_clusters; c++)
+        {
+            const uint32_t material = mesh_materials.cluster_materials[c];
+            valid = material != no_material && cluster_materials.insert(material).second;
+            for (uint32_t face_index : mesh_materials.clusters[c].face_indices)
+            {
+                if (!valid || face_index >= n_faces || face_materials[face_index] != no_material)
+                {
+                    valid = false;
+                    break;
+                }
+                face_materials[face_index] = material;
+                n_clustered++;
+            }
+        }
+        if (!valid || n_clustered != n_faces)
+        {
+            ROS_ERROR_STREAM("The face clusters of the mesh can not be written to \"" << tmp_filename << "\"!");
+            success = false;
+        }
+        else
+        {
+            success = writeDataset(group, "face_materials", H5T_NATIVE_UINT32, face_materials.data(), {n_faces});
+        }
+    }
+
+    const std::vector<mesh_msgs::MeshMaterial>& materials = mesh_materials.materials;
+    if (success && !materials.empty())
+    {
+        std::vector<uint8_t> material_colors(materials.size() * 3);
+        std::vector<int32_t> material_textures(materials.size(), -1);
+        for (size_t i = 0; i < materials.size(); i++)
+        {
+            const mesh_msgs::MeshMaterial& m = materials[i];
+            material_colors[i * 3 + 0] = colorByte(m.color.r);
+            material_colors[i * 3 + 1] = colorByte(m.color.g);
+            material_colors[i * 3 + 2] = colorByte(m.color.b);
+            if (m.has_texture)
+            {
+                material_textures[i] = static_cast<int32_t>(m.texture_index);
+            }
+        }
+        success = writeDataset(
+                group, "material_colors", H5T_NATIVE_UINT8, material_colors.data(), {materials.size(), 3}
+            )
+            && writeDataset(
+                group, "material_textures", H5T_NATIVE_INT32, material_textures.data(), {materials.size()}
+            );
+    }
+
+    if (success && !textures.empty())
+    {
+        hid_t textures_group = createGroup("textures");
+        success = textures_group >= 0;
+        for (size_t i = 0; success && i < textures.size(); i++)
+        {
+            // The reader derives the encoding from the number of channels
+            const sensor_msgs::Image& image = textures[i].image;
+            size_t channels = 0;
+            if (image.encoding == "mono8") channels = 1;
+            else if (image.encoding == "rgb8") channels = 3;
+            else if (image.encoding == "rgba8") channels = 4;
+
+            const size_t row_size = image.width * channels;
+            if (channels == 0 || image.step < row_size || image.data.size() < image.height * image.step)
+            {
+                ROS_ERROR_STREAM("Texture " << i << " of encoding \"" << image.encoding << "\" can not be stored!");
+                success = false;
+                break;
+            }
+
+            // Rows may be padded in the message, not in the dataset
+            std::vector<uint8_t> data(image.height * row_size);
+            for (size_t row = 0; row < image.height; row++)
+            {
+                std::copy_n(image.data.begin() + row * image.step, row_size, data.begin() + row * row_size);
+            }
+            success = writeDataset(
+                textures_group,
+                std::to_string(i),
+                H5T_NATIVE_UINT8,
+                data.data(),
+                {image.height, image.width, channels}
+            );
+        }
+        if (textures_group >= 0)
+        {
+            std::unique_lock<std::mutex> lock = lockLibrary();
+            H5Gclose(textures_group);
+        }
+    }
+
+    return success;
+}
+
+hid_t Hdf5MeshWriter::createGroup(const std::string& name)
+{
+    std::unique_lock<std::mutex> lock = lockLibrary();
+    return H5Gcreate2(group, name.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+}
+
+bool Hdf5MeshWriter::writeAttribute(const std::string& name, const std::string& value)
+{
+    std::unique_lock<std::mutex> lock = lockLibrary();
+    success = success && isOpen() && H5LTset_attribute_string(group, ".", name.c_str(), value.c_str()) >= 0;
+    return success;
+}
+
+bool Hdf5MeshWriter::writeAttribute(const std::string& name, const std::vector<uint32_t>& values)
+{
+    std::unique_lock<std::mutex> lock = lockLibrary();
+    success = success && isOpen()
+        && H5LTset_attribute_uint(group, ".", name.c_str(), values.data(), values.size()) >= 0;
+    return success;
+}
+
+bool Hdf5MeshWriter::close()
+{
+    {
+        std::unique_lock<std::mutex> lock = lockLibrary();
+        if (group >= 0)
+        {
+            H5Gclose(group);
+            group = -1;
+        }
+        if (file >= 0)
+        {
+            success = H5Fclose(file) >= 0 && success;
+            file = -1;
+        }
+    }
+
+    if (success && std::rename(tmp_filename.c_str(), filename.c_str()) == 0)
+    {
+        return true;
+    }
+    std::remove(tmp_filename.c_str());
+    return false;
+}
+
+} // namespace lvr_ros
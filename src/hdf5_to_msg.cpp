@@ -0,0 +1,227 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * hdf5_to_msg.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "lvr_ros/hdf5_to_msg.h"
+
+namespace lvr_ros
+{
+
+/**********************************************************************************************************************/
+// Constructor
+
+Hdf5ToMsg::Hdf5ToMsg()
+{
+    ros::NodeHandle nh("~");
+    nh.param<std::string>("inputFile", input_file, "");
+    nh.param<std::string>("meshName", mesh_name, "triangle_mesh");
+    nh.param<std::string>("frameId", frame_id, "map");
+    nh.param<int>("blockSize", block_size, 1 << 20);
+    nh.param<bool>("useMmap", use_mmap, true);
+
+    mesh_geometry_publisher = node_handle.advertise<mesh_msgs::MeshGeometryStamped>("/mesh_geometry", 1, true);
+
+    // Start services
+    srv_get_geometry_ = node_handle.advertiseService("get_geometry", &Hdf5ToMsg::service_getGeometry, this);
+    srv_get_materials_ = node_handle.advertiseService("get_materials", &Hdf5ToMsg::service_getMaterials, this);
+    srv_get_texture_ = node_handle.advertiseService("get_texture", &Hdf5ToMsg::service_getTexture, this);
+    srv_get_uuid_ = node_handle.advertiseService("get_uuid", &Hdf5ToMsg::service_getUUID, this);
+    srv_get_vertex_colors_ = node_handle.advertiseService(
+        "get_vertex_colors",
+        &Hdf5ToMsg::service_getVertexColors,
+        this
+    );
+}
+
+/**********************************************************************************************************************/
+// Loading
+
+bool Hdf5ToMsg::load()
+{
+    ROS_INFO_STREAM("Load mesh \"" << mesh_name << "\" from \"" << input_file << "\".");
+    ros::WallTime start = ros::WallTime::now();
+
+    reader.reset(new Hdf5MeshReader(input_file, mesh_name, static_cast<size_t>(block_size), use_mmap));
+    if (!reader->isOpen())
+    {
+        return false;
+    }
+
+    // Use a stored uuid if available, so that clients can keep their references across restarts
+    if (!reader->readAttribute("uuid", uuid))
+    {
+        boost::uuids::uuid boost_uuid = boost::uuids::random_generator()();
+        uuid = boost::lexical_cast<std::string>(boost_uuid);
+    }
+
+    if (!reader->readGeometry(mesh_geometry_stamped.mesh_geometry))
+    {
+        ROS_ERROR_STREAM("Could not read the mesh geometry from \"" << input_file << "\"!");
+        return false;
+    }
+
+    ros::Time stamp = ros::Time::now();
+    mesh_geometry_stamped.header.frame_id = frame_id;
+    mesh_geometry_stamped.header.stamp = stamp;
+    mesh_geometry_stamped.uuid = uuid;
+    mesh_materials_stamped.header = mesh_geometry_stamped.header;
+    mesh_materials_stamped.uuid = uuid;
+    mesh_vertex_colors_stamped.header = mesh_geometry_stamped.header;
+    mesh_vertex_colors_stamped.uuid = uuid;
+
+    ROS_INFO_STREAM("Loaded " << mesh_geometry_stamped.mesh_geometry.vertices.size() << " vertices and "
+        << mesh_geometry_stamped.mesh_geometry.faces.size() << " faces in "
+        << (ros::WallTime::now() - start).toSec() << "s, publish mesh geometry.");
+    mesh_geometry_publisher.publish(mesh_geometry_stamped);
+
+    // The geometry is out, the attributes may take their time
+    attributes_future = std::async(std::launch::async, &Hdf5ToMsg::loadAttributes, this).share();
+    geometry_loaded = true;
+    return true;
+}
+
+bool Hdf5ToMsg::loadAttributes()
+{
+    ros::WallTime start = ros::WallTime::now();
+    bool success = reader->readMaterials(mesh_materials_stamped.mesh_materials)
+        && reader->readTextures(textures, uuid);
+    has_vertex_colors = reader->readVertexColors(mesh_vertex_colors_stamped.mesh_vertex_colors);
+
+    // Nothing left to read, release the file
+    reader.reset();
+
+    if (!success)
+    {
+        ROS_ERROR_STREAM("Could not read the mesh attributes from \"" << input_file << "\"!");
+        return false;
+    }
+    ROS_INFO_STREAM("Loaded " << mesh_materials_stamped.mesh_materials.materials.size() << " materials and "
+        << textures.size() << " textures in " << (ros::WallTime::now() - start).toSec() << "s.");
+    return true;
+}
+
+bool Hdf5ToMsg::attributesLoaded()
+{
+    return attributes_future.valid() && attributes_future.get();
+}
+
+/**********************************************************************************************************************/
+// Services
+
+bool Hdf5ToMsg::service_getGeometry(
+    mesh_msgs::GetGeometry::Request& req,
+    mesh_msgs::GetGeometry::Response& res
+)
+{
+    ROS_INFO("Service: Get Geometry");
+    if (!geometry_loaded || req.uuid != uuid)
+    {
+        return false;
+    }
+    res.mesh_geometry_stamped = mesh_geometry_stamped;
+    return true;
+}
+
+bool Hdf5ToMsg::service_getMaterials(
+    mesh_msgs::GetMaterials::Request& req,
+    mesh_msgs::GetMaterials::Response& res
+)
+{
+    ROS_INFO("Service: Get Materials");
+    if (!geometry_loaded || req.uuid != uuid || !attributesLoaded())
+    {
+        return false;
+    }
+    res.mesh_materials_stamped = mesh_materials_stamped;
+    return true;
+}
+
+bool Hdf5ToMsg::service_getTexture(
+    mesh_msgs::GetTexture::Request& req,
+    mesh_msgs::GetTexture::Response& res
+)
+{
+    ROS_INFO("Service: Get Texture");
+    if (!geometry_loaded || req.uuid != uuid || !attributesLoaded() || req.texture_index >= textures.size())
+    {
+        return false;
+    }
+    res.texture = textures.at(req.texture_index);
+    return true;
+}
+
+bool Hdf5ToMsg::service_getVertexColors(
+    mesh_msgs::GetVertexColors::Request& req,
+    mesh_msgs::GetVertexColors::Response& res
+)
+{
+    ROS_INFO("Service: Get Vertex Colors");
+    if (!geometry_loaded || req.uuid != uuid || !attributesLoaded() || !has_vertex_colors)
+    {
+        return false;
+    }
+    res.mesh_vertex_colors_stamped = mesh_vertex_colors_stamped;
+    return true;
+}
+
+bool Hdf5ToMsg::service_getUUID(
+    mesh_msgs::GetUUID::Request& req,
+    mesh_msgs::GetUUID::Response& res
+)
+{
+    ROS_INFO("Service: Get UUID");
+    if (!geometry_loaded)
+    {
+        return false;
+    }
+    res.uuid = uuid;
+    return true;
+}
+
+} // namespace lvr_ros
+
+
+int main(int argc, char **args)
+{
+    ros::init(argc, args, "hdf5_to_msg");
+    lvr_ros::Hdf5ToMsg hdf5_to_msg;
+
+    // Services are already advertised, they answer as soon as their data is available
+    ros::AsyncSpinner spinner(4);
+    spinner.start();
+
+    if (!hdf5_to_msg.load())
+    {
+        ROS_FATAL_STREAM("Could not load the mesh, shutting down.");
+        ros::shutdown();
+        return 1;
+    }
+
+    ros::waitForShutdown();
+    return 0;
+}
@@ -0,0 +1,693 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mesh_bvh.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#include "lvr_ros/mesh_bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace lvr_ros
+{
+
+using Vec3 = MeshBvh::Vec3;
+using Triangle = MeshBvh::Triangle;
+
+// Number of centroid bins evaluated per split
+static const int SAH_BINS = 16;
+// Cost of traversing a node relative to intersecting a triangle
+static const float SAH_TRAVERSAL_COST = 1.0f;
+
+static const float INF = std::numeric_limits<float>::infinity();
+
+static inline Vec3 operator+(const Vec3& a, const Vec3& b)
+{
+    return Vec3{a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+static inline Vec3 operator-(const Vec3& a, const Vec3& b)
+{
+    return Vec3{a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+static inline Vec3 operator*(const Vec3& a, float s)
+{
+    return Vec3{a.x * s, a.y * s, a.z * s};
+}
+
+static inline float dot(const Vec3& a, const Vec3& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static inline Vec3 cross(const Vec3& a, const Vec3& b)
+{
+    return Vec3{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+static inline Vec3 minimum(const Vec3& a, const Vec3& b)
+{
+    return Vec3{std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)};
+}
+
+static inline Vec3 maximum(const Vec3& a, const Vec3& b)
+{
+    return Vec3{std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)};
+}
+
+static inline float component(const Vec3& v, int axis)
+{
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+static inline Vec3 toVec3(const geometry_msgs::Point& p)
+{
+    return Vec3{static_cast<float>(p.x), static_cast<float>(p.y), static_cast<float>(p.z)};
+}
+
+static inline geometry_msgs::Point toPoint(const Vec3& v)
+{
+    geometry_msgs::Point p;
+    p.x = v.x;
+    p.y = v.y;
+    p.z = v.z;
+    return p;
+}
+
+static inline float surfaceArea(const Vec3& min, const Vec3& max)
+{
+    const Vec3 d = max - min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+/// Squared distance from a point to a box, 0 if the point is inside
+static inline float boxDistance2(const float* min, const float* max, const Vec3& p)
+{
+    const float dx = std::max(std::max(min[0] - p.x, p.x - max[0]), 0.0f);
+    const float dy = std::max(std::max(min[1] - p.y, p.y - max[1]), 0.0f);
+    const float dz = std::max(std::max(min[2] - p.z, p.z - max[2]), 0.0f);
+    return dx * dx + dy * dy + dz * dz;
+}
+
+/// Distance along the ray at which it enters the box, infinity if it misses the box within max_t
+static inline float rayBoxEntry(const float* min, const float* max, const Vec3& origin, const Vec3& inv_dir, float max_t)
+{
+    float t0 = (min[0] - origin.x) * inv_dir.x;
+    float t1 = (max[0] - origin.x) * inv_dir.x;
+    float t_near = std::min(t0, t1);
+    float t_far = std::max(t0, t1);
+
+    t0 = (min[1] - origin.y) * inv_dir.y;
+    t1 = (max[1] - origin.y) * inv_dir.y;
+    t_near = std::max(t_near, std::min(t0, t1));
+    t_far = std::min(t_far, std::max(t0, t1));
+
+    t0 = (min[2] - origin.z) * inv_dir.z;
+    t1 = (max[2] - origin.z) * inv_dir.z;
+    t_near = std::max(t_near, std::min(t0, t1));
+    t_far = std::min(t_far, std::max(t0, t1));
+
+    return (t_near <= t_far && t_far >= 0 && t_near <= max_t) ? std::max(t_near, 0.0f) : INF;
+}
+
+/// Möller-Trumbore ray triangle intersection, returns the distance along the ray or infinity
+static inline float rayTriangle(const Triangle& tri, const Vec3& origin, const Vec3& dir)
+{
+    const Vec3 e1 = tri.b - tri.a;
+    const Vec3 e2 = tri.c - tri.a;
+    const Vec3 p = cross(dir, e2);
+    const float det = dot(e1, p);
+    if (std::abs(det) < 1e-12f)
+    {
+        return INF;
+    }
+    const float inv_det = 1.0f / det;
+    const Vec3 s = origin - tri.a;
+    const float u = dot(s, p) * inv_det;
+    if (u < 0 || u > 1)
+    {
+        return INF;
+    }
+    const Vec3 q = cross(s, e1);
+    const float v = dot(dir, q) * inv_det;
+    if (v < 0 || u + v > 1)
+    {
+        return INF;
+    }
+    const float t = dot(e2, q) * inv_det;
+    return t >= 0 ? t : INF;
+}
+
+/// Closest point on a triangle, see Ericson, Real-Time Collision Detection, 5.1.5
+static inline Vec3 closestPointOnTriangle(const Triangle& tri, const Vec3& p)
+{
+    const Vec3 ab = tri.b - tri.a;
+    const Vec3 ac = tri.c - tri.a;
+    const Vec3 ap = p - tri.a;
+    const float d1 = dot(ab, ap);
+    const float d2 = dot(ac, ap);
+    if (d1 <= 0 && d2 <= 0)
+    {
+        return tri.a;
+    }
+
+    const Vec3 bp = p - tri.b;
+    const float d3 = dot(ab, bp);
+    const float d4 = dot(ac, bp);
+    if (d3 >= 0 && d4 <= d3)
+    {
+        return tri.b;
+    }
+
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0)
+    {
+        return tri.a + ab * (d1 / (d1 - d3));
+    }
+
+    const Vec3 cp = p - tri.c;
+    const float d5 = dot(ab, cp);
+    const float d6 = dot(ac, cp);
+    if (d6 >= 0 && d5 <= d6)
+    {
+        return tri.c;
+    }
+
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0)
+    {
+        return tri.a + ac * (d2 / (d2 - d6));
+    }
+
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+    {
+        return tri.b + (tri.c - tri.b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    const float denom = 1.0f / (va + vb + vc);
+    return tri.a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+/// Separating axis test of a triangle, given relative to the box center, against a box with the half extents h
+static inline bool separated(const Vec3& axis, const Vec3& v0, const Vec3& v1, const Vec3& v2, const Vec3& h)
+{
+    const float p0 = dot(v0, axis);
+    const float p1 = dot(v1, axis);
+    const float p2 = dot(v2, axis);
+    const float r = h.x * std::abs(axis.x) + h.y * std::abs(axis.y) + h.z * std::abs(axis.z);
+    return std::min(std::min(p0, p1), p2) > r || std::max(std::max(p0, p1), p2) < -r;
+}
+
+/// Triangle box overlap, see Akenine-Möller, Fast 3D Triangle-Box Overlap Testing
+static inline bool triangleBoxOverlap(const Triangle& tri, const Vec3& center, const Vec3& half)
+{
+    const Vec3 v0 = tri.a - center;
+    const Vec3 v1 = tri.b - center;
+    const Vec3 v2 = tri.c - center;
+    const Vec3 edges[3] = {v1 - v0, v2 - v1, v0 - v2};
+    const Vec3 axes[3] = {Vec3{1, 0, 0}, Vec3{0, 1, 0}, Vec3{0, 0, 1}};
+
+    for (const Vec3& axis : axes)
+    {
+        if (separated(axis, v0, v1, v2, half))
+        {
+            return false;
+        }
+    }
+    if (separated(cross(edges[0], edges[1]), v0, v1, v2, half))
+    {
+        return false;
+    }
+    for (const Vec3& axis : axes)
+    {
+        for (const Vec3& edge : edges)
+        {
+            if (separated(cross(axis, edge), v0, v1, v2, half))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+MeshBvh::MeshBvh()
+{
+}
+
+MeshBvh::MeshBvh(const mesh_msgs::MeshGeometry& mesh_geometry, size_t max_leaf_size)
+{
+    const auto& vertices = mesh_geometry.vertices;
+    const auto& faces = mesh_geometry.faces;
+
+    std::vector<BuildFace> build_faces;
+    build_faces.reserve(faces.size());
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        const auto& indices = faces[i].vertex_indices;
+        if (indices[0] >= vertices.size() || indices[1] >= vertices.size() || indices[2] >= vertices.size())
+        {
+            continue;
+        }
+        const Vec3 a = toVec3(vertices[indices[0]]);
+        const Vec3 b = toVec3(vertices[indices[1]]);
+        const Vec3 c = toVec3(vertices[indices[2]]);
+        BuildFace face;
+        face.min = minimum(minimum(a, b), c);
+        face.max = maximum(maximum(a, b), c);
+        face.centroid = (a + b + c) * (1.0f / 3.0f);
+        face.index = static_cast<uint32_t>(i);
+        build_faces.push_back(face);
+    }
+    if (build_faces.empty())
+    {
+        return;
+    }
+
+    max_leaf_size = std::max<size_t>(max_leaf_size, 1);
+    nodes.reserve(4 * build_faces.size() / max_leaf_size + 1);
+    triangles.reserve(build_faces.size());
+    face_indices.reserve(build_faces.size());
+    build(build_faces, 0, build_faces.size(), max_leaf_size);
+
+    // Copy the triangles in leaf order
+    for (uint32_t index : face_indices)
+    {
+        const auto& indices = faces[index].vertex_indices;
+        triangles.push_back(Triangle{
+            toVec3(vertices[indices[0]]),
+            toVec3(vertices[indices[1]]),
+            toVec3(vertices[indices[2]])
+        });
+    }
+}
+
+uint32_t MeshBvh::build(std::vector<BuildFace>& faces, size_t begin, size_t end, size_t max_leaf_size)
+{
+    const uint32_t node_index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    Vec3 min{INF, INF, INF}, max{-INF, -INF, -INF};
+    Vec3 centroid_min{INF, INF, INF}, centroid_max{-INF, -INF, -INF};
+    for (size_t i = begin; i < end; i++)
+    {
+        min = minimum(min, faces[i].min);
+        max = maximum(max, faces[i].max);
+        centroid_min = minimum(centroid_min, faces[i].centroid);
+        centroid_max = maximum(centroid_max, faces[i].centroid);
+    }
+    {
+        Node& node = nodes[node_index];
+        node.min[0] = min.x;
+        node.min[1] = min.y;
+        node.min[2] = min.z;
+        node.max[0] = max.x;
+        node.max[1] = max.y;
+        node.max[2] = max.z;
+    }
+
+    const size_t count = end - begin;
+    auto makeLeaf = [&]()
+    {
+        Node& node = nodes[node_index];
+        node.offset = static_cast<uint32_t>(face_indices.size());
+        node.count = static_cast<uint32_t>(count);
+        for (size_t i = begin; i < end; i++)
+        {
+            face_indices.push_back(faces[i].index);
+        }
+        return node_index;
+    };
+
+    if (count <= max_leaf_size)
+    {
+        return makeLeaf();
+    }
+
+    // Split along the axis with the largest centroid extent
+    const Vec3 extent = centroid_max - centroid_min;
+    int axis = 0;
+    if (extent.y > component(extent, axis))
+    {
+        axis = 1;
+    }
+    if (extent.z > component(extent, axis))
+    {
+        axis = 2;
+    }
+    const float axis_min = component(centroid_min, axis);
+    const float axis_extent = component(extent, axis);
+
+    size_t mid = begin;
+    if (axis_extent > 0)
+    {
+        struct Bin
+        {
+            Vec3 min{INF, INF, INF}, max{-INF, -INF, -INF};
+            size_t count = 0;
+        };
+        Bin bins[SAH_BINS];
+        const float bin_scale = SAH_BINS / axis_extent;
+        auto binOf = [&](const BuildFace& face)
+        {
+            return std::min(SAH_BINS - 1, static_cast<int>((component(face.centroid, axis) - axis_min) * bin_scale));
+        };
+        for (size_t i = begin; i < end; i++)
+        {
+            Bin& bin = bins[binOf(faces[i])];
+            bin.min = minimum(bin.min, faces[i].min);
+            bin.max = maximum(bin.max, faces[i].max);
+            bin.count++;
+        }
+
+        // Cost of splitting after every bin, swept from the right
+        float right_area[SAH_BINS];
+        size_t right_count[SAH_BINS];
+        Vec3 right_min{INF, INF, INF}, right_max{-INF, -INF, -INF};
+        size_t num_right = 0;
+        for (int b = SAH_BINS - 1; b > 0; b--)
+        {
+            right_min = minimum(right_min, bins[b].min);
+            right_max = maximum(right_max, bins[b].max);
+            num_right += bins[b].count;
+            right_area[b] = num_right > 0 ? surfaceArea(right_min, right_max) : 0;
+            right_count[b] = num_right;
+        }
+
+        float best_cost = INF;
+        int best_split = -1;
+        Vec3 left_min{INF, INF, INF}, left_max{-INF, -INF, -INF};
+        size_t num_left = 0;
+        for (int b = 0; b < SAH_BINS - 1; b++)
+        {
+            left_min = minimum(left_min, bins[b].min);
+            left_max = maximum(left_max, bins[b].max);
+            num_left += bins[b].count;
+            if (num_left == 0 || right_count[b + 1] == 0)
+            {
+                continue;
+            }
+            const float cost = surfaceArea(left_min, left_max) * num_left + right_area[b + 1] * right_count[b + 1];
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_split = b;
+            }
+        }
+
+        const float node_area = surfaceArea(min, max);
+        const float split_cost = SAH_TRAVERSAL_COST + (node_area > 0 ? best_cost / node_area : 0);
+        if (best_split >= 0 && split_cost >= count && count <= 4 * max_leaf_size)
+        {
+            return makeLeaf();
+        }
+        if (best_split >= 0)
+        {
+            mid = std::partition(
+                faces.begin() + begin,
+                faces.begin() + end,
+                [&](const BuildFace& face) { return binOf(face) <= best_split; }
+            ) - faces.begin();
+        }
+    }
+
+    // Fall back to a median split if the centroids could not be separated
+    if (mid == begin || mid == end)
+    {
+        mid = begin + count / 2;
+        std::nth_element(
+            faces.begin() + begin,
+            faces.begin() + mid,
+            faces.begin() + end,
+            [axis](const BuildFace& a, const BuildFace& b)
+            {
+                return component(a.centroid, axis) < component(b.centroid, axis);
+            }
+        );
+    }
+
+    build(faces, begin, mid, max_leaf_size);
+    const uint32_t right = build(faces, mid, end, max_leaf_size);
+    nodes[node_index].offset = right;
+    nodes[node_index].count = 0;
+    return node_index;
+}
+
+size_t MeshBvh::numFaces() const
+{
+    return triangles.size();
+}
+
+bool MeshBvh::closestPoint(
+    const geometry_msgs::Point& query,
+    double max_distance,
+    uint32_t& face,
+    geometry_msgs::Point& closest,
+    double& distance
+) const
+{
+    if (nodes.empty())
+    {
+        return false;
+    }
+
+    const Vec3 p = toVec3(query);
+    float best = max_distance > 0 ? static_cast<float>(max_distance * max_distance) : INF;
+    size_t best_triangle = triangles.size();
+    Vec3 best_point{0, 0, 0};
+
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty())
+    {
+        const Node& node = nodes[stack.back()];
+        const uint32_t node_index = stack.back();
+        stack.pop_back();
+        if (boxDistance2(node.min, node.max, p) > best)
+        {
+            continue;
+        }
+
+        if (node.count > 0)
+        {
+            for (size_t i = node.offset; i < node.offset + node.count; i++)
+            {
+                const Vec3 c = closestPointOnTriangle(triangles[i], p);
+                const Vec3 d = c - p;
+                const float d2 = dot(d, d);
+                if (d2 <= best)
+                {
+                    best = d2;
+                    best_triangle = i;
+                    best_point = c;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first
+        const uint32_t left = node_index + 1;
+        const uint32_t right = node.offset;
+        const float left_d2 = boxDistance2(nodes[left].min, nodes[left].max, p);
+        const float right_d2 = boxDistance2(nodes[right].min, nodes[right].max, p);
+        if (left_d2 < right_d2)
+        {
+            if (right_d2 <= best)
+            {
+                stack.push_back(right);
+            }
+            if (left_d2 <= best)
+            {
+                stack.push_back(left);
+            }
+        }
+        else
+        {
+            if (left_d2 <= best)
+            {
+                stack.push_back(left);
+            }
+            if (right_d2 <= best)
+            {
+                stack.push_back(right);
+            }
+        }
+    }
+
+    if (best_triangle == triangles.size())
+    {
+        return false;
+    }
+    face = face_indices[best_triangle];
+    closest = toPoint(best_point);
+    distance = std::sqrt(best);
+    return true;
+}
+
+bool MeshBvh::raycast(
+    const geometry_msgs::Point& origin,
+    const geometry_msgs::Vector3& direction,
+    double max_distance,
+    uint32_t& face,
+    geometry_msgs::Point& hit,
+    double& distance
+) const
+{
+    const double length = std::sqrt(
+        direction.x * direction.x + direction.y * direction.y + direction.z * direction.z
+    );
+    if (nodes.empty() || length == 0)
+    {
+        return false;
+    }
+
+    const Vec3 o = toVec3(origin);
+    const Vec3 dir{
+        static_cast<float>(direction.x / length),
+        static_cast<float>(direction.y / length),
+        static_cast<float>(direction.z / length)
+    };
+    const Vec3 inv_dir{1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z};
+    float best = max_distance > 0 ? static_cast<float>(max_distance) : INF;
+    size_t best_triangle = triangles.size();
+
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    if (rayBoxEntry(nodes[0].min, nodes[0].max, o, inv_dir, best) < INF)
+    {
+        stack.push_back(0);
+    }
+    while (!stack.empty())
+    {
+        const uint32_t node_index = stack.back();
+        const Node& node = nodes[node_index];
+        stack.pop_back();
+
+        if (node.count > 0)
+        {
+            for (size_t i = node.offset; i < node.offset + node.count; i++)
+            {
+                const float t = rayTriangle(triangles[i], o, dir);
+                if (t < best)
+                {
+                    best = t;
+                    best_triangle = i;
+                }
+            }
+            continue;
+        }
+
+        // Visit the child which the ray enters first
+        const uint32_t left = node_index + 1;
+        const uint32_t right = node.offset;
+        const float left_t = rayBoxEntry(nodes[left].min, nodes[left].max, o, inv_dir, best);
+        const float right_t = rayBoxEntry(nodes[right].min, nodes[right].max, o, inv_dir, best);
+        if (left_t < right_t)
+        {
+            if (right_t < INF)
+            {
+                stack.push_back(right);
+            }
+            stack.push_back(left);
+        }
+        else
+        {
+            if (left_t < INF)
+            {
+                stack.push_back(left);
+            }
+            if (right_t < INF)
+            {
+                stack.push_back(right);
+            }
+        }
+    }
+
+    if (best_triangle == triangles.size())
+    {
+        return false;
+    }
+    face = face_indices[best_triangle];
+    hit = toPoint(o + dir * best);
+    distance = best;
+    return true;
+}
+
+void MeshBvh::facesInBox(
+    const geometry_msgs::Point& min,
+    const geometry_msgs::Point& max,
+    std::vector<uint32_t>& faces
+) const
+{
+    if (nodes.empty() || min.x > max.x || min.y > max.y || min.z > max.z)
+    {
+        return;
+    }
+
+    const Vec3 box_min = toVec3(min);
+    const Vec3 box_max = toVec3(max);
+    const Vec3 center = (box_min + box_max) * 0.5f;
+    const Vec3 half = (box_max - box_min) * 0.5f;
+
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty())
+    {
+        const uint32_t node_index = stack.back();
+        const Node& node = nodes[node_index];
+        stack.pop_back();
+
+        if (node.min[0] > box_max.x || node.max[0] < box_min.x
+            || node.min[1] > box_max.y || node.max[1] < box_min.y
+            || node.min[2] > box_max.z || node.max[2] < box_min.z)
+        {
+            continue;
+        }
+
+        if (node.count > 0)
+        {
+            // Leaves which are completely inside the box need no triangle tests
+            const bool contained = node.min[0] >= box_min.x && node.max[0] <= box_max.x
+                && node.min[1] >= box_min.y && node.max[1] <= box_max.y
+                && node.min[2] >= box_min.z && node.max[2] <= box_max.z;
+            for (size_t i = node.offset; i < node.offset + node.count; i++)
+            {
+                if (contained || triangleBoxOverlap(triangles[i], center, half))
+                {
+                    faces.push_back(face_indices[i]);
+                }
+            }
+            continue;
+        }
+
+        stack.push_back(node.offset);
+        stack.push_back(node_index + 1);
+    }
+}
+
+} // namespace lvr_ros
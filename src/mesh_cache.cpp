@@ -0,0 +1,201 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mesh_cache.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+#include "lvr_ros/mesh_cache.h"
+#include "lvr_ros/mesh_tiles.h"
+#include "lvr_ros/textures.h"
+#include "lvr_ros/vertex_costs.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <boost/make_shared.hpp>
+#include <ros/console.h>
+#include <ros/time.h>
+
+namespace lvr_ros
+{
+
+/// Encodings kept per mesh, further ones are encoded on every request
+static const size_t MAX_COMPRESSED_TEXTURES = 64;
+
+/// jpeg and webp qualities are rounded to steps of this size, so that clients can not request an encoding per value
+static const int QUALITY_STEP = 10;
+
+const std::vector<MeshGeometryTile>& MeshCacheEntry::geometryTiles(double tile_size) const
+{
+    std::call_once(tiles_flag, [this, tile_size]()
+    {
+        tiles = partitionMeshGeometry(mesh_geometry_stamped.mesh_geometry, tile_size);
+        ROS_INFO_STREAM("Partitioned mesh " << uuid << " into " << tiles.size() << " tiles.");
+    });
+    return tiles;
+}
+
+const MeshBvh& MeshCacheEntry::bvh() const
+{
+    std::call_once(bvh_flag, [this]()
+    {
+        ros::WallTime start = ros::WallTime::now();
+        face_bvh = MeshBvh(mesh_geometry_stamped.mesh_geometry);
+        ROS_INFO_STREAM("Built BVH of mesh " << uuid << " with " << face_bvh.numFaces() << " faces in "
+            << (ros::WallTime::now() - start).toSec() << "s.");
+    });
+    return face_bvh;
+}
+
+mesh_msgs::MeshVertexCostsStampedConstPtr MeshCacheEntry::vertexCosts(const std::string& layer, double radius) const
+{
+    {
+        std::lock_guard<std::mutex> lock(vertex_costs_mutex);
+        auto iter = vertex_costs.find(layer);
+        if (iter != vertex_costs.end())
+        {
+            return iter->second;
+        }
+    }
+
+    // Compute without holding the lock, concurrent requests for the same layer at worst compute it twice
+    ros::WallTime start = ros::WallTime::now();
+    boost::shared_ptr<mesh_msgs::MeshVertexCostsStamped> costs =
+        boost::make_shared<mesh_msgs::MeshVertexCostsStamped>();
+    if (layer == "intensity")
+    {
+        if (vertex_intensities.empty())
+        {
+            return mesh_msgs::MeshVertexCostsStampedConstPtr();
+        }
+        costs->mesh_vertex_costs.costs = vertex_intensities;
+    }
+    else if (!computeVertexCosts(mesh_geometry_stamped.mesh_geometry, layer, radius, costs->mesh_vertex_costs.costs))
+    {
+        return mesh_msgs::MeshVertexCostsStampedConstPtr();
+    }
+    costs->header = mesh_geometry_stamped.header;
+    costs->uuid = uuid;
+    costs->type = layer;
+    ROS_INFO_STREAM("Computed vertex costs \"" << layer << "\" of mesh " << uuid << " in "
+        << (ros::WallTime::now() - start).toSec() << "s.");
+
+    std::lock_guard<std::mutex> lock(vertex_costs_mutex);
+    return vertex_costs.emplace(layer, costs).first->second;
+}
+
+const mesh_msgs::MeshTexture* MeshCacheEntry::textureLevel(
+    size_t texture_index,
+    size_t& level,
+    size_t& num_levels
+) const
+{
+    if (texture_index >= textures.size())
+    {
+        return nullptr;
+    }
+    if (level == 0)
+    {
+        num_levels = 1 + static_cast<size_t>(std::ceil(std::log2(std::max(
+            std::max(textures[texture_index].image.width, textures[texture_index].image.height), 1u
+        ))));
+        return &textures[texture_index];
+    }
+
+    boost::shared_ptr<const std::vector<mesh_msgs::MeshTexture>> levels;
+    {
+        std::lock_guard<std::mutex> lock(mipmaps_mutex);
+        auto iter = mipmaps.find(texture_index);
+        if (iter != mipmaps.end())
+        {
+            levels = iter->second;
+        }
+    }
+
+    // Build without holding the lock, so that other textures can be served meanwhile
+    if (!levels)
+    {
+        ros::WallTime start = ros::WallTime::now();
+        levels = boost::make_shared<const std::vector<mesh_msgs::MeshTexture>>(
+            createTextureMipmaps(textures[texture_index])
+        );
+        ROS_INFO_STREAM("Created " << levels->size() << " mipmap levels of texture " << texture_index
+            << " in " << (ros::WallTime::now() - start).toSec() << "s.");
+
+        std::lock_guard<std::mutex> lock(mipmaps_mutex);
+        levels = mipmaps.emplace(texture_index, levels).first->second;
+    }
+
+    num_levels = levels->size() + 1;
+    level = std::min(level, levels->size());
+    return level == 0 ? &textures[texture_index] : &(*levels)[level - 1];
+}
+
+sensor_msgs::CompressedImageConstPtr MeshCacheEntry::compressedTexture(
+    size_t texture_index,
+    size_t& level,
+    const std::string& format,
+    int quality
+) const
+{
+    size_t num_levels;
+    const mesh_msgs::MeshTexture* texture = textureLevel(texture_index, level, num_levels);
+    if (!texture)
+    {
+        return sensor_msgs::CompressedImageConstPtr();
+    }
+
+    if (format == "jpeg" || format == "webp")
+    {
+        quality = std::min(std::max(quality, 1), 100);
+        quality = std::max((quality + QUALITY_STEP / 2) / QUALITY_STEP, 1) * QUALITY_STEP;
+    }
+    else
+    {
+        quality = std::min(std::max(quality, 0), 9);
+    }
+
+    const CompressedTextureKey key(texture_index, level, format, quality);
+    {
+        std::lock_guard<std::mutex> lock(compressed_textures_mutex);
+        auto iter = compressed_textures.find(key);
+        if (iter != compressed_textures.end())
+        {
+            return iter->second;
+        }
+    }
+
+    // Encode without holding the lock, concurrent requests for the same encoding at worst encode it twice
+    boost::shared_ptr<sensor_msgs::CompressedImage> image = boost::make_shared<sensor_msgs::CompressedImage>();
+    if (!compressTexture(*texture, format, quality, *image))
+    {
+        return sensor_msgs::CompressedImageConstPtr();
+    }
+
+    std::lock_guard<std::mutex> lock(compressed_textures_mutex);
+    if (compressed_textures.size() >= MAX_COMPRESSED_TEXTURES)
+    {
+        return image;
+    }
+    return compressed_textures.emplace(key, image).first->second;
+}
+
+} // namespace lvr_ros
@@ -0,0 +1,430 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mesh_delta.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#include "lvr_ros/mesh_delta.h"
+
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace lvr_ros
+{
+
+static const uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+
+/// Normals of kept vertices which differ by less than this per component are not updated
+static const double NORMAL_TOLERANCE = 1e-3;
+
+static inline bool normalChanged(const geometry_msgs::Point& a, const geometry_msgs::Point& b)
+{
+    return std::abs(a.x - b.x) > NORMAL_TOLERANCE
+        || std::abs(a.y - b.y) > NORMAL_TOLERANCE
+        || std::abs(a.z - b.z) > NORMAL_TOLERANCE;
+}
+
+size_t MeshDeltaEncoder::VertexKeyHash::operator()(const VertexKey& key) const
+{
+    uint64_t hash = static_cast<uint64_t>(key.x) * 73856093ULL;
+    hash ^= static_cast<uint64_t>(key.y) * 19349663ULL;
+    hash ^= static_cast<uint64_t>(key.z) * 83492791ULL;
+    hash ^= static_cast<uint64_t>(key.occurrence) * 2654435761ULL;
+    return static_cast<size_t>(hash ^ (hash >> 29));
+}
+
+size_t MeshDeltaEncoder::FaceHash::operator()(const Face& face) const
+{
+    uint64_t hash = (uint64_t(face[0]) << 32 | face[1]) * 0x9E3779B97F4A7C15ULL;
+    hash ^= uint64_t(face[2]) * 0xC2B2AE3D27D4EB4FULL;
+    return static_cast<size_t>(hash ^ (hash >> 31));
+}
+
+/// Rotates the face so that its smallest index comes first, the orientation is preserved
+static inline std::array<uint32_t, 3> normalizedFace(uint32_t a, uint32_t b, uint32_t c)
+{
+    if (a <= b && a <= c)
+    {
+        return {{a, b, c}};
+    }
+    if (b <= a && b <= c)
+    {
+        return {{b, c, a}};
+    }
+    return {{c, a, b}};
+}
+
+MeshDeltaEncoder::MeshDeltaEncoder(double quantization, int keyframe_interval, double max_delta_ratio)
+    : quantization(quantization),
+      keyframe_interval(keyframe_interval),
+      max_delta_ratio(max_delta_ratio),
+      deltas_since_keyframe(0)
+{
+}
+
+void MeshDeltaEncoder::setParameters(double quantization, int keyframe_interval, double max_delta_ratio)
+{
+    if (quantization != this->quantization)
+    {
+        reset();
+    }
+    this->quantization = quantization;
+    this->keyframe_interval = keyframe_interval;
+    this->max_delta_ratio = max_delta_ratio;
+}
+
+void MeshDeltaEncoder::reset()
+{
+    uuid.clear();
+    frame_id.clear();
+    vertex_keys.clear();
+    vertex_normals.clear();
+    faces.clear();
+    deltas_since_keyframe = 0;
+}
+
+std::vector<MeshDeltaEncoder::VertexKey> MeshDeltaEncoder::quantize(
+    const std::vector<geometry_msgs::Point>& vertices
+) const
+{
+    const double scale = 1.0 / quantization;
+    std::vector<VertexKey> keys(vertices.size());
+    #pragma omp parallel for
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        keys[i].x = std::llround(vertices[i].x * scale);
+        keys[i].y = std::llround(vertices[i].y * scale);
+        keys[i].z = std::llround(vertices[i].z * scale);
+        keys[i].occurrence = 0;
+    }
+
+    // Vertices at the same position are numbered in the order of the mesh
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> occurrences;
+    occurrences.reserve(keys.size());
+    for (VertexKey& key : keys)
+    {
+        key.occurrence = occurrences[key]++;
+    }
+    return keys;
+}
+
+MeshGeometryDelta MeshDeltaEncoder::encodeKeyframe(
+    const mesh_msgs::MeshGeometryStamped& mesh,
+    std::vector<VertexKey>& keys
+)
+{
+    const auto& geometry = mesh.mesh_geometry;
+
+    MeshGeometryDelta delta;
+    delta.header = mesh.header;
+    delta.uuid = mesh.uuid;
+    delta.keyframe = true;
+    delta.added_vertices = geometry.vertices;
+    delta.added_vertex_normals = geometry.vertex_normals;
+    delta.added_faces = geometry.faces;
+
+    uuid = mesh.uuid;
+    frame_id = mesh.header.frame_id;
+    vertex_keys.swap(keys);
+    if (geometry.vertex_normals.size() == geometry.vertices.size())
+    {
+        vertex_normals = geometry.vertex_normals;
+    }
+    else
+    {
+        vertex_normals.clear();
+    }
+    faces.resize(geometry.faces.size());
+    for (size_t i = 0; i < geometry.faces.size(); i++)
+    {
+        const auto& indices = geometry.faces[i].vertex_indices;
+        faces[i] = {{indices[0], indices[1], indices[2]}};
+    }
+    deltas_since_keyframe = 0;
+    return delta;
+}
+
+MeshGeometryDelta MeshDeltaEncoder::encode(const mesh_msgs::MeshGeometryStamped& mesh, bool force_keyframe)
+{
+    const auto& vertices = mesh.mesh_geometry.vertices;
+    const auto& mesh_faces = mesh.mesh_geometry.faces;
+    const auto& normals = mesh.mesh_geometry.vertex_normals;
+
+    std::vector<VertexKey> keys = quantize(vertices);
+
+    // The added vertices of a delta have normals if and only if the kept ones have them
+    const bool has_normals = normals.size() == vertices.size();
+    const bool had_normals = vertex_normals.size() == vertex_keys.size();
+    if (force_keyframe
+        || uuid.empty()
+        || frame_id != mesh.header.frame_id
+        || has_normals != had_normals
+        || (keyframe_interval > 0 && deltas_since_keyframe + 1 >= keyframe_interval))
+    {
+        return encodeKeyframe(mesh, keys);
+    }
+
+    // Match the vertices of the new mesh with the previous ones
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> previous_vertices;
+    previous_vertices.reserve(vertex_keys.size());
+    for (size_t i = 0; i < vertex_keys.size(); i++)
+    {
+        previous_vertices.emplace(vertex_keys[i], static_cast<uint32_t>(i));
+    }
+
+    std::vector<uint32_t> vertex_match(vertices.size(), NO_INDEX);
+    std::vector<bool> vertex_kept(vertex_keys.size(), false);
+    // The new vertex of every kept vertex whose normal changed
+    std::vector<uint32_t> normal_update(vertex_keys.size(), NO_INDEX);
+    size_t num_updated_normals = 0;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        auto iter = previous_vertices.find(keys[i]);
+        if (iter != previous_vertices.end())
+        {
+            vertex_match[i] = iter->second;
+            vertex_kept[iter->second] = true;
+            if (has_normals && normalChanged(normals[i], vertex_normals[iter->second]))
+            {
+                normal_update[iter->second] = static_cast<uint32_t>(i);
+                num_updated_normals++;
+            }
+        }
+    }
+
+    // Match the faces, only faces between matched vertices can have been there before
+    std::unordered_map<Face, uint32_t, FaceHash> previous_faces;
+    previous_faces.reserve(faces.size());
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        previous_faces.emplace(normalizedFace(faces[i][0], faces[i][1], faces[i][2]), static_cast<uint32_t>(i));
+    }
+
+    std::vector<uint32_t> face_match(mesh_faces.size(), NO_INDEX);
+    bool mismatch = false;
+    #pragma omp parallel for reduction(||:mismatch)
+    for (size_t i = 0; i < mesh_faces.size(); i++)
+    {
+        const auto& indices = mesh_faces[i].vertex_indices;
+        if (indices[0] >= vertices.size() || indices[1] >= vertices.size() || indices[2] >= vertices.size())
+        {
+            mismatch = true;
+            continue;
+        }
+        const uint32_t a = vertex_match[indices[0]];
+        const uint32_t b = vertex_match[indices[1]];
+        const uint32_t c = vertex_match[indices[2]];
+        if (a == NO_INDEX || b == NO_INDEX || c == NO_INDEX)
+        {
+            continue;
+        }
+        auto iter = previous_faces.find(normalizedFace(a, b, c));
+        if (iter != previous_faces.end())
+        {
+            face_match[i] = iter->second;
+        }
+    }
+    if (mismatch)
+    {
+        return encodeKeyframe(mesh, keys);
+    }
+
+    // A duplicated face of the new mesh can only take the place of one previous face
+    std::vector<bool> face_kept(faces.size(), false);
+    for (uint32_t& match : face_match)
+    {
+        if (match != NO_INDEX)
+        {
+            if (face_kept[match])
+            {
+                match = NO_INDEX;
+            }
+            else
+            {
+                face_kept[match] = true;
+            }
+        }
+    }
+
+    // Indices of the kept vertices after the removed ones are gone
+    std::vector<uint32_t> compacted(vertex_keys.size(), NO_INDEX);
+    uint32_t num_kept_vertices = 0;
+    for (size_t i = 0; i < vertex_keys.size(); i++)
+    {
+        if (vertex_kept[i])
+        {
+            compacted[i] = num_kept_vertices++;
+        }
+    }
+    size_t num_kept_faces = 0;
+    for (bool kept : face_kept)
+    {
+        num_kept_faces += kept;
+    }
+
+    const size_t num_removed = (vertex_keys.size() - num_kept_vertices) + (faces.size() - num_kept_faces);
+    const size_t num_added = (vertices.size() - num_kept_vertices) + (mesh_faces.size() - num_kept_faces)
+        + num_updated_normals;
+    if (num_removed + num_added > max_delta_ratio * (vertices.size() + mesh_faces.size()))
+    {
+        return encodeKeyframe(mesh, keys);
+    }
+
+    MeshGeometryDelta delta;
+    delta.header = mesh.header;
+    delta.uuid = mesh.uuid;
+    delta.base_uuid = uuid;
+    delta.keyframe = false;
+
+    for (size_t i = 0; i < vertex_keys.size(); i++)
+    {
+        if (!vertex_kept[i])
+        {
+            delta.removed_vertices.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        if (!face_kept[i])
+        {
+            delta.removed_faces.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    // Vertices of step 3: the kept vertices in their previous order, followed by the added ones
+    std::vector<geometry_msgs::Point> new_vertex_normals;
+    new_vertex_normals.reserve(has_normals ? vertices.size() : 0);
+    for (size_t i = 0; has_normals && i < vertex_keys.size(); i++)
+    {
+        if (!vertex_kept[i])
+        {
+            continue;
+        }
+        if (normal_update[i] != NO_INDEX)
+        {
+            delta.updated_normal_vertices.push_back(compacted[i]);
+            delta.updated_vertex_normals.push_back(normals[normal_update[i]]);
+            new_vertex_normals.push_back(normals[normal_update[i]]);
+        }
+        else
+        {
+            new_vertex_normals.push_back(vertex_normals[i]);
+        }
+    }
+
+    // Index of every vertex of the new mesh in the vertex list of step 3
+    std::vector<uint32_t> vertex_index(vertices.size());
+    uint32_t num_step_vertices = num_kept_vertices;
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        if (vertex_match[i] != NO_INDEX)
+        {
+            vertex_index[i] = compacted[vertex_match[i]];
+        }
+        else
+        {
+            vertex_index[i] = num_step_vertices++;
+            delta.added_vertices.push_back(vertices[i]);
+            if (has_normals)
+            {
+                delta.added_vertex_normals.push_back(normals[i]);
+                new_vertex_normals.push_back(normals[i]);
+            }
+        }
+    }
+
+    // Faces of step 4: the kept faces in their previous order, followed by the added ones
+    std::vector<Face> new_faces;
+    std::vector<uint32_t> compacted_faces(faces.size(), NO_INDEX);
+    new_faces.reserve(mesh_faces.size());
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        if (face_kept[i])
+        {
+            compacted_faces[i] = static_cast<uint32_t>(new_faces.size());
+            new_faces.push_back({{compacted[faces[i][0]], compacted[faces[i][1]], compacted[faces[i][2]]}});
+        }
+    }
+    std::vector<uint32_t> face_index(mesh_faces.size());
+    for (size_t i = 0; i < mesh_faces.size(); i++)
+    {
+        if (face_match[i] != NO_INDEX)
+        {
+            face_index[i] = compacted_faces[face_match[i]];
+        }
+        else
+        {
+            const auto& indices = mesh_faces[i].vertex_indices;
+            mesh_msgs::TriangleIndices face;
+            face.vertex_indices[0] = vertex_index[indices[0]];
+            face.vertex_indices[1] = vertex_index[indices[1]];
+            face.vertex_indices[2] = vertex_index[indices[2]];
+            delta.added_faces.push_back(face);
+            face_index[i] = static_cast<uint32_t>(new_faces.size());
+            new_faces.push_back({{face.vertex_indices[0], face.vertex_indices[1], face.vertex_indices[2]}});
+        }
+    }
+
+    // Step 5 restores the order of the new mesh, so that the indices of its other data apply to the subscribers
+    std::vector<uint32_t> vertex_order(vertices.size());
+    bool vertices_ordered = true;
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        vertex_order[vertex_index[i]] = static_cast<uint32_t>(i);
+        vertices_ordered = vertices_ordered && vertex_index[i] == i;
+    }
+    std::vector<uint32_t> face_order(mesh_faces.size());
+    bool faces_ordered = true;
+    for (size_t i = 0; i < mesh_faces.size(); i++)
+    {
+        face_order[face_index[i]] = static_cast<uint32_t>(i);
+        faces_ordered = faces_ordered && face_index[i] == i;
+    }
+    if (!vertices_ordered)
+    {
+        delta.vertex_order = vertex_order;
+    }
+    if (!faces_ordered)
+    {
+        delta.face_order = face_order;
+    }
+
+    // The mesh as the subscribers see it after step 5
+    uuid = mesh.uuid;
+    vertex_keys.swap(keys);
+    vertex_normals.resize(new_vertex_normals.size());
+    for (size_t i = 0; i < new_vertex_normals.size(); i++)
+    {
+        vertex_normals[vertex_order[i]] = new_vertex_normals[i];
+    }
+    faces.resize(new_faces.size());
+    for (size_t i = 0; i < new_faces.size(); i++)
+    {
+        const Face& face = new_faces[i];
+        faces[face_order[i]] = {{vertex_order[face[0]], vertex_order[face[1]], vertex_order[face[2]]}};
+    }
+    deltas_since_keyframe++;
+    return delta;
+}
+
+} // namespace lvr_ros
@@ -0,0 +1,304 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mesh_store.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+#include "lvr_ros/mesh_store.h"
+#include "lvr_ros/hdf5_mesh_io.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <boost/make_shared.hpp>
+#include <ros/console.h>
+
+namespace lvr_ros
+{
+
+static const std::string STORE_MESH_NAME = "triangle_mesh";
+static const std::string STORE_FILE_EXTENSION = ".h5";
+static const size_t STORE_CHUNK_ROWS = 1 << 16;
+
+MeshStore::MeshStore(
+    const std::string& directory,
+    int compression_level,
+    size_t max_loaded,
+    size_t max_pending,
+    size_t max_stored
+)
+    : directory(directory),
+      compression_level(compression_level),
+      max_loaded(max_loaded),
+      max_pending(max_pending),
+      max_stored(max_stored),
+      indexed(false),
+      running(true)
+{
+    mkdir(directory.c_str(), 0755);
+    writer = std::thread(&MeshStore::writerLoop, this);
+}
+
+MeshStore::~MeshStore()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    queue_condition.notify_all();
+    writer.join();
+}
+
+std::string MeshStore::filename(const std::string& uuid) const
+{
+    return directory + "/" + uuid + STORE_FILE_EXTENSION;
+}
+
+bool MeshStore::store(const MeshCacheEntryConstPtr& entry)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Every job holds a whole mesh in memory, a slow disk must not let them pile up
+        if (queue.size() >= max_pending)
+        {
+            ROS_WARN_STREAM("Mesh store is " << queue.size() << " meshes behind, mesh " << entry->uuid
+                << " is not stored!");
+            return false;
+        }
+        queue.push_back(entry);
+        pending[entry->uuid] = entry;
+    }
+    queue_condition.notify_one();
+    return true;
+}
+
+void MeshStore::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!indexed)
+    {
+        indexDirectory();
+        indexed = true;
+    }
+    enforceRetention();
+
+    while (true)
+    {
+        queue_condition.wait(lock, [this]{ return !queue.empty() || !running; });
+        if (queue.empty())
+        {
+            // Not running anymore and nothing left to write
+            return;
+        }
+
+        MeshCacheEntryConstPtr entry = queue.front();
+        queue.pop_front();
+
+        lock.unlock();
+        bool written = write(*entry);
+        lock.lock();
+
+        // Failed writes are not retried, the error has been logged
+        pending.erase(entry->uuid);
+        if (written && index.insert(entry->uuid).second)
+        {
+            stored.push_back(entry->uuid);
+            enforceRetention();
+        }
+    }
+}
+
+void MeshStore::enforceRetention()
+{
+    if (max_stored == 0)
+    {
+        return;
+    }
+    while (stored.size() > max_stored)
+    {
+        const std::string uuid = stored.front();
+        stored.pop_front();
+        index.erase(uuid);
+        if (unlink(filename(uuid).c_str()) != 0)
+        {
+            ROS_WARN_STREAM("Could not remove stored mesh " << uuid << " from \"" << directory << "\"!");
+        }
+    }
+}
+
+bool MeshStore::write(const MeshCacheEntry& entry)
+{
+    ros::WallTime start = ros::WallTime::now();
+    const std_msgs::Header& header = entry.mesh_geometry_stamped.header;
+
+    // Service threads loading stored meshes get the library between the chunks of the datasets
+    Hdf5MeshWriter mesh_writer(filename(entry.uuid), STORE_MESH_NAME, compression_level, STORE_CHUNK_ROWS, &hdf5_mutex);
+    bool success = mesh_writer.write(
+            entry.mesh_geometry_stamped.mesh_geometry,
+            entry.mesh_materials_stamped.mesh_materials,
+            entry.mesh_vertex_colors_stamped.mesh_vertex_colors,
+            entry.vertex_intensities,
+            entry.textures
+        )
+        && mesh_writer.writeAttribute("uuid", entry.uuid)
+        && mesh_writer.writeAttribute("frame_id", header.frame_id)
+        && mesh_writer.writeAttribute("stamp", std::vector<uint32_t>{header.stamp.sec, header.stamp.nsec})
+        && mesh_writer.close();
+
+    if (!success)
+    {
+        // Do not leave a partially written file behind, it would be indexed on the next start
+        unlink(filename(entry.uuid).c_str());
+    }
+
+    if (success)
+    {
+        ROS_INFO_STREAM("Stored mesh " << entry.uuid << " in " << (ros::WallTime::now() - start).toSec() << "s.");
+    }
+    else
+    {
+        ROS_ERROR_STREAM("Could not store mesh " << entry.uuid << " in \"" << directory << "\"!");
+    }
+    return success;
+}
+
+void MeshStore::indexDirectory()
+{
+    DIR* dir = opendir(directory.c_str());
+    if (!dir)
+    {
+        ROS_ERROR_STREAM("Could not open mesh store directory \"" << directory << "\"!");
+        return;
+    }
+
+    // Ordered by modification time, so that the retention removes the oldest meshes first
+    const size_t ext_length = STORE_FILE_EXTENSION.size();
+    std::vector<std::pair<time_t, std::string>> files;
+    while (dirent* file = readdir(dir))
+    {
+        const std::string name(file->d_name);
+        struct stat file_stat;
+        if (name.size() > ext_length && name.compare(name.size() - ext_length, ext_length, STORE_FILE_EXTENSION) == 0
+            && stat((directory + "/" + name).c_str(), &file_stat) == 0)
+        {
+            files.emplace_back(file_stat.st_mtime, name.substr(0, name.size() - ext_length));
+        }
+    }
+    closedir(dir);
+
+    std::sort(files.begin(), files.end());
+    for (const auto& file : files)
+    {
+        if (index.insert(file.second).second)
+        {
+            stored.push_back(file.second);
+        }
+    }
+    ROS_INFO_STREAM("Indexed " << files.size() << " stored meshes in \"" << directory << "\".");
+}
+
+MeshCacheEntryConstPtr MeshStore::load(const std::string& uuid)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto pending_iter = pending.find(uuid);
+        if (pending_iter != pending.end())
+        {
+            return pending_iter->second;
+        }
+
+        for (auto iter = loaded.begin(); iter != loaded.end(); ++iter)
+        {
+            if ((*iter)->uuid == uuid)
+            {
+                // Move to the front, the least recently used entries are dropped at the back
+                loaded.splice(loaded.begin(), loaded, iter);
+                return loaded.front();
+            }
+        }
+
+        if (!indexed)
+        {
+            indexDirectory();
+            indexed = true;
+        }
+        if (index.find(uuid) == index.end())
+        {
+            return MeshCacheEntryConstPtr();
+        }
+    }
+
+    MeshCacheEntryConstPtr entry = read(uuid);
+    if (entry && max_loaded > 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        loaded.push_front(entry);
+        if (loaded.size() > max_loaded)
+        {
+            loaded.pop_back();
+        }
+    }
+    return entry;
+}
+
+MeshCacheEntryConstPtr MeshStore::read(const std::string& uuid)
+{
+    ros::WallTime start = ros::WallTime::now();
+    MeshCacheEntryPtr entry = boost::make_shared<MeshCacheEntry>();
+    entry->uuid = uuid;
+
+    std::lock_guard<std::mutex> hdf5_lock(hdf5_mutex);
+    Hdf5MeshReader reader(filename(uuid), STORE_MESH_NAME);
+
+    std_msgs::Header header;
+    std::vector<uint32_t> stamp;
+    reader.readAttribute("frame_id", header.frame_id);
+    if (reader.readAttribute("stamp", stamp) && stamp.size() == 2)
+    {
+        header.stamp = ros::Time(stamp[0], stamp[1]);
+    }
+
+    if (!reader.readGeometry(entry->mesh_geometry_stamped.mesh_geometry)
+        || !reader.readMaterials(entry->mesh_materials_stamped.mesh_materials)
+        || !reader.readTextures(entry->textures, uuid))
+    {
+        ROS_ERROR_STREAM("Could not load stored mesh " << uuid << "!");
+        return MeshCacheEntryConstPtr();
+    }
+    reader.readVertexColors(entry->mesh_vertex_colors_stamped.mesh_vertex_colors);
+    reader.readVertexIntensities(entry->vertex_intensities);
+
+    entry->mesh_geometry_stamped.header = header;
+    entry->mesh_geometry_stamped.uuid = uuid;
+    entry->mesh_materials_stamped.header = header;
+    entry->mesh_materials_stamped.uuid = uuid;
+    entry->mesh_vertex_colors_stamped.header = header;
+    entry->mesh_vertex_colors_stamped.uuid = uuid;
+
+    ROS_INFO_STREAM("Loaded stored mesh " << uuid << " in " << (ros::WallTime::now() - start).toSec() << "s.");
+    return entry;
+}
+
+} // namespace lvr_ros
@@ -0,0 +1,198 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mesh_tiles.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+#include "lvr_ros/mesh_tiles.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace lvr_ros
+{
+
+// Number of bits per axis of a packed grid cell key
+static const int CELL_BITS = 21;
+static const int64_t CELL_MAX = (int64_t(1) << CELL_BITS) - 1;
+
+static inline uint64_t cellKey(double value_x, double value_y, double value_z)
+{
+    const int64_t x = std::min(std::max<int64_t>(static_cast<int64_t>(value_x), 0), CELL_MAX);
+    const int64_t y = std::min(std::max<int64_t>(static_cast<int64_t>(value_y), 0), CELL_MAX);
+    const int64_t z = std::min(std::max<int64_t>(static_cast<int64_t>(value_z), 0), CELL_MAX);
+    return (uint64_t(x) << (2 * CELL_BITS)) | (uint64_t(y) << CELL_BITS) | uint64_t(z);
+}
+
+std::vector<MeshGeometryTile> partitionMeshGeometry(
+    const mesh_msgs::MeshGeometry& mesh_geometry,
+    double tile_size
+)
+{
+    const auto& vertices = mesh_geometry.vertices;
+    const auto& faces = mesh_geometry.faces;
+    const auto& normals = mesh_geometry.vertex_normals;
+    const bool has_normals = normals.size() == vertices.size();
+
+    std::vector<MeshGeometryTile> tiles;
+    if (vertices.empty() || faces.empty() || !(tile_size > 0))
+    {
+        return tiles;
+    }
+
+    // The grid starts at the minimum corner of the mesh
+    geometry_msgs::Point origin = vertices[0];
+    for (const auto& v : vertices)
+    {
+        origin.x = std::min(origin.x, v.x);
+        origin.y = std::min(origin.y, v.y);
+        origin.z = std::min(origin.z, v.z);
+    }
+
+    // Grid cell of every face centroid
+    const double scale = 1.0 / (3.0 * tile_size);
+    std::vector<std::pair<uint64_t, uint32_t>> face_cells(faces.size());
+    #pragma omp parallel for
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        const auto& a = vertices[faces[i].vertex_indices[0]];
+        const auto& b = vertices[faces[i].vertex_indices[1]];
+        const auto& c = vertices[faces[i].vertex_indices[2]];
+        face_cells[i].first = cellKey(
+            (a.x + b.x + c.x - 3.0 * origin.x) * scale,
+            (a.y + b.y + c.y - 3.0 * origin.y) * scale,
+            (a.z + b.z + c.z - 3.0 * origin.z) * scale
+        );
+        face_cells[i].second = static_cast<uint32_t>(i);
+    }
+
+    // Faces of the same cell are consecutive afterwards, in their original order
+    std::sort(face_cells.begin(), face_cells.end());
+
+    std::vector<size_t> tile_begin;
+    for (size_t i = 0; i < face_cells.size(); i++)
+    {
+        if (i == 0 || face_cells[i].first != face_cells[i - 1].first)
+        {
+            tile_begin.push_back(i);
+        }
+    }
+    tile_begin.push_back(face_cells.size());
+
+    tiles.resize(tile_begin.size() - 1);
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t t = 0; t < tiles.size(); t++)
+    {
+        MeshGeometryTile& tile = tiles[t];
+        const size_t begin = tile_begin[t];
+        const size_t end = tile_begin[t + 1];
+
+        tile.tile_index = static_cast<uint32_t>(t);
+        tile.bbox_min.x = tile.bbox_min.y = tile.bbox_min.z = std::numeric_limits<double>::max();
+        tile.bbox_max.x = tile.bbox_max.y = tile.bbox_max.z = std::numeric_limits<double>::lowest();
+        tile.face_indices.reserve(end - begin);
+        tile.mesh_geometry.faces.resize(end - begin);
+
+        // Global to tile local vertex index
+        std::unordered_map<uint32_t, uint32_t> local_index;
+        local_index.reserve(end - begin);
+
+        for (size_t i = begin; i < end; i++)
+        {
+            const uint32_t face_index = face_cells[i].second;
+            tile.face_indices.push_back(face_index);
+            for (size_t k = 0; k < 3; k++)
+            {
+                const uint32_t vertex_index = faces[face_index].vertex_indices[k];
+                auto inserted = local_index.emplace(vertex_index, tile.vertex_indices.size());
+                if (inserted.second)
+                {
+                    const geometry_msgs::Point& v = vertices[vertex_index];
+                    tile.vertex_indices.push_back(vertex_index);
+                    tile.mesh_geometry.vertices.push_back(v);
+                    if (has_normals)
+                    {
+                        tile.mesh_geometry.vertex_normals.push_back(normals[vertex_index]);
+                    }
+                    tile.bbox_min.x = std::min(tile.bbox_min.x, v.x);
+                    tile.bbox_min.y = std::min(tile.bbox_min.y, v.y);
+                    tile.bbox_min.z = std::min(tile.bbox_min.z, v.z);
+                    tile.bbox_max.x = std::max(tile.bbox_max.x, v.x);
+                    tile.bbox_max.y = std::max(tile.bbox_max.y, v.y);
+                    tile.bbox_max.z = std::max(tile.bbox_max.z, v.z);
+                }
+                tile.mesh_geometry.faces[i - begin].vertex_indices[k] = inserted.first->second;
+            }
+        }
+    }
+
+    return tiles;
+}
+
+std::vector<size_t> selectMeshTiles(
+    const std::vector<MeshGeometryTile>& tiles,
+    const geometry_msgs::Point& min,
+    const geometry_msgs::Point& max
+)
+{
+    std::vector<size_t> selected;
+    if (min.x > max.x || min.y > max.y || min.z > max.z)
+    {
+        selected.resize(tiles.size());
+        for (size_t i = 0; i < tiles.size(); i++)
+        {
+            selected[i] = i;
+        }
+        return selected;
+    }
+
+    const double center_x = (min.x + max.x) / 2;
+    const double center_y = (min.y + max.y) / 2;
+    const double center_z = (min.z + max.z) / 2;
+
+    std::vector<std::pair<double, size_t>> matches;
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        const MeshGeometryTile& tile = tiles[i];
+        if (tile.bbox_min.x > max.x || tile.bbox_max.x < min.x
+            || tile.bbox_min.y > max.y || tile.bbox_max.y < min.y
+            || tile.bbox_min.z > max.z || tile.bbox_max.z < min.z)
+        {
+            continue;
+        }
+        const double dx = (tile.bbox_min.x + tile.bbox_max.x) / 2 - center_x;
+        const double dy = (tile.bbox_min.y + tile.bbox_max.y) / 2 - center_y;
+        const double dz = (tile.bbox_min.z + tile.bbox_max.z) / 2 - center_z;
+        matches.emplace_back(dx * dx + dy * dy + dz * dz, i);
+    }
+    std::sort(matches.begin(), matches.end());
+
+    selected.reserve(matches.size());
+    for (const auto& match : matches)
+    {
+        selected.push_back(match.second);
+    }
+    return selected;
+}
+
+} // namespace lvr_ros
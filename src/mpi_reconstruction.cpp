@@ -0,0 +1,516 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mpi_reconstruction.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+#include "lvr_ros/mpi_reconstruction.h"
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include <dynamic_reconfigure/Config.h>
+#include <ros/console.h>
+#include <ros/serialization.h>
+
+#include <lvr2/geometry/BaseVector.hpp>
+#include <lvr2/geometry/BoundingBox.hpp>
+
+#include "lvr_ros/conversions.h"
+#include "lvr_ros/reconstruction_pipeline.h"
+#include "lvr_ros/reconstruction_tiles.h"
+#include "lvr_ros/voxel_occupancy.h"
+
+namespace lvr_ros
+{
+
+using Vec = lvr2::BaseVector<float>;
+
+/// Commands broadcast by rank 0 to the tile workers
+enum TileCommand
+{
+    TILE_STOP = 0,
+    TILE_RECONSTRUCT = 1
+};
+
+static const int TILE_TAG = 1;
+static const int MESH_TAG = 2;
+
+/// Messages are split into chunks, as MPI counts are int
+static const size_t MAX_CHUNK_BYTES = 1 << 30;
+
+/// Rank 0 calls MPI from the callback threads of the node, one reconstruction at a time
+static std::mutex mpi_mutex;
+
+template<typename T>
+static void sendVector(const std::vector<T>& values, int rank, int tag)
+{
+    uint64_t size = values.size();
+    MPI_Send(&size, 1, MPI_UINT64_T, rank, tag, MPI_COMM_WORLD);
+    const char* bytes = reinterpret_cast<const char*>(values.data());
+    for (size_t offset = 0; offset < size * sizeof(T); offset += MAX_CHUNK_BYTES)
+    {
+        const int count = static_cast<int>(std::min(MAX_CHUNK_BYTES, size * sizeof(T) - offset));
+        MPI_Send(bytes + offset, count, MPI_BYTE, rank, tag, MPI_COMM_WORLD);
+    }
+}
+
+template<typename T>
+static void receiveVector(std::vector<T>& values, int rank, int tag)
+{
+    uint64_t size;
+    MPI_Recv(&size, 1, MPI_UINT64_T, rank, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    values.resize(size);
+    char* bytes = reinterpret_cast<char*>(values.data());
+    for (size_t offset = 0; offset < size * sizeof(T); offset += MAX_CHUNK_BYTES)
+    {
+        const int count = static_cast<int>(std::min(MAX_CHUNK_BYTES, size * sizeof(T) - offset));
+        MPI_Recv(bytes + offset, count, MPI_BYTE, rank, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+}
+
+/// Broadcasts the config from rank 0 as serialized config message
+static void broadcastConfig(ReconstructionConfig& config, int rank)
+{
+    dynamic_reconfigure::Config message;
+    std::vector<uint8_t> buffer;
+    if (rank == 0)
+    {
+        config.__toMessage__(message);
+        buffer.resize(ros::serialization::serializationLength(message));
+        ros::serialization::OStream stream(buffer.data(), buffer.size());
+        ros::serialization::serialize(stream, message);
+    }
+
+    uint64_t size = buffer.size();
+    MPI_Bcast(&size, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    buffer.resize(size);
+    MPI_Bcast(buffer.data(), static_cast<int>(size), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+    if (rank != 0)
+    {
+        ros::serialization::IStream stream(buffer.data(), buffer.size());
+        ros::serialization::deserialize(stream, message);
+        config = ReconstructionConfig::__getDefault__();
+        config.__fromMessage__(message);
+    }
+}
+
+/**
+ * Reconstructs the points of a tile on the voxel lattice through the origin and crops the mesh to the core of the
+ * tile. The mesh is empty if the reconstruction failed.
+ */
+static void reconstructTile(
+    const ReconstructionConfig& config,
+    const float origin[3],
+    const ReconstructionTile& tile,
+    const std::vector<float>& points,
+    const std::vector<float>& normals,
+    const std::vector<float>& intensities,
+    TileMesh& mesh
+)
+{
+    mesh = TileMesh();
+    const size_t num_points = points.size() / 3;
+    if (num_points <= static_cast<size_t>(std::max(config.kn, config.ki)))
+    {
+        ROS_WARN_STREAM("Skipping a tile with only " << num_points << " points.");
+        return;
+    }
+
+    lvr2::floatArr point_array(new float[points.size()]);
+    std::copy(points.begin(), points.end(), point_array.get());
+    lvr2::PointBufferPtr point_buffer(new lvr2::PointBuffer(point_array, num_points));
+    if (normals.size() == points.size())
+    {
+        lvr2::floatArr normal_array(new float[normals.size()]);
+        std::copy(normals.begin(), normals.end(), normal_array.get());
+        point_buffer->setNormalArray(normal_array, num_points);
+    }
+    if (intensities.size() == num_points)
+    {
+        lvr2::floatArr intensity_array(new float[num_points]);
+        std::copy(intensities.begin(), intensities.end(), intensity_array.get());
+        point_buffer->addFloatChannel(intensity_array, "intensity", num_points, 1);
+    }
+
+    // Snap the grid bounds outwards to the common lattice, so the voxels of all tiles line up
+    float min[3], max[3];
+    std::fill(min, min + 3, std::numeric_limits<float>::max());
+    std::fill(max, max + 3, std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < num_points; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            min[axis] = std::min(min[axis], points[3 * i + axis]);
+            max[axis] = std::max(max[axis], points[3 * i + axis]);
+        }
+    }
+    const float voxelsize = config.voxelsize;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        min[axis] = origin[axis] + std::floor((min[axis] - origin[axis]) / voxelsize) * voxelsize;
+        max[axis] = origin[axis] + std::ceil((max[axis] - origin[axis]) / voxelsize) * voxelsize;
+    }
+    const lvr2::BoundingBox<Vec> grid_bounds(Vec(min[0], min[1], min[2]), Vec(max[0], max[1], max[2]));
+
+    lvr2::MeshBufferPtr mesh_buffer;
+    if (!reconstructMeshBuffer(config, point_buffer, mesh_buffer, ReconstructionStageCallback(), grid_bounds)
+        || !mesh_buffer)
+    {
+        return;
+    }
+
+    const size_t num_vertices = mesh_buffer->numVertices();
+    size_t num_intensities;
+    unsigned intensity_width;
+    lvr2::floatArr vertex_intensities = mesh_buffer->getFloatArray("intensity", num_intensities, intensity_width);
+    lvr2::floatArr vertex_normals = mesh_buffer->getVertexNormals();
+    cropTileMesh(
+        tile,
+        mesh_buffer->getVertices().get(),
+        mesh_buffer->hasVertexNormals() ? vertex_normals.get() : nullptr,
+        vertex_intensities && intensity_width == 1 && num_intensities == num_vertices
+            ? vertex_intensities.get()
+            : nullptr,
+        num_vertices,
+        mesh_buffer->getFaceIndices().get(),
+        mesh_buffer->numFaces(),
+        mesh
+    );
+}
+
+/// Reconstructs a tile, failures of one tile leave a hole instead of aborting all ranks
+static void reconstructTileSafely(
+    const ReconstructionConfig& config,
+    const float origin[3],
+    const ReconstructionTile& tile,
+    const std::vector<float>& points,
+    const std::vector<float>& normals,
+    const std::vector<float>& intensities,
+    TileMesh& mesh
+)
+{
+    try
+    {
+        reconstructTile(config, origin, tile, points, normals, intensities, mesh);
+    }
+    catch (std::exception& e)
+    {
+        ROS_ERROR_STREAM("Reconstruction of a tile failed: " << e.what());
+        mesh = TileMesh();
+    }
+}
+
+/// Concatenates the tile meshes and welds the vertices on the borders of the tiles
+static lvr2::MeshBufferPtr stitchTileMeshes(const std::vector<TileMesh>& meshes, float weld_distance)
+{
+    size_t num_vertices = 0, num_faces = 0;
+    bool has_normals = true, has_intensities = true;
+    for (const TileMesh& mesh : meshes)
+    {
+        if (mesh.faces.empty())
+        {
+            continue;
+        }
+        num_vertices += mesh.vertices.size() / 3;
+        num_faces += mesh.faces.size() / 3;
+        has_normals &= mesh.normals.size() == mesh.vertices.size();
+        has_intensities &= mesh.intensities.size() * 3 == mesh.vertices.size();
+    }
+
+    lvr2::floatArr vertices(new float[num_vertices * 3]);
+    lvr2::floatArr normals(has_normals ? new float[num_vertices * 3] : nullptr);
+    lvr2::floatArr intensities(has_intensities ? new float[num_vertices] : nullptr);
+    lvr2::indexArray faces(new unsigned int[num_faces * 3]);
+    size_t vertex_offset = 0, face_offset = 0;
+    for (const TileMesh& mesh : meshes)
+    {
+        if (mesh.faces.empty())
+        {
+            continue;
+        }
+        std::copy(mesh.vertices.begin(), mesh.vertices.end(), &vertices[3 * vertex_offset]);
+        if (has_normals)
+        {
+            std::copy(mesh.normals.begin(), mesh.normals.end(), &normals[3 * vertex_offset]);
+        }
+        if (has_intensities)
+        {
+            std::copy(mesh.intensities.begin(), mesh.intensities.end(), &intensities[vertex_offset]);
+        }
+        for (size_t i = 0; i < mesh.faces.size(); i++)
+        {
+            faces[3 * face_offset + i] = mesh.faces[i] + static_cast<unsigned int>(vertex_offset);
+        }
+        vertex_offset += mesh.vertices.size() / 3;
+        face_offset += mesh.faces.size() / 3;
+    }
+
+    lvr2::MeshBufferPtr buffer(new lvr2::MeshBuffer);
+    buffer->setVertices(vertices, num_vertices);
+    buffer->setFaceIndices(faces, num_faces);
+    if (has_normals)
+    {
+        buffer->setVertexNormals(normals);
+    }
+    if (has_intensities)
+    {
+        buffer->addFloatChannel(intensities, "intensity", num_vertices, 1);
+    }
+    const size_t num_welded = removeDuplicates(*buffer, weld_distance);
+
+    // Faces at the borders which collapsed by welding are dropped
+    faces = buffer->getFaceIndices();
+    size_t num_kept = 0;
+    for (size_t f = 0; f < num_faces; f++)
+    {
+        const unsigned int a = faces[3 * f], b = faces[3 * f + 1], c = faces[3 * f + 2];
+        if (a != b && b != c && a != c)
+        {
+            faces[3 * num_kept] = a;
+            faces[3 * num_kept + 1] = b;
+            faces[3 * num_kept + 2] = c;
+            num_kept++;
+        }
+    }
+    buffer->setFaceIndices(faces, num_kept);
+
+    ROS_INFO_STREAM("Stitched " << meshes.size() << " tiles, welded " << num_welded << " border vertices, dropped "
+        << num_faces - num_kept << " collapsed faces.");
+    return buffer;
+}
+
+int initDistributedReconstruction(int& argc, char**& argv)
+{
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
+    if (provided < MPI_THREAD_SERIALIZED)
+    {
+        ROS_WARN_STREAM("The MPI library does not support calls from several threads.");
+    }
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    return rank;
+}
+
+void runTileWorker()
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    while (true)
+    {
+        int command;
+        MPI_Bcast(&command, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        if (command != TILE_RECONSTRUCT)
+        {
+            return;
+        }
+
+        ReconstructionConfig config;
+        broadcastConfig(config, rank);
+        float origin[3];
+        MPI_Bcast(origin, 3, MPI_FLOAT, 0, MPI_COMM_WORLD);
+
+        ReconstructionTile tile;
+        std::vector<float> points, normals, intensities;
+        MPI_Recv(tile.min, 3, MPI_FLOAT, 0, TILE_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Recv(tile.max, 3, MPI_FLOAT, 0, TILE_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        receiveVector(points, 0, TILE_TAG);
+        receiveVector(normals, 0, TILE_TAG);
+        receiveVector(intensities, 0, TILE_TAG);
+
+        ROS_INFO_STREAM("Rank " << rank << " reconstructs a tile of " << points.size() / 3 << " points.");
+        TileMesh mesh;
+        reconstructTileSafely(config, origin, tile, points, normals, intensities, mesh);
+
+        sendVector(mesh.vertices, 0, MESH_TAG);
+        sendVector(mesh.normals, 0, MESH_TAG);
+        sendVector(mesh.intensities, 0, MESH_TAG);
+        sendVector(mesh.faces, 0, MESH_TAG);
+    }
+}
+
+void finishDistributedReconstruction()
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0)
+    {
+        std::lock_guard<std::mutex> lock(mpi_mutex);
+        int command = TILE_STOP;
+        MPI_Bcast(&command, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    }
+    MPI_Finalize();
+}
+
+bool reconstructDistributed(
+    const ReconstructionConfig& config,
+    lvr2::PointBufferPtr& point_buffer,
+    lvr2::MeshBufferPtr& mesh_buffer
+)
+{
+    std::lock_guard<std::mutex> lock(mpi_mutex);
+    int num_ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+    const size_t num_points = point_buffer->numPoints();
+    if (num_ranks == 1 || num_points == 0)
+    {
+        return reconstructMeshBuffer(config, point_buffer, mesh_buffer);
+    }
+
+    const lvr2::floatArr points = point_buffer->getPointArray();
+    float min[3], max[3];
+    std::fill(min, min + 3, std::numeric_limits<float>::max());
+    std::fill(max, max + 3, std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < num_points; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            min[axis] = std::min(min[axis], points[3 * i + axis]);
+            max[axis] = std::max(max[axis], points[3 * i + axis]);
+        }
+    }
+
+    // All tiles use the voxel size of the whole cloud
+    ReconstructionConfig tile_config = config;
+    if (tile_config.targetFaces > 0)
+    {
+        tile_config.voxelsize = voxelsizeForTargetFaces(points.get(), num_points, tile_config.targetFaces);
+        tile_config.intersections = 0;
+        tile_config.targetFaces = 0;
+    }
+    else if (tile_config.intersections > 0)
+    {
+        const float longest_side = std::max({max[0] - min[0], max[1] - min[1], max[2] - min[2]});
+        tile_config.voxelsize = longest_side / tile_config.intersections;
+        tile_config.intersections = 0;
+    }
+    if (tile_config.generateTextures)
+    {
+        ROS_WARN_STREAM("Textures are not supported by the distributed reconstruction.");
+        tile_config.generateTextures = false;
+    }
+
+    // Cleanup and plane optimization move or remove the border vertices of every tile differently, the seams could
+    // not be welded anymore. They run once on the stitched mesh instead.
+    PostProcessGoal optimization;
+    optimization.remove_dangling_clusters = config.rda != 0;
+    optimization.clean_contours = config.cleanContours > 0;
+    optimization.fill_holes = config.fillHoles > 0;
+    optimization.optimize_planes = config.optimizePlanes;
+    tile_config.rda = 0;
+    tile_config.cleanContours = 0;
+    tile_config.fillHoles = 0;
+    tile_config.optimizePlanes = false;
+
+    std::vector<ReconstructionTile> tiles;
+    partitionPoints(points.get(), num_points, num_ranks, config.mpiOverlap, tiles);
+
+    // Clouds with fewer points than ranks leave some ranks without a tile
+    ReconstructionTile empty_tile;
+    std::fill(empty_tile.min, empty_tile.min + 3, 0.0f);
+    std::fill(empty_tile.max, empty_tile.max + 3, 0.0f);
+    tiles.resize(num_ranks, empty_tile);
+
+    const bool send_normals = point_buffer->hasNormals() && !config.recalcNormals;
+    const lvr2::floatArr point_normals = send_normals ? point_buffer->getNormalArray() : lvr2::floatArr();
+    size_t num_intensities;
+    unsigned intensity_width;
+    const lvr2::floatArr point_intensities = point_buffer->getFloatArray(
+        "intensity",
+        num_intensities,
+        intensity_width
+    );
+    const bool send_intensities = point_intensities && intensity_width == 1 && num_intensities == num_points;
+
+    // Gathers the points of a tile from the cloud
+    auto gatherTile = [&](const ReconstructionTile& tile, std::vector<float>& tile_points,
+        std::vector<float>& tile_normals, std::vector<float>& tile_intensities)
+    {
+        for (const uint32_t index : tile.point_indices)
+        {
+            tile_points.insert(tile_points.end(), &points[3 * index], &points[3 * index + 3]);
+            if (send_normals)
+            {
+                tile_normals.insert(tile_normals.end(), &point_normals[3 * index], &point_normals[3 * index + 3]);
+            }
+            if (send_intensities)
+            {
+                tile_intensities.push_back(point_intensities[index]);
+            }
+        }
+    };
+
+    int command = TILE_RECONSTRUCT;
+    MPI_Bcast(&command, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    broadcastConfig(tile_config, 0);
+    MPI_Bcast(min, 3, MPI_FLOAT, 0, MPI_COMM_WORLD);
+
+    for (int rank = 1; rank < num_ranks; rank++)
+    {
+        std::vector<float> tile_points, tile_normals, tile_intensities;
+        gatherTile(tiles[rank], tile_points, tile_normals, tile_intensities);
+        MPI_Send(tiles[rank].min, 3, MPI_FLOAT, rank, TILE_TAG, MPI_COMM_WORLD);
+        MPI_Send(tiles[rank].max, 3, MPI_FLOAT, rank, TILE_TAG, MPI_COMM_WORLD);
+        sendVector(tile_points, rank, TILE_TAG);
+        sendVector(tile_normals, rank, TILE_TAG);
+        sendVector(tile_intensities, rank, TILE_TAG);
+    }
+
+    // Rank 0 reconstructs the first tile while the workers are busy with theirs
+    std::vector<TileMesh> meshes(num_ranks);
+    {
+        std::vector<float> tile_points, tile_normals, tile_intensities;
+        gatherTile(tiles[0], tile_points, tile_normals, tile_intensities);
+        reconstructTileSafely(tile_config, min, tiles[0], tile_points, tile_normals, tile_intensities, meshes[0]);
+    }
+    for (int rank = 1; rank < num_ranks; rank++)
+    {
+        receiveVector(meshes[rank].vertices, rank, MESH_TAG);
+        receiveVector(meshes[rank].normals, rank, MESH_TAG);
+        receiveVector(meshes[rank].intensities, rank, MESH_TAG);
+        receiveVector(meshes[rank].faces, rank, MESH_TAG);
+    }
+
+    // Border vertices of neighboring tiles lie on the same lattice edges and differ only by rounding
+    mesh_buffer = stitchTileMeshes(meshes, tile_config.voxelsize * 1e-3f);
+    if (mesh_buffer->numFaces() == 0)
+    {
+        ROS_ERROR_STREAM("The distributed reconstruction produced no faces!");
+        return false;
+    }
+
+    if (optimization.remove_dangling_clusters || optimization.clean_contours || optimization.fill_holes
+        || optimization.optimize_planes)
+    {
+        return postProcessMeshBuffer(config, optimization, mesh_buffer);
+    }
+    return true;
+}
+
+} // namespace lvr_ros
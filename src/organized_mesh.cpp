@@ -0,0 +1,452 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * organized_mesh.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#include "lvr_ros/organized_mesh.h"
+#include "lvr_ros/trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <ros/console.h>
+
+namespace lvr_ros
+{
+
+/// Offset of the field of the given name, -1 if the cloud has no such field or it has another type
+static int fieldOffset(const sensor_msgs::PointCloud2& cloud, const std::string& name, int datatype = -1)
+{
+    for (const auto& field : cloud.fields)
+    {
+        if (field.name == name && (datatype < 0 || field.datatype == datatype))
+        {
+            return static_cast<int>(field.offset);
+        }
+    }
+    return -1;
+}
+
+/// Bits of the triangles of a cell, see organizedCloudToMeshBuffer: a b on top, c d below
+enum CellTriangle
+{
+    TRIANGLE_ABD = 1,
+    TRIANGLE_ADC = 2,
+    TRIANGLE_ABC = 4,
+    TRIANGLE_BDC = 8
+};
+
+/// Triangles of a cell which contain its corner a, b, c or d
+static const uint8_t CORNER_TRIANGLES[4] = {
+    TRIANGLE_ABD | TRIANGLE_ADC | TRIANGLE_ABC,
+    TRIANGLE_ABD | TRIANGLE_ABC | TRIANGLE_BDC,
+    TRIANGLE_ADC | TRIANGLE_ABC | TRIANGLE_BDC,
+    TRIANGLE_ABD | TRIANGLE_ADC | TRIANGLE_BDC
+};
+
+static inline void cross(const float a[3], const float b[3], float result[3])
+{
+    result[0] = a[1] * b[2] - a[2] * b[1];
+    result[1] = a[2] * b[0] - a[0] * b[2];
+    result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static inline float dot(const float a[3], const float b[3])
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static inline float squaredDistance(const float a[3], const float b[3])
+{
+    const float d[3] = {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+    return dot(d, d);
+}
+
+bool organizedCloudToMeshBuffer(
+    const sensor_msgs::PointCloud2& cloud,
+    lvr2::MeshBuffer& mesh_buffer,
+    float max_depth_jump,
+    int normal_window
+)
+{
+    LVR_ROS_TRACE_SPAN(span, "organized_mesh");
+    LVR_ROS_TRACE_ARG(span, "pixels", cloud.width * cloud.height);
+    const int width = static_cast<int>(cloud.width);
+    const int height = static_cast<int>(cloud.height);
+    const int x_offset = fieldOffset(cloud, "x", sensor_msgs::PointField::FLOAT32);
+    const int y_offset = fieldOffset(cloud, "y", sensor_msgs::PointField::FLOAT32);
+    const int z_offset = fieldOffset(cloud, "z", sensor_msgs::PointField::FLOAT32);
+    if (width < 2 || height < 2)
+    {
+        ROS_ERROR_STREAM("The point cloud is not organized, can not mesh it in image space!");
+        return false;
+    }
+    if (x_offset < 0 || y_offset < 0 || z_offset < 0)
+    {
+        ROS_ERROR_STREAM("The point cloud has no float coordinates, can not mesh it in image space!");
+        return false;
+    }
+    if (cloud.data.size() < static_cast<size_t>(cloud.row_step) * height
+        || cloud.row_step < static_cast<size_t>(cloud.point_step) * width)
+    {
+        ROS_ERROR_STREAM("The point cloud data is smaller than its dimensions!");
+        return false;
+    }
+
+    const size_t num_pixels = static_cast<size_t>(width) * height;
+    auto pixelData = [&](int x, int y)
+    {
+        return cloud.data.data() + static_cast<size_t>(y) * cloud.row_step + static_cast<size_t>(x) * cloud.point_step;
+    };
+
+    // Points and distances of the pixels, the distance is NaN for invalid pixels
+    std::vector<float> points(3 * num_pixels);
+    std::vector<float> ranges(num_pixels);
+    #pragma omp parallel for
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const size_t pixel = static_cast<size_t>(y) * width + x;
+            const uint8_t* data = pixelData(x, y);
+            float* point = &points[3 * pixel];
+            std::memcpy(&point[0], data + x_offset, sizeof(float));
+            std::memcpy(&point[1], data + y_offset, sizeof(float));
+            std::memcpy(&point[2], data + z_offset, sizeof(float));
+            // Depth cameras mark invalid pixels with NaN or with zero depth
+            const float range = std::sqrt(dot(point, point));
+            ranges[pixel] = std::isfinite(range) && range > 0.0f ? range : std::numeric_limits<float>::quiet_NaN();
+        }
+    }
+
+    // Integral images of the valid points and their number, with a zero row and column in front
+    const size_t integral_width = width + 1;
+    std::vector<double> sums(3 * integral_width * (height + 1), 0.0);
+    std::vector<uint32_t> counts(integral_width * (height + 1), 0);
+    #pragma omp parallel for
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const size_t pixel = static_cast<size_t>(y) * width + x;
+            const size_t cell = (y + 1) * integral_width + x + 1;
+            const bool valid = !std::isnan(ranges[pixel]);
+            for (int k = 0; k < 3; k++)
+            {
+                sums[3 * cell + k] = sums[3 * (cell - 1) + k] + (valid ? points[3 * pixel + k] : 0.0);
+            }
+            counts[cell] = counts[cell - 1] + (valid ? 1 : 0);
+        }
+    }
+    #pragma omp parallel for
+    for (int x = 1; x <= width; x++)
+    {
+        for (int y = 1; y <= height; y++)
+        {
+            const size_t cell = y * integral_width + x;
+            const size_t above = cell - integral_width;
+            for (int k = 0; k < 3; k++)
+            {
+                sums[3 * cell + k] += sums[3 * above + k];
+            }
+            counts[cell] += counts[above];
+        }
+    }
+
+    // Mean of the valid points in the window of pixels from (x0, y0) to (x1, y1), clipped to the image
+    auto windowMean = [&](int x0, int y0, int x1, int y1, float mean[3])
+    {
+        x0 = std::max(x0, 0);
+        y0 = std::max(y0, 0);
+        x1 = std::min(x1, width - 1) + 1;
+        y1 = std::min(y1, height - 1) + 1;
+        if (x0 >= x1 || y0 >= y1)
+        {
+            return false;
+        }
+        const size_t c00 = y0 * integral_width + x0, c01 = y0 * integral_width + x1;
+        const size_t c10 = y1 * integral_width + x0, c11 = y1 * integral_width + x1;
+        const uint32_t count = counts[c11] - counts[c10] - counts[c01] + counts[c00];
+        if (count == 0)
+        {
+            return false;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            mean[k] = static_cast<float>(
+                (sums[3 * c11 + k] - sums[3 * c10 + k] - sums[3 * c01 + k] + sums[3 * c00 + k]) / count
+            );
+        }
+        return true;
+    };
+
+    /*
+     * Mean point of a window on one side of a pixel. A window across a depth discontinuity is replaced by the
+     * neighbor pixel on that side, or by the pixel itself if the neighbor is not connected either.
+     */
+    const int r = std::max(normal_window, 1);
+    const float max_window_jump = max_depth_jump * (r + 1) * 0.5f;
+    auto sideMean = [&](const float* point, size_t pixel, int x0, int y0, int x1, int y1, int nx, int ny,
+        float mean[3])
+    {
+        const float range = ranges[pixel];
+        if (windowMean(x0, y0, x1, y1, mean)
+            && std::fabs(std::sqrt(dot(mean, mean)) - range) <= max_window_jump * range)
+        {
+            return;
+        }
+        const size_t neighbor = static_cast<size_t>(ny) * width + nx;
+        const bool inside = nx >= 0 && ny >= 0 && nx < width && ny < height;
+        if (inside && std::fabs(ranges[neighbor] - range) <= max_depth_jump * std::min(ranges[neighbor], range))
+        {
+            std::copy(&points[3 * neighbor], &points[3 * neighbor] + 3, mean);
+            return;
+        }
+        std::copy(point, point + 3, mean);
+    };
+
+    // Normals from the mean points on both sides of every pixel, oriented towards the sensor
+    std::vector<float> normals(3 * num_pixels);
+    #pragma omp parallel for
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const size_t pixel = static_cast<size_t>(y) * width + x;
+            if (std::isnan(ranges[pixel]))
+            {
+                continue;
+            }
+            const float* point = &points[3 * pixel];
+            float left[3], right[3], above[3], below[3];
+            sideMean(point, pixel, x - r, y - r, x - 1, y + r, x - 1, y, left);
+            sideMean(point, pixel, x + 1, y - r, x + r, y + r, x + 1, y, right);
+            sideMean(point, pixel, x - r, y - r, x + r, y - 1, x, y - 1, above);
+            sideMean(point, pixel, x - r, y + 1, x + r, y + r, x, y + 1, below);
+
+            const float horizontal[3] = {right[0] - left[0], right[1] - left[1], right[2] - left[2]};
+            const float vertical[3] = {below[0] - above[0], below[1] - above[1], below[2] - above[2]};
+            float* normal = &normals[3 * pixel];
+            cross(horizontal, vertical, normal);
+            float length = std::sqrt(dot(normal, normal));
+            if (length == 0.0f)
+            {
+                // Without neighbors, the pixel faces the sensor
+                std::transform(point, point + 3, normal, [](float value) { return -value; });
+                length = std::max(ranges[pixel], std::numeric_limits<float>::min());
+            }
+            const float scale = (dot(normal, point) > 0.0f ? -1.0f : 1.0f) / length;
+            std::transform(normal, normal + 3, normal, [scale](float value) { return value * scale; });
+        }
+    }
+
+    // Triangles of every cell of 2 x 2 pixels
+    const int cells_width = width - 1;
+    const int cells_height = height - 1;
+    std::vector<uint8_t> cells(static_cast<size_t>(cells_width) * cells_height);
+    auto connected = [&](size_t a, size_t b)
+    {
+        // Comparisons with NaN are false, so invalid pixels are never connected
+        return std::fabs(ranges[a] - ranges[b]) <= max_depth_jump * std::min(ranges[a], ranges[b]);
+    };
+    #pragma omp parallel for
+    for (int y = 0; y < cells_height; y++)
+    {
+        for (int x = 0; x < cells_width; x++)
+        {
+            const size_t a = static_cast<size_t>(y) * width + x;
+            const size_t b = a + 1;
+            const size_t c = a + width;
+            const size_t d = c + 1;
+            const bool ab = connected(a, b), ac = connected(a, c), ad = connected(a, d);
+            const bool bc = connected(b, c), bd = connected(b, d), cd = connected(c, d);
+            const int split_ad = (ab && bd && ad) + (ad && cd && ac);
+            const int split_bc = (ab && bc && ac) + (bd && cd && bc);
+
+            uint8_t triangles = 0;
+            if (split_ad > split_bc || (split_ad == split_bc && split_ad > 0
+                && squaredDistance(&points[3 * a], &points[3 * d]) <= squaredDistance(&points[3 * b], &points[3 * c])))
+            {
+                triangles |= ab && bd && ad ? TRIANGLE_ABD : 0;
+                triangles |= ad && cd && ac ? TRIANGLE_ADC : 0;
+            }
+            else
+            {
+                triangles |= ab && bc && ac ? TRIANGLE_ABC : 0;
+                triangles |= bd && cd && bc ? TRIANGLE_BDC : 0;
+            }
+            cells[static_cast<size_t>(y) * cells_width + x] = triangles;
+        }
+    }
+
+    // Vertex indices of the pixels which belong to a face, counted per row first
+    std::vector<uint32_t> vertex_indices(num_pixels);
+    std::vector<size_t> row_vertices(height + 1, 0);
+    std::vector<size_t> row_faces(cells_height + 1, 0);
+    auto cellTriangles = [&](int x, int y)
+    {
+        return x >= 0 && y >= 0 && x < cells_width && y < cells_height
+            ? cells[static_cast<size_t>(y) * cells_width + x] : 0;
+    };
+    #pragma omp parallel for
+    for (int y = 0; y < height; y++)
+    {
+        size_t num_used = 0;
+        size_t num_faces = 0;
+        for (int x = 0; x < width; x++)
+        {
+            // The pixel is corner a, b, c and d of the cells around it
+            const bool used = (cellTriangles(x, y) & CORNER_TRIANGLES[0])
+                || (cellTriangles(x - 1, y) & CORNER_TRIANGLES[1])
+                || (cellTriangles(x, y - 1) & CORNER_TRIANGLES[2])
+                || (cellTriangles(x - 1, y - 1) & CORNER_TRIANGLES[3]);
+            vertex_indices[static_cast<size_t>(y) * width + x] = used ? 1 : 0;
+            num_used += used ? 1 : 0;
+            const uint8_t triangles = cellTriangles(x, y);
+            num_faces += (triangles & 1) + ((triangles >> 1) & 1) + ((triangles >> 2) & 1) + ((triangles >> 3) & 1);
+        }
+        row_vertices[y + 1] = num_used;
+        if (y < cells_height)
+        {
+            row_faces[y + 1] = num_faces;
+        }
+    }
+    for (int y = 0; y < height; y++)
+    {
+        row_vertices[y + 1] += row_vertices[y];
+    }
+    for (int y = 0; y < cells_height; y++)
+    {
+        row_faces[y + 1] += row_faces[y];
+    }
+    const size_t num_vertices = row_vertices[height];
+    const size_t num_faces = row_faces[cells_height];
+    if (num_faces == 0)
+    {
+        ROS_WARN_STREAM("The organized point cloud has no connected pixels.");
+        return false;
+    }
+
+    // Optional point attributes, the byte order of the colors is the one of fromPointCloud2ToPointBuffer
+    const int rgb_offset = fieldOffset(cloud, "rgb");
+    const int intensity_offset = fieldOffset(cloud, "intensities", sensor_msgs::PointField::FLOAT32);
+
+    lvr2::floatArr vertices(new float[3 * num_vertices]);
+    lvr2::floatArr vertex_normals(new float[3 * num_vertices]);
+    lvr2::ucharArr colors(rgb_offset >= 0 ? new unsigned char[3 * num_vertices] : nullptr);
+    lvr2::floatArr intensities(intensity_offset >= 0 ? new float[num_vertices] : nullptr);
+    #pragma omp parallel for
+    for (int y = 0; y < height; y++)
+    {
+        size_t index = row_vertices[y];
+        for (int x = 0; x < width; x++)
+        {
+            const size_t pixel = static_cast<size_t>(y) * width + x;
+            if (!vertex_indices[pixel])
+            {
+                continue;
+            }
+            vertex_indices[pixel] = static_cast<uint32_t>(index);
+            std::copy(&points[3 * pixel], &points[3 * pixel] + 3, &vertices[3 * index]);
+            std::copy(&normals[3 * pixel], &normals[3 * pixel] + 3, &vertex_normals[3 * index]);
+            if (colors)
+            {
+                std::copy(pixelData(x, y) + rgb_offset, pixelData(x, y) + rgb_offset + 3, &colors[3 * index]);
+            }
+            if (intensities)
+            {
+                std::memcpy(&intensities[index], pixelData(x, y) + intensity_offset, sizeof(float));
+            }
+            index++;
+        }
+    }
+
+    // Faces of every row of cells, wound so that they face the sensor like the normals
+    lvr2::indexArray faces(new unsigned int[3 * num_faces]);
+    #pragma omp parallel for
+    for (int y = 0; y < cells_height; y++)
+    {
+        unsigned int* face = &faces[3 * row_faces[y]];
+        auto addFace = [&](size_t p, size_t q, size_t s)
+        {
+            float pq[3], ps[3], normal[3];
+            for (int k = 0; k < 3; k++)
+            {
+                pq[k] = points[3 * q + k] - points[3 * p + k];
+                ps[k] = points[3 * s + k] - points[3 * p + k];
+            }
+            cross(pq, ps, normal);
+            if (dot(normal, &points[3 * p]) > 0.0f)
+            {
+                std::swap(q, s);
+            }
+            face[0] = vertex_indices[p];
+            face[1] = vertex_indices[q];
+            face[2] = vertex_indices[s];
+            face += 3;
+        };
+        for (int x = 0; x < cells_width; x++)
+        {
+            const uint8_t triangles = cells[static_cast<size_t>(y) * cells_width + x];
+            const size_t a = static_cast<size_t>(y) * width + x;
+            const size_t b = a + 1;
+            const size_t c = a + width;
+            const size_t d = c + 1;
+            if (triangles & TRIANGLE_ABD)
+            {
+                addFace(a, b, d);
+            }
+            if (triangles & TRIANGLE_ADC)
+            {
+                addFace(a, d, c);
+            }
+            if (triangles & TRIANGLE_ABC)
+            {
+                addFace(a, b, c);
+            }
+            if (triangles & TRIANGLE_BDC)
+            {
+                addFace(b, d, c);
+            }
+        }
+    }
+
+    mesh_buffer.setVertices(vertices, num_vertices);
+    mesh_buffer.setVertexNormals(vertex_normals);
+    mesh_buffer.setFaceIndices(faces, num_faces);
+    if (colors)
+    {
+        mesh_buffer.setVertexColors(colors);
+    }
+    if (intensities)
+    {
+        mesh_buffer.addFloatChannel(intensities, "intensity", num_vertices, 1);
+    }
+    LVR_ROS_TRACE_ARG(span, "faces", num_faces);
+    return true;
+}
+
+} // namespace lvr_ros
@@ -22,8 +22,13 @@
  *
  */
 
+#include <algorithm>
+#include <cmath>
+#include <future>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <vector>
 
 using std::make_shared;
 using std::move;
@@ -32,9 +37,20 @@ using std::move;
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
+#include <boost/make_shared.hpp>
 
 #include "lvr_ros/reconstruction.h"
 #include "lvr_ros/conversions.h"
+#include "lvr_ros/mesh_tiles.h"
+#ifdef LVR_ROS_MPI
+#include "lvr_ros/mpi_reconstruction.h"
+#endif
+#include "lvr_ros/organized_mesh.h"
+#include "lvr_ros/reconstruction_pipeline.h"
+#include "lvr_ros/textures.h"
+#include "lvr_ros/trace.h"
+#include "lvr_ros/vertex_costs.h"
+#include "lvr_ros/voxel_occupancy.h"
 
 #include <lvr2/io/PLYIO.hpp>
 #include <lvr2/config/lvropenmp.hpp>
@@ -51,6 +67,7 @@ using std::move;
 #include <lvr2/algorithm/CleanupAlgorithms.hpp>
 #include <lvr2/algorithm/ClusterAlgorithms.hpp>
 #include <lvr2/algorithm/ClusterPainter.hpp>
+#include <lvr2/algorithm/ReductionAlgorithms.hpp>
 #include <lvr2/geometry/Handles.hpp>
 #include <lvr2/util/ClusterBiMap.hpp>
 
@@ -66,30 +83,51 @@ using std::move;
 #include <lvr2/util/Factories.hpp>
 #include <lvr2/util/Panic.hpp>
 
-#if defined CUDA_FOUND
-    #define GPU_FOUND
-
-    #include <lvr2/reconstruction/cuda/CudaSurface.hpp>
-    typedef lvr2::CudaSurface GpuSurface;
-#elif defined OPENCL_FOUND
-    #define GPU_FOUND
-
-    #include <lvr2/reconstruction/opencl/ClSurface.hpp>
-    typedef lvr2::ClSurface GpuSurface;
-#endif
-
 namespace lvr_ros
 {
 
 /**********************************************************************************************************************/
 // Constructor
 
+/// A node handle which puts its callbacks into the given queue
+static ros::NodeHandle createNodeHandle(const std::string& ns, ros::CallbackQueue* queue)
+{
+    ros::NodeHandle node_handle(ns);
+    node_handle.setCallbackQueue(queue);
+    return node_handle;
+}
+
 Reconstruction::Reconstruction()
-    : as_(node_handle, "reconstruction", boost::bind(&Reconstruction::reconstruct, this, _1), false)
+    : service_node_handle(createNodeHandle("", &service_queue)),
+      reconstruction_node_handle(createNodeHandle("", &reconstruction_queue)),
+      as_(
+          reconstruction_node_handle,
+          "reconstruction",
+          boost::bind(&Reconstruction::reconstruct, this, _1),
+          false
+      ),
+      as_batch_(
+          reconstruction_node_handle,
+          "reconstruct_batch",
+          boost::bind(&Reconstruction::reconstructBatch, this, _1),
+          false
+      ),
+      as_post_process_(
+          reconstruction_node_handle,
+          "post_process",
+          boost::bind(&Reconstruction::postProcess, this, _1),
+          false
+      )
 {
     ros::NodeHandle nh("~");
 
-    cloud_subscriber = node_handle.subscribe(
+    // Read first, the action servers may reconstruct as soon as they are started
+    int service_threads, reconstruction_threads;
+    nh.param<int>("serviceThreads", service_threads, 2);
+    nh.param<int>("reconstructionThreads", reconstruction_threads, 2);
+    free_reconstruction_slots = std::max(reconstruction_threads, 1);
+
+    cloud_subscriber = reconstruction_node_handle.subscribe(
         "/pointcloud",
         1,
         &Reconstruction::pointCloudCallback,
@@ -97,26 +135,138 @@ Reconstruction::Reconstruction()
     );
     mesh_publisher = node_handle.advertise<mesh_msgs::TriangleMeshStamped>("/mesh", 1);
     mesh_geometry_publisher = node_handle.advertise<mesh_msgs::MeshGeometryStamped>("/mesh_geometry", 1);
+    mesh_geometry_delta_publisher = node_handle.advertise<lvr_ros::MeshGeometryDelta>(
+        "/mesh_geometry_delta",
+        10,
+        boost::bind(&Reconstruction::deltaSubscriberConnected, this, _1)
+    );
+    mesh_geometry_compact_publisher = node_handle.advertise<lvr_ros::CompactMeshGeometry>(
+        "/mesh_geometry_compact",
+        1
+    );
+    mesh_vertex_costs_publisher = node_handle.advertise<mesh_msgs::MeshVertexCostsStamped>("/mesh_vertex_costs", 4);
 
-    // Setup dynamic reconfigure
-    reconfigure_server_ptr = DynReconfigureServerPtr(new DynReconfigureServer(nh));
+    // Setup dynamic reconfigure, its requests are served with the services
+    reconfigure_server_ptr = DynReconfigureServerPtr(
+        new DynReconfigureServer(createNodeHandle(nh.getNamespace(), &service_queue))
+    );
     callback_type = boost::bind(&Reconstruction::reconfigureCallback, this, _1, _2);
     reconfigure_server_ptr->setCallback(callback_type);
 
-    // Start action server
+    // Start action servers
     as_.start();
+    as_batch_.start();
+    as_post_process_.start();
 
     // Start services
-    srv_get_geometry_ = node_handle.advertiseService("get_geometry", &Reconstruction::service_getGeometry, this);
-    srv_get_materials_ = node_handle.advertiseService("get_materials", &Reconstruction::service_getMaterials, this);
-    srv_get_texture_ = node_handle.advertiseService("get_texture", &Reconstruction::service_getTexture, this);
-    srv_get_uuid_ = node_handle.advertiseService("get_uuid", &Reconstruction::service_getUUID, this);
-    srv_get_vertex_colors_ = node_handle.advertiseService(
+    srv_get_geometry_ = service_node_handle.advertiseService(
+        "get_geometry",
+        &Reconstruction::service_getGeometry,
+        this
+    );
+    srv_get_compact_geometry_ = service_node_handle.advertiseService(
+        "get_compact_geometry",
+        &Reconstruction::service_getCompactGeometry,
+        this
+    );
+    srv_get_geometry_tiles_ = service_node_handle.advertiseService(
+        "get_geometry_tiles",
+        &Reconstruction::service_getGeometryTiles,
+        this
+    );
+    srv_get_closest_faces_ = service_node_handle.advertiseService(
+        "get_closest_faces",
+        &Reconstruction::service_getClosestFaces,
+        this
+    );
+    srv_get_ray_intersections_ = service_node_handle.advertiseService(
+        "get_ray_intersections",
+        &Reconstruction::service_getRayIntersections,
+        this
+    );
+    srv_get_faces_in_box_ = service_node_handle.advertiseService(
+        "get_faces_in_box",
+        &Reconstruction::service_getFacesInBox,
+        this
+    );
+    srv_get_materials_ = service_node_handle.advertiseService(
+        "get_materials",
+        &Reconstruction::service_getMaterials,
+        this
+    );
+    srv_get_texture_ = service_node_handle.advertiseService("get_texture", &Reconstruction::service_getTexture, this);
+    srv_get_compressed_texture_ = service_node_handle.advertiseService(
+        "get_compressed_texture",
+        &Reconstruction::service_getCompressedTexture,
+        this
+    );
+    srv_get_texture_level_ = service_node_handle.advertiseService(
+        "get_texture_level",
+        &Reconstruction::service_getTextureLevel,
+        this
+    );
+    srv_get_uuid_ = service_node_handle.advertiseService("get_uuid", &Reconstruction::service_getUUID, this);
+    srv_get_vertex_colors_ = service_node_handle.advertiseService(
         "get_vertex_colors",
         &Reconstruction::service_getVertexColors,
         this
     );
+    srv_get_vertex_costs_ = service_node_handle.advertiseService(
+        "get_vertex_costs",
+        &Reconstruction::service_getVertexCosts,
+        this
+    );
+
+    // Setup the persistent result store
+    std::string store_directory;
+    int store_compression, store_max_loaded, store_max_pending, store_max_meshes;
+    nh.param<std::string>("storeDirectory", store_directory, "");
+    nh.param<int>("storeCompression", store_compression, 4);
+    nh.param<int>("storeMaxLoaded", store_max_loaded, 4);
+    nh.param<int>("storeMaxPending", store_max_pending, 8);
+    nh.param<int>("storeMaxMeshes", store_max_meshes, 1000);
+    if (!store_directory.empty())
+    {
+        ROS_INFO_STREAM("Store finished meshes in \"" << store_directory << "\".");
+        mesh_store = boost::make_shared<MeshStore>(
+            store_directory,
+            store_compression,
+            static_cast<size_t>(std::max(store_max_loaded, 0)),
+            static_cast<size_t>(std::max(store_max_pending, 1)),
+            static_cast<size_t>(std::max(store_max_meshes, 0))
+        );
+    }
+
+    // Start serving the callback queues, the global queue is spun by main
+    service_spinner.reset(new ros::AsyncSpinner(std::max(service_threads, 1), &service_queue));
+    reconstruction_spinner.reset(new ros::AsyncSpinner(std::max(reconstruction_threads, 1), &reconstruction_queue));
+    service_spinner->start();
+    reconstruction_spinner->start();
+}
+
+Reconstruction::ReconstructionSlot::ReconstructionSlot(Reconstruction& node)
+    : node(node)
+{
+    LVR_ROS_TRACE_SPAN(span, "wait_for_reconstruction_slot");
+    std::unique_lock<std::mutex> lock(node.slot_mutex);
+    node.slot_condition.wait(lock, [&node]{ return node.free_reconstruction_slots > 0; });
+    node.free_reconstruction_slots--;
+}
+
+Reconstruction::ReconstructionSlot::~ReconstructionSlot()
+{
+    {
+        std::lock_guard<std::mutex> lock(node.slot_mutex);
+        node.free_reconstruction_slots++;
+    }
+    node.slot_condition.notify_one();
+}
 
+Reconstruction::~Reconstruction()
+{
+    // No callback may run while the members are destroyed
+    reconstruction_spinner->stop();
+    service_spinner->stop();
 }
 
 /**********************************************************************************************************************/
@@ -125,12 +275,35 @@ Reconstruction::Reconstruction()
 void Reconstruction::reconstruct(const lvr_ros::ReconstructGoalConstPtr& goal)
 {
     ROS_INFO("Action: Reconstruct");
+    LVR_ROS_TRACE_SPAN(span, "reconstruct");
+    LVR_ROS_TRACE_ARG(span, "points", goal->cloud.width * goal->cloud.height);
     try
     {
+        const ros::WallTime start = ros::WallTime::now();
+        double time_budget = currentConfig().timeBudget;
+        if (!goal->deadline.isZero())
+        {
+            // The budget is spent in wall time, also under simulated time. A missed deadline still gets the fastest
+            // reconstruction
+            const ros::WallTime deadline(goal->deadline.sec, goal->deadline.nsec);
+            time_budget = std::max((deadline - ros::WallTime::now()).toSec(), 1e-6);
+        }
+
         lvr_ros::ReconstructResult result;
         mesh_msgs::TriangleMeshStamped mesh; // deprecated
-        createMeshMessageFromPointCloud(goal->cloud, mesh);
-        result.mesh = cache_mesh_geometry_stamped;
+        MeshCacheEntryConstPtr entry;
+        ReconstructionBudgetChoice choice;
+        if (!createMeshMessageFromPointCloud(goal->cloud, mesh, entry, time_budget, &choice))
+        {
+            as_.setAborted(result, "Reconstruction failed.");
+            return;
+        }
+        LVR_ROS_TRACE_ARG(span, "uuid", entry->uuid);
+        result.mesh = entry->mesh_geometry_stamped;
+        result.voxelsize = choice.voxelsize;
+        result.num_points = static_cast<uint32_t>(choice.num_points);
+        result.estimated_time = choice.estimated_time;
+        result.time = (ros::WallTime::now() - start).toSec();
         as_.setSucceeded(result, "Published mesh.");
     }
     catch(std::exception& e)
@@ -140,17 +313,370 @@ void Reconstruction::reconstruct(const lvr_ros::ReconstructGoalConstPtr& goal)
     }
 }
 
+void Reconstruction::reconstructBatch(const lvr_ros::ReconstructBatchGoalConstPtr& goal)
+{
+    const size_t num_clouds = goal->clouds.size();
+    ROS_INFO_STREAM("Action: Reconstruct batch of " << num_clouds << " clouds");
+    LVR_ROS_TRACE_SPAN(span, "reconstruct_batch");
+    LVR_ROS_TRACE_ARG(span, "clouds", num_clouds);
+
+    lvr_ros::ReconstructBatchResult result;
+    lvr_ros::ReconstructBatchFeedback feedback;
+    result.uuids.resize(num_clouds);
+    size_t num_reconstructed = 0;
+
+    // Decompresses and converts a cloud of the batch, returns a null pointer on failure
+    auto convert = [&goal](size_t index)
+    {
+        LVR_ROS_TRACE_SPAN(convert_span, "convert_point_cloud");
+        PointBufferPtr point_buffer(new PointBuffer);
+        sensor_msgs::PointCloud2 cloud;
+        if (!fromCompressedPointCloudToPointCloud2(goal->clouds[index], cloud)
+            || !fromPointCloud2ToPointBuffer(cloud, *point_buffer))
+        {
+            ROS_ERROR_STREAM("Could not convert cloud " << index << " of the batch!");
+            point_buffer.reset();
+        }
+        return point_buffer;
+    };
+
+    // Caches and publishes a mesh, returns a null pointer on failure
+    auto cache = [this](lvr2::MeshBufferPtr mesh_buffer, std::string uuid, std_msgs::Header header)
+    {
+        MeshCacheEntryConstPtr entry = cacheMeshBuffer(mesh_buffer, uuid, header);
+        if (entry)
+        {
+            mesh_geometry_publisher.publish(entry->mesh_geometry_stamped);
+            publishMeshDelta(entry->mesh_geometry_stamped);
+        }
+        return entry;
+    };
+
+    auto publishFeedback = [&](size_t index, const std::string& uuid)
+    {
+        result.uuids[index] = uuid;
+        num_reconstructed += uuid.empty() ? 0 : 1;
+        feedback.completed++;
+        feedback.uuid = uuid;
+        as_batch_.publishFeedback(feedback);
+    };
+
+    try
+    {
+        std::future<PointBufferPtr> next_cloud;
+        std::future<MeshCacheEntryConstPtr> previous_mesh;
+        size_t previous_index = 0;
+        if (num_clouds > 0)
+        {
+            next_cloud = std::async(std::launch::async, convert, 0);
+        }
+
+        for (size_t i = 0; i < num_clouds; i++)
+        {
+            PointBufferPtr point_buffer = next_cloud.get();
+            if (as_batch_.isPreemptRequested() || !ros::ok())
+            {
+                break;
+            }
+            if (i + 1 < num_clouds)
+            {
+                next_cloud = std::async(std::launch::async, convert, i + 1);
+            }
+
+            lvr2::MeshBufferPtr mesh_buffer(new lvr2::MeshBuffer);
+            bool reconstructed = false;
+            if (point_buffer)
+            {
+                ReconstructionSlot slot(*this);
+                reconstructed = createMeshBufferFromPointBuffer(currentConfig(), point_buffer, mesh_buffer);
+            }
+
+            // The previous mesh is cached first, so that the cache holds the last mesh of the batch in the end
+            if (previous_mesh.valid())
+            {
+                MeshCacheEntryConstPtr entry = previous_mesh.get();
+                publishFeedback(previous_index, entry ? entry->uuid : std::string());
+            }
+            if (!reconstructed)
+            {
+                ROS_ERROR_STREAM("Reconstruction of cloud " << i << " of the batch failed!");
+                publishFeedback(i, std::string());
+                continue;
+            }
+
+            boost::uuids::uuid boost_uuid = boost::uuids::random_generator()();
+            std::string uuid = boost::lexical_cast<std::string>(boost_uuid);
+            previous_mesh = std::async(std::launch::async, cache, mesh_buffer, uuid, goal->clouds[i].header);
+            previous_index = i;
+        }
+
+        if (previous_mesh.valid())
+        {
+            MeshCacheEntryConstPtr entry = previous_mesh.get();
+            publishFeedback(previous_index, entry ? entry->uuid : std::string());
+        }
+    }
+    catch(std::exception& e)
+    {
+        ROS_ERROR_STREAM("Error: " << e.what());
+        as_batch_.setAborted(result);
+        return;
+    }
+
+    LVR_ROS_TRACE_ARG(span, "reconstructed", num_reconstructed);
+    if (feedback.completed < num_clouds)
+    {
+        as_batch_.setPreempted(result, "Batch reconstruction preempted.");
+    }
+    else if (num_reconstructed == 0 && num_clouds > 0)
+    {
+        as_batch_.setAborted(result, "Batch reconstruction failed.");
+    }
+    else
+    {
+        as_batch_.setSucceeded(result, "Published meshes.");
+    }
+}
+
+void Reconstruction::postProcess(const lvr_ros::PostProcessGoalConstPtr& goal)
+{
+    ROS_INFO("Action: Post Process");
+    LVR_ROS_TRACE_SPAN(span, "post_process");
+    LVR_ROS_TRACE_ARG(span, "source_uuid", goal->mesh.uuid);
+    LVR_ROS_TRACE_ARG(span, "vertices", goal->mesh.mesh_geometry.vertices.size());
+    try
+    {
+        lvr_ros::PostProcessResult result;
+        ros::WallTime start = ros::WallTime::now();
+
+        lvr2::MeshBufferPtr mesh_buffer(new lvr2::MeshBuffer);
+        if (!fromMeshGeometryToMeshBuffer(goal->mesh.mesh_geometry, mesh_buffer))
+        {
+            as_post_process_.setAborted(result, "Could not convert the mesh geometry.");
+            return;
+        }
+
+        // The conversion copies the faces as they are, the goal comes from outside
+        const size_t num_vertices = goal->mesh.mesh_geometry.vertices.size();
+        for (const auto& face : goal->mesh.mesh_geometry.faces)
+        {
+            if (face.vertex_indices[0] >= num_vertices || face.vertex_indices[1] >= num_vertices
+                || face.vertex_indices[2] >= num_vertices)
+            {
+                as_post_process_.setAborted(result, "The mesh geometry has invalid vertex indices.");
+                return;
+            }
+        }
+
+        // Meshes from other sources often duplicate the vertices of adjacent faces
+        const size_t num_removed = removeDuplicates(*mesh_buffer);
+        if (num_removed > 0)
+        {
+            ROS_INFO_STREAM("Welded " << num_removed << " duplicate vertices.");
+        }
+
+        bool processed;
+        {
+            ReconstructionSlot slot(*this);
+            processed = postProcessMeshBuffer(currentConfig(), *goal, mesh_buffer);
+        }
+        if (!processed)
+        {
+            as_post_process_.setAborted(result, "Post processing failed.");
+            return;
+        }
+
+        boost::uuids::uuid boost_uuid = boost::uuids::random_generator()();
+        std::string uuid = boost::lexical_cast<std::string>(boost_uuid);
+        MeshCacheEntryConstPtr entry = cacheMeshBuffer(mesh_buffer, uuid, goal->mesh.header);
+        if (!entry)
+        {
+            as_post_process_.setAborted(result, "Post processing failed.");
+            return;
+        }
+
+        LVR_ROS_TRACE_ARG(span, "uuid", uuid);
+        ROS_INFO_STREAM("Post processed mesh " << goal->mesh.uuid << " to " << uuid << " in "
+            << (ros::WallTime::now() - start).toSec() << "s.");
+        result.mesh = entry->mesh_geometry_stamped;
+        as_post_process_.setSucceeded(result, "Post processed mesh.");
+    }
+    catch(std::exception& e)
+    {
+        ROS_ERROR_STREAM("Error: " << e.what());
+        as_post_process_.setAborted();
+    }
+}
+
 bool Reconstruction::service_getGeometry(
     mesh_msgs::GetGeometry::Request& req,
     mesh_msgs::GetGeometry::Response& res
 )
 {
     ROS_INFO("Service: Get Geometry");
-    if (!cache_initialized || req.uuid != cache_uuid)
+    LVR_ROS_TRACE_SPAN(span, "get_geometry");
+    LVR_ROS_TRACE_ARG(span, "uuid", req.uuid);
+    MeshCacheEntryConstPtr entry = findCacheEntry(req.uuid);
+    if (!entry)
     {
         return false;
     }
-    res.mesh_geometry_stamped = cache_mesh_geometry_stamped;
+    res.mesh_geometry_stamped = entry->mesh_geometry_stamped;
+    return true;
+}
+
+bool Reconstruction::service_getCompactGeometry(
+    lvr_ros::GetCompactGeometry::Request& req,
+    lvr_ros::GetCompactGeometry::Response& res
+)
+{
+    const ReconstructionConfig config = currentConfig();
+    ROS_INFO("Service: Get Compact Geometry");
+    LVR_ROS_TRACE_SPAN(span, "get_compact_geometry");
+    LVR_ROS_TRACE_ARG(span, "uuid", req.uuid);
+    MeshCacheEntryConstPtr entry = findCacheEntry(req.uuid);
+    if (!entry)
+    {
+        return false;
+    }
+    return fromMeshGeometryToCompactMeshGeometry(
+        entry->mesh_geometry_stamped,
+        res.compact_mesh_geometry,
+        config.compactPositionBits,
+        config.compactNormalBits,
+        config.compactCompressionLevel
+    );
+}
+
+bool Reconstruction::service_getGeometryTiles(
+    lvr_ros::GetGeometryTiles::Request& req,
+    lvr_ros::GetGeometryTiles::Response& res
+)
+{
+    const ReconstructionConfig config = currentConfig();
+    ROS_INFO("Service: Get Geometry Tiles");
+    LVR_ROS_TRACE_SPAN(span, "get_geometry_tiles");
+    LVR_ROS_TRACE_ARG(span, "uuid", req.uuid);
+    MeshCacheEntryConstPtr entry = findCacheEntry(req.uuid);
+    if (!entry)
+    {
+        return false;
+    }
+
+    const std::vector<MeshGeometryTile>& tiles = entry->geometryTiles(config.tileSize);
+    std::vector<size_t> selected = selectMeshTiles(tiles, req.roi_min, req.roi_max);
+
+    res.header = entry->mesh_geometry_stamped.header;
+    res.uuid = entry->uuid;
+    res.num_tiles = selected.size();
+
+    size_t end = selected.size();
+    if (req.max_tiles > 0)
+    {
+        end = std::min<size_t>(end, static_cast<size_t>(req.offset) + req.max_tiles);
+    }
+    for (size_t i = req.offset; i < end; i++)
+    {
+        const MeshGeometryTile& tile = tiles[selected[i]];
+        if (req.bounds_only)
+        {
+            MeshGeometryTile bounds;
+            bounds.tile_index = tile.tile_index;
+            bounds.bbox_min = tile.bbox_min;
+            bounds.bbox_max = tile.bbox_max;
+            res.tiles.push_back(bounds);
+        }
+        else
+        {
+            res.tiles.push_back(tile);
+        }
+    }
+    return true;
+}
+
+bool Reconstruction::service_getClosestFaces(
+    lvr_ros::GetClosestFaces::Request& req,
+    lvr_ros::GetClosestFaces::Response& res
+)
+{
+    LVR_ROS_TRACE_SPAN(span, "get_closest_faces");
+    LVR_ROS_TRACE_ARG(span, "uuid", req.uuid);
+    LVR_ROS_TRACE_ARG(span, "queries", req.points.size());
+    MeshCacheEntryConstPtr entry = findCacheEntry(req.uuid);
+    if (!entry)
+    {
+        return false;
+    }
+    const MeshBvh& bvh = entry->bvh();
+
+    const size_t num_queries = req.points.size();
+    res.face_indices.resize(num_queries);
+    res.closest_points.resize(num_queries);
+    res.distances.resize(num_queries);
+    #pragma omp parallel for if(num_queries > 64)
+    for (size_t i = 0; i < num_queries; i++)
+    {
+        uint32_t face;
+        if (bvh.closestPoint(req.points[i], req.max_distance, face, res.closest_points[i], res.distances[i]))
+        {
+            res.face_indices[i] = static_cast<int32_t>(face);
+        }
+        else
+        {
+            res.face_indices[i] = -1;
+        }
+    }
+    return true;
+}
+
+bool Reconstruction::service_getRayIntersections(
+    lvr_ros::GetRayIntersections::Request& req,
+    lvr_ros::GetRayIntersections::Response& res
+)
+{
+    LVR_ROS_TRACE_SPAN(span, "get_ray_intersections");
+    LVR_ROS_TRACE_ARG(span, "uuid", req.uuid);
+    LVR_ROS_TRACE_ARG(span, "queries", req.origins.size());
+    MeshCacheEntryConstPtr entry = findCacheEntry(req.uuid);
+    if (!entry || req.origins.size() != req.directions.size())
+    {
+        return false;
+    }
+    const MeshBvh& bvh = entry->bvh();
+
+    const size_t num_queries = req.origins.size();
+    res.face_indices.resize(num_queries);
+    res.hit_points.resize(num_queries);
+    res.distances.resize(num_queries);
+    #pragma omp parallel for if(num_queries > 64)
+    for (size_t i = 0; i < num_queries; i++)
+    {
+        uint32_t face;
+        if (bvh.raycast(req.origins[i], req.directions[i], req.max_distance, face, res.hit_points[i], res.distances[i]))
+        {
+            res.face_indices[i] = static_cast<int32_t>(face);
+        }
+        else
+        {
+            res.face_indices[i] = -1;
+        }
+    }
+    return true;
+}
+
+bool Reconstruction::service_getFacesInBox(
+    lvr_ros::GetFacesInBox::Request& req,
+    lvr_ros::GetFacesInBox::Response& res
+)
+{
+    LVR_ROS_TRACE_SPAN(span, "get_faces_in_box");
+    LVR_ROS_TRACE_ARG(span, "uuid", req.uuid);
+    MeshCacheEntryConstPtr entry = findCacheEntry(req.uuid);
+    if (!entry)
+    {
+        return false;
+    }
+    entry->bvh().facesInBox(req.min, req.max, res.face_indices);
     return true;
 }
 
@@ -160,11 +686,14 @@ bool Reconstruction::service_getMaterials(
 )
 {
     ROS_INFO("Service: Get Materials");
-    if (!cache_initialized || req.uuid != cache_uuid)
+    LVR_ROS_TRACE_SPAN(span, "get_materials");
+    LVR_ROS_TRACE_ARG(span, "uuid", req.uuid);
+    MeshCacheEntryConstPtr entry = findCacheEntry(req.uuid);
+    if (!entry)
     {
         return false;
     }
-    res.mesh_materials_stamped = cache_mesh_materials_stamped;
+    res.mesh_materials_stamped = entry->mesh_materials_stamped;
     return true;
 }
 
@@ -174,11 +703,71 @@ bool Reconstruction::service_getTexture(
 )
 {
     ROS_INFO("Service: Get Texture");
-    if (!cache_initialized || req.uuid != cache_uuid || req.texture_index > cache_textures.size() - 1)
+    LVR_ROS_TRACE_SPAN(span, "get_texture");
+    LVR_ROS_TRACE_ARG(span, "uuid", req.uuid);
+    MeshCacheEntryConstPtr entry = findCacheEntry(req.uuid);
+    if (!entry || req.texture_index >= entry->textures.size())
     {
         return false;
     }
-    res.texture = cache_textures.at(req.texture_index);
+    res.texture = entry->textures.at(req.texture_index);
+    return true;
+}
+
+bool Reconstruction::service_getCompressedTexture(
+    lvr_ros::GetCompressedTexture::Request& req,
+    lvr_ros::GetCompressedTexture::Response& res
+)
+{
+    ROS_INFO("Service: Get Compressed Texture");
+    LVR_ROS_TRACE_SPAN(span, "get_compressed_texture");
+    LVR_ROS_TRACE_ARG(span, "uuid", req.uuid);
+    MeshCacheEntryConstPtr entry = findCacheEntry(req.uuid);
+    if (!entry)
+    {
+        return false;
+    }
+    size_t level = req.level;
+    sensor_msgs::CompressedImageConstPtr image = entry->compressedTexture(
+        req.texture_index,
+        level,
+        req.format,
+        req.quality
+    );
+    if (!image)
+    {
+        return false;
+    }
+    res.uuid = entry->uuid;
+    res.texture_index = req.texture_index;
+    res.level = level;
+    res.image = *image;
+    return true;
+}
+
+bool Reconstruction::service_getTextureLevel(
+    lvr_ros::GetTextureLevel::Request& req,
+    lvr_ros::GetTextureLevel::Response& res
+)
+{
+    ROS_INFO("Service: Get Texture Level");
+    LVR_ROS_TRACE_SPAN(span, "get_texture_level");
+    LVR_ROS_TRACE_ARG(span, "uuid", req.uuid);
+    MeshCacheEntryConstPtr entry = findCacheEntry(req.uuid);
+    if (!entry)
+    {
+        return false;
+    }
+    size_t level = req.level;
+    size_t num_levels;
+    const mesh_msgs::MeshTexture* texture = entry->textureLevel(req.texture_index, level, num_levels);
+    if (!texture)
+    {
+        return false;
+    }
+    res.texture = *texture;
+    res.level = level;
+    res.num_levels = num_levels;
     return true;
 }
 
@@ -188,11 +777,39 @@ bool Reconstruction::service_getVertexColors(
 )
 {
     ROS_INFO("Service: Get Vertex Colors");
-    if (!cache_initialized || req.uuid != cache_uuid)
+    LVR_ROS_TRACE_SPAN(span, "get_vertex_colors");
+    LVR_ROS_TRACE_ARG(span, "uuid", req.uuid);
+    MeshCacheEntryConstPtr entry = findCacheEntry(req.uuid);
+    if (!entry)
+    {
+        return false;
+    }
+    res.mesh_vertex_colors_stamped = entry->mesh_vertex_colors_stamped;
+    return true;
+}
+
+bool Reconstruction::service_getVertexCosts(
+    mesh_msgs::GetVertexCosts::Request& req,
+    mesh_msgs::GetVertexCosts::Response& res
+)
+{
+    const ReconstructionConfig config = currentConfig();
+    ROS_INFO_STREAM("Service: Get Vertex Costs \"" << req.type << "\"");
+    LVR_ROS_TRACE_SPAN(span, "get_vertex_costs");
+    LVR_ROS_TRACE_ARG(span, "uuid", req.uuid);
+    LVR_ROS_TRACE_ARG(span, "layer", req.type);
+    MeshCacheEntryConstPtr entry = findCacheEntry(req.uuid);
+    if (!entry)
+    {
+        return false;
+    }
+    mesh_msgs::MeshVertexCostsStampedConstPtr costs = entry->vertexCosts(req.type, config.costRadius);
+    if (!costs)
     {
+        ROS_ERROR_STREAM("Vertex cost layer \"" << req.type << "\" is unknown or not available!");
         return false;
     }
-    res.mesh_vertex_colors_stamped = cache_mesh_vertex_colors_stamped;
+    res.mesh_vertex_costs_stamped = *costs;
     return true;
 }
 
@@ -202,35 +819,142 @@ bool Reconstruction::service_getUUID(
 )
 {
     ROS_INFO("Service: Get UUID");
-    if (!cache_initialized)
+    LVR_ROS_TRACE_SPAN(span, "get_uuid");
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (!cache_entry)
     {
         return false;
     }
-    res.uuid = cache_uuid;
+    res.uuid = cache_entry->uuid;
     return true;
 }
 
+MeshCacheEntryConstPtr Reconstruction::findCacheEntry(const std::string& uuid)
+{
+    LVR_ROS_TRACE_SPAN(span, "find_cache_entry");
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        if (cache_entry && cache_entry->uuid == uuid)
+        {
+            return cache_entry;
+        }
+    }
+    if (mesh_store)
+    {
+        return mesh_store->load(uuid);
+    }
+    return MeshCacheEntryConstPtr();
+}
+
 /**********************************************************************************************************************/
 // Callbacks
 
 void Reconstruction::pointCloudCallback(const sensor_msgs::PointCloud2::ConstPtr& cloud)
 {
+    const ReconstructionConfig config = currentConfig();
+    LVR_ROS_TRACE_SPAN(span, "point_cloud_callback");
+    LVR_ROS_TRACE_ARG(span, "points", cloud->width * cloud->height);
     mesh_msgs::TriangleMeshStamped mesh;
-    if (!createMeshMessageFromPointCloud(*cloud, mesh))
+    MeshCacheEntryConstPtr entry;
+    if (!createMeshMessageFromPointCloud(*cloud, mesh, entry, config.timeBudget))
     {
         ROS_ERROR_STREAM("Error in PointCloud callback");
+        return;
     }
 
     ROS_INFO_STREAM("Publish mesh geometry");
+    LVR_ROS_TRACE_ARG(span, "uuid", entry->uuid);
 
     // Reconstruction is done, publish TriangleMesh (deprecated!)
     mesh_publisher.publish(mesh);
     // .. and also publish MeshGeometry (new! use this)
-    mesh_geometry_publisher.publish(cache_mesh_geometry_stamped);
+    mesh_geometry_publisher.publish(entry->mesh_geometry_stamped);
+    // .. and the changes to the previous one
+    publishMeshDelta(entry->mesh_geometry_stamped);
+
+    // The configured cost layers have been computed with the cache entry
+    std::vector<std::string> cost_layers = parseVertexCostLayers(config.costLayers);
+    if (!entry->vertex_intensities.empty())
+    {
+        cost_layers.push_back("intensity");
+    }
+    for (const std::string& layer : cost_layers)
+    {
+        mesh_msgs::MeshVertexCostsStampedConstPtr costs = entry->vertexCosts(layer, config.costRadius);
+        if (costs)
+        {
+            mesh_vertex_costs_publisher.publish(*costs);
+        }
+    }
+
+    // The compact encoding is only computed for remote subscribers
+    lvr_ros::CompactMeshGeometry compact;
+    if (mesh_geometry_compact_publisher.getNumSubscribers() > 0 && fromMeshGeometryToCompactMeshGeometry(
+            entry->mesh_geometry_stamped,
+            compact,
+            config.compactPositionBits,
+            config.compactNormalBits,
+            config.compactCompressionLevel
+    ))
+    {
+        mesh_geometry_compact_publisher.publish(compact);
+    }
+}
+
+void Reconstruction::publishMeshDelta(const mesh_msgs::MeshGeometryStamped& mesh_geometry_stamped)
+{
+    const ReconstructionConfig config = currentConfig();
+    LVR_ROS_TRACE_SPAN(span, "publish_mesh_delta");
+    std::lock_guard<std::mutex> lock(delta_mutex);
+    // Subscribers without the base mesh can not apply a delta, new subscribers get a keyframe
+    const bool force_keyframe = delta_keyframe_requested.exchange(false);
+    if (mesh_geometry_delta_publisher.getNumSubscribers() == 0)
+    {
+        mesh_delta_encoder.reset();
+        return;
+    }
+
+    mesh_delta_encoder.setParameters(config.deltaQuantization, config.deltaKeyframeInterval, config.deltaMaxRatio);
+    MeshGeometryDelta delta = mesh_delta_encoder.encode(mesh_geometry_stamped, force_keyframe);
+    if (delta.keyframe)
+    {
+        ROS_INFO_STREAM("Publish mesh geometry keyframe");
+    }
+    else
+    {
+        ROS_INFO_STREAM("Publish mesh geometry delta: "
+            << delta.added_vertices.size() << " / " << delta.removed_vertices.size() << " vertices and "
+            << delta.added_faces.size() << " / " << delta.removed_faces.size() << " faces added / removed, "
+            << delta.updated_normal_vertices.size() << " normals updated");
+    }
+    mesh_geometry_delta_publisher.publish(delta);
+}
+
+void Reconstruction::deltaSubscriberConnected(const ros::SingleSubscriberPublisher& publisher)
+{
+    ROS_DEBUG_STREAM("New mesh delta subscriber " << publisher.getSubscriberName() << ", sending a keyframe next.");
+    delta_keyframe_requested = true;
 }
 
 void Reconstruction::reconfigureCallback(lvr_ros::ReconstructionConfig& config, uint32_t level)
 {
+    std::lock_guard<std::mutex> lock(config_mutex);
+    // Tracing starts with a trace file and writes it when the file is changed or cleared
+    if (config.traceFile != this->config.traceFile)
+    {
+#ifdef LVR_ROS_TRACING
+        if (config.traceFile.empty())
+        {
+            stopTrace();
+        }
+        else
+        {
+            startTrace(config.traceFile);
+        }
+#else
+        ROS_WARN_STREAM("Tracing is not available, lvr_ros was built without LVR_ROS_TRACING.");
+#endif
+    }
     this->config = config;
 }
 
@@ -239,9 +963,16 @@ void Reconstruction::reconfigureCallback(lvr_ros::ReconstructionConfig& config,
 
 bool Reconstruction::createMeshMessageFromPointCloud(
     const sensor_msgs::PointCloud2& cloud,
-    mesh_msgs::TriangleMeshStamped& mesh_msg
+    mesh_msgs::TriangleMeshStamped& mesh_msg,
+    MeshCacheEntryConstPtr& entry,
+    double time_budget,
+    ReconstructionBudgetChoice* choice
 )
 {
+    const ros::WallTime start = ros::WallTime::now();
+    // Waiting for a slot counts against the time budget
+    ReconstructionSlot slot(*this);
+
     // Generate uuid for new mesh
     boost::uuids::uuid boost_uuid = boost::uuids::random_generator()();
     std::string uuid = boost::lexical_cast<std::string>(boost_uuid);
@@ -259,10 +990,42 @@ bool Reconstruction::createMeshMessageFromPointCloud(
      */
 
 
+    ReconstructionConfig config = currentConfig();
     PointBufferPtr point_buffer_ptr(new PointBuffer);
     lvr2::MeshBufferPtr mesh_buffer_ptr(new lvr2::MeshBuffer);
 
-    if (!lvr_ros::fromPointCloud2ToPointBuffer(cloud, *point_buffer_ptr))
+    // Organized clouds of depth cameras are meshed in image space, without search tree and voxel grid
+    if (config.organizedClouds && cloud.height > 1)
+    {
+        if (!organizedCloudToMeshBuffer(
+            cloud,
+            *mesh_buffer_ptr,
+            config.organizedMaxDepthJump,
+            config.organizedNormalWindow
+        ))
+        {
+            ROS_ERROR_STREAM("Meshing the organized point cloud failed!");
+            return false;
+        }
+        if (choice)
+        {
+            choice->voxelsize = 0.0f;
+            choice->num_points = static_cast<size_t>(cloud.width) * cloud.height;
+            choice->estimated_time = 0.0;
+            choice->fits = true;
+        }
+        mesh_msg.header.frame_id = cloud.header.frame_id;
+        mesh_msg.header.stamp = cloud.header.stamp;
+        entry = cacheMeshBuffer(mesh_buffer_ptr, uuid, cloud.header);
+        return static_cast<bool>(entry);
+    }
+
+    bool converted;
+    {
+        LVR_ROS_TRACE_SPAN(convert_span, "convert_point_cloud");
+        converted = lvr_ros::fromPointCloud2ToPointBuffer(cloud, *point_buffer_ptr);
+    }
+    if (!converted)
     {
         ROS_ERROR_STREAM(
             "Could not convert point cloud from \"sensor_msgs::PointCloud2\" "
@@ -270,282 +1033,210 @@ bool Reconstruction::createMeshMessageFromPointCloud(
         );
         return false;
     }
-    if (!createMeshBufferFromPointBuffer(point_buffer_ptr, mesh_buffer_ptr))
+
+    // A face budget is resolved first, a time budget may coarsen its voxel size further
+    const size_t num_points = point_buffer_ptr->numPoints();
+    if (config.targetFaces > 0 && num_points > 0)
     {
-        ROS_ERROR_STREAM("Reconstruction failed!");
-        return false;
+        ROS_INFO_STREAM("Choose the voxel size for about " << config.targetFaces << " faces.");
+        config.voxelsize = voxelsizeForTargetFaces(
+            point_buffer_ptr->getPointArray().get(),
+            num_points,
+            config.targetFaces
+        );
+        config.intersections = 0;
+        config.targetFaces = 0;
     }
-    if (!lvr_ros::fromMeshBufferToMeshMessages(
-            mesh_buffer_ptr,
-            cache_mesh_geometry_stamped.mesh_geometry,
-            cache_mesh_materials_stamped.mesh_materials,
-            cache_mesh_vertex_colors_stamped.mesh_vertex_colors,
-            cache_textures,
-            uuid
-    ))
+
+    // The cost model needs a voxel size, a number of intersections stands for the voxel size lvr2 derives from it
+    float extent[3];
+    pointBufferExtent(point_buffer_ptr, extent);
+    float voxelsize = config.voxelsize;
+    if (config.intersections > 0)
     {
-        ROS_ERROR_STREAM("Could not convert \"lvr2::MeshBuffer\" to mesh messages!");
-        return false;
+        voxelsize = *std::max_element(extent, extent + 3) / config.intersections;
     }
 
-    // Setting header frame and stamp for TriangleMesh
-    mesh_msg.header.frame_id = cloud.header.frame_id;
-    mesh_msg.header.stamp = cloud.header.stamp;
-
-    // The following segment will update new MeshGeometry and MeshAttribute messages in cache
-    // These messages will be available via action/service
-    cache_initialized = true;
-
-    // Setting header frame and stamp
-    cache_mesh_geometry_stamped.header.frame_id = cloud.header.frame_id;
-    cache_mesh_geometry_stamped.header.stamp = cloud.header.stamp;
-    cache_mesh_materials_stamped.header.frame_id = cloud.header.frame_id;
-    cache_mesh_materials_stamped.header.stamp = cloud.header.stamp;
-    cache_mesh_vertex_colors_stamped.header.frame_id = cloud.header.frame_id;
-    cache_mesh_vertex_colors_stamped.header.stamp = cloud.header.stamp;
-
-    cache_mesh_geometry_stamped.uuid = uuid;
-    cache_mesh_materials_stamped.uuid = uuid;
-    cache_mesh_vertex_colors_stamped.uuid = uuid;
-
-    cache_uuid = uuid;
-
-    return true;
-}
-
-bool Reconstruction::createMeshBufferFromPointBuffer(
-    PointBufferPtr& point_buffer,
-    lvr2::MeshBufferPtr& mesh_buffer
-)
-{
-    // Create a point cloud manager
-    string pcm_name = config.pcm;
-    lvr2::PointsetSurfacePtr<Vec> surface;
-    bool use_gpu = config.useGPU;
-
-    // Create point set surface object
-    if (pcm_name == "PCL")
-    {
-        lvr2::panic("PCL not supported right now!");
-    }
-    else if (
-        pcm_name == "STANN" ||
-        pcm_name == "FLANN" ||
-        pcm_name == "NABO" ||
-        pcm_name == "NANOFLANN"
-        )
-    {
-        surface = make_shared < lvr2::AdaptiveKSearchSurface < Vec >> (
-            point_buffer,
-            pcm_name,
-            config.kn,
-            config.ki,
-            config.kd,
-            config.ransac
-        );
-    }
-    else
+    // Without a positive voxel size, e.g. for a cloud without extent, there is nothing to estimate
+    const bool has_voxelsize = voxelsize > 0.0f && std::isfinite(voxelsize);
+    if (time_budget > 0.0 && !has_voxelsize)
     {
-        ROS_ERROR_STREAM("Unable to create PointCloudManager.");
-        ROS_ERROR_STREAM("Unknown option '" << pcm_name << "'.");
-        ROS_ERROR_STREAM("Available PCMs are: ");
-        ROS_ERROR_STREAM("STANN, STANN_RANSAC, PCL");
-        return 0;
+        ROS_WARN_STREAM("The time budget is ignored for the voxel size " << voxelsize << ".");
     }
 
-    // Set search config for normal estimation and distance evaluation
-    surface->setKd(config.kd);
-    surface->setKi(config.ki);
-    surface->setKn(config.kn);
-
-    // Calculate normals if necessary
-    if (!point_buffer->hasNormals() || config.recalcNormals)
-    {
-        if(use_gpu){
-            #ifdef GPU_FOUND
-                size_t num_points = point_buffer->numPoints();
-                lvr2::floatArr points = point_buffer->getPointArray();
-                lvr2::floatArr normals = lvr2::floatArr(new float[ num_points * 3 ]);
-                ROS_INFO_STREAM("Generate GPU kd-tree...");
-                GpuSurface gpu_surface(points, num_points);
-                ROS_INFO_STREAM("GPU kd-tree done.");
-
-                gpu_surface.setKn(config.kn);
-                gpu_surface.setKi(config.ki);
-                gpu_surface.setFlippoint(config.flipx, config.flipy, config.flipz);
-                ROS_INFO_STREAM("Start normal calculation...");
-                gpu_surface.calculateNormals();
-                gpu_surface.getNormals(normals);
-                ROS_INFO_STREAM("Normal computation done.");
-
-                point_buffer->setNormalArray(normals, num_points * 3);
-                gpu_surface.freeGPU();
-            #else
-                ROS_ERROR("\"use_gpu\" is active, but GPU driver not installed!");
-                surface->calculateSurfaceNormals();
-            #endif
-        }
-        else
+    ReconstructionBudgetChoice budget_choice;
+    if (time_budget > 0.0 && has_voxelsize)
+    {
+        const double remaining = time_budget - (ros::WallTime::now() - start).toSec();
+        const size_t min_points = std::max(std::max(config.kn, config.ki), config.kd) + 1;
+        budget_choice = cost_model.choose(num_points, extent, voxelsize, remaining, min_points);
+        ROS_INFO_STREAM("Reconstruct with voxel size " << budget_choice.voxelsize << " and "
+            << budget_choice.num_points << " of " << num_points << " points, estimated "
+            << budget_choice.estimated_time << " s of " << remaining << " s.");
+        if (!budget_choice.fits)
         {
-            surface->calculateSurfaceNormals();
+            ROS_WARN_STREAM("The reconstruction is estimated to exceed its time budget at the coarsest resolution.");
         }
+        point_buffer_ptr = subsamplePointBuffer(point_buffer_ptr, budget_choice.num_points);
+        config.voxelsize = budget_choice.voxelsize;
+        config.intersections = 0;
     }
     else
     {
-        ROS_INFO_STREAM("Using given normals.");
+        budget_choice.voxelsize = voxelsize;
+        budget_choice.num_points = num_points;
+        budget_choice.estimated_time = cost_model.estimate(num_points, extent, voxelsize);
+        budget_choice.fits = true;
     }
-
-    // Create an empty mesh
-    lvr2::HalfEdgeMesh <Vec> mesh;
-
-    // Determine whether to use intersections or voxelsize
-    float resolution;
-    bool useVoxelsize;
-    if (config.intersections > 0)
+    if (choice)
     {
-        resolution = config.intersections;
-        useVoxelsize = false;
+        *choice = budget_choice;
     }
-    else
+
+    const ros::WallTime reconstruction_start = ros::WallTime::now();
+    if (!createMeshBufferFromPointBuffer(config, point_buffer_ptr, mesh_buffer_ptr))
     {
-        resolution = config.voxelsize;
-        useVoxelsize = true;
+        ROS_ERROR_STREAM("Reconstruction failed!");
+        return false;
     }
 
-    // Create a point set grid for reconstruction
-    string decomposition = config.decomposition;
+    // Setting header frame and stamp for TriangleMesh
+    mesh_msg.header.frame_id = cloud.header.frame_id;
+    mesh_msg.header.stamp = cloud.header.stamp;
 
-    // Fail safe check
-    if (decomposition != "MC" && decomposition != "PMC" && decomposition != "SF")
+    // The MeshGeometry and MeshAttribute messages will be available via action/service
+    entry = cacheMeshBuffer(mesh_buffer_ptr, uuid, cloud.header);
+    if (!entry)
     {
-        ROS_ERROR_STREAM("Unsupported decomposition type " << decomposition << ". Defaulting to PMC.");
-        decomposition = "PMC";
+        return false;
     }
 
-    shared_ptr <lvr2::GridBase> grid;
-    unique_ptr <lvr2::FastReconstructionBase<Vec>> reconstruction;
-    if (decomposition == "MC")
+    // Calibrate the cost model with the time from the converted cloud to the cached mesh
+    if (has_voxelsize)
     {
-        lvr2::panic("MC decomposition type not supported right now!");
-    }
-    else if (decomposition == "PMC")
-    {
-        lvr2::BilinearFastBox<Vec>::m_surface = surface;
-        auto ps_grid = std::make_shared<lvr2::PointsetGrid<Vec, lvr2::BilinearFastBox<Vec>>>(
-            resolution,
-            surface,
-            surface->getBoundingBox(),
-            useVoxelsize,
-            !config.noExtrusion
+        cost_model.update(
+            budget_choice.num_points,
+            extent,
+            budget_choice.voxelsize,
+            (ros::WallTime::now() - reconstruction_start).toSec()
         );
-        ps_grid->calcDistanceValues();
-        grid = ps_grid;
-        reconstruction = make_unique<lvr2::FastReconstruction<Vec, lvr2::BilinearFastBox<Vec>>>(ps_grid);
-    }
-    else if (decomposition == "SF")
-    {
-        lvr2::panic("SF decomposition type not supported right now!");
     }
+    return true;
+}
 
-    // Create mesh
-    reconstruction->getMesh(mesh);
+MeshCacheEntryConstPtr Reconstruction::cacheMeshBuffer(
+    const lvr2::MeshBufferPtr& mesh_buffer,
+    const std::string& uuid,
+    const std_msgs::Header& header
+)
+{
+    const ReconstructionConfig config = currentConfig();
+    LVR_ROS_TRACE_SPAN(span, "cache_mesh");
+    LVR_ROS_TRACE_ARG(span, "uuid", uuid);
+    LVR_ROS_TRACE_ARG(span, "vertices", mesh_buffer->numVertices());
+    LVR_ROS_TRACE_ARG(span, "faces", mesh_buffer->numFaces());
 
+    MeshCacheEntryPtr entry = boost::make_shared<MeshCacheEntry>();
+    entry->uuid = uuid;
 
-    // =======================================================================
-    // Optimize and finalize mesh
-    // =======================================================================
-    if(config.rda != 0)
+    if (!lvr_ros::fromMeshBufferToMeshMessages(
+            mesh_buffer,
+            entry->mesh_geometry_stamped.mesh_geometry,
+            entry->mesh_materials_stamped.mesh_materials,
+            entry->mesh_vertex_colors_stamped.mesh_vertex_colors,
+            entry->textures,
+            uuid
+    ))
     {
-        removeDanglingCluster(mesh, static_cast<size_t>(config.rda));
+        ROS_ERROR_STREAM("Could not convert \"lvr2::MeshBuffer\" to mesh messages!");
+        return MeshCacheEntryConstPtr();
     }
 
-    // Magic number from lvr1 `cleanContours`...
-    cleanContours(mesh, config.cleanContours, 0.0001);
-
-    naiveFillSmallHoles(mesh, static_cast<size_t>(config.fillHoles), false);
-
-    auto faceNormals = calcFaceNormals(mesh);
-
-    lvr2::ClusterBiMap <lvr2::FaceHandle> clusterBiMap;
-    if (config.optimizePlanes)
+    size_t num_intensities;
+    unsigned intensity_width;
+    lvr2::floatArr intensities = mesh_buffer->getFloatArray("intensity", num_intensities, intensity_width);
+    const size_t num_vertices = entry->mesh_geometry_stamped.mesh_geometry.vertices.size();
+    if (intensities && intensity_width == 1 && num_intensities == num_vertices)
     {
-        clusterBiMap = iterativePlanarClusterGrowing(
-            mesh,
-            faceNormals,
-            config.pnt,
-            config.planeIterations,
-            config.mp
-        );
-
-        if (config.smallRegionThreshold > 0)
+        entry->vertex_intensities.assign(intensities.get(), intensities.get() + num_intensities);
+        if (config.intensityColors)
         {
-            deleteSmallPlanarCluster(
-                mesh,
-                clusterBiMap,
-                static_cast<size_t>(config.smallRegionThreshold)
+            intensityToVertexRainbowColors(
+                entry->vertex_intensities,
+                entry->mesh_vertex_colors_stamped.mesh_vertex_colors
             );
         }
     }
-    else
+
+    // Serve few large texture pages instead of one small texture per cluster
+    const size_t num_textures = entry->textures.size();
+    if (config.textureAtlas && num_textures > 1 && packTextureAtlas(
+            entry->mesh_geometry_stamped.mesh_geometry,
+            entry->mesh_materials_stamped.mesh_materials,
+            entry->textures,
+            config.atlasPageSize,
+            config.atlasPadding
+    ))
     {
-        clusterBiMap = planarClusterGrowing(mesh, faceNormals, config.pnt);
+        ROS_INFO_STREAM("Packed " << num_textures << " textures into " << entry->textures.size() << " atlas pages.");
     }
 
-    // Calc normaBaseVecTls for vertices
-    auto vertexNormals = calcVertexNormals(mesh, faceNormals, *surface);
-
-    // Prepare color data for finalizing
-    auto vertexColors = calcColorFromPointCloud(mesh, surface);
-
-    // When using textures ...
-    if (config.generateTextures)
+    // Setting header frame and stamp
+    entry->mesh_geometry_stamped.header.frame_id = header.frame_id;
+    entry->mesh_geometry_stamped.header.stamp = header.stamp;
+    entry->mesh_materials_stamped.header.frame_id = header.frame_id;
+    entry->mesh_materials_stamped.header.stamp = header.stamp;
+    entry->mesh_vertex_colors_stamped.header.frame_id = header.frame_id;
+    entry->mesh_vertex_colors_stamped.header.stamp = header.stamp;
+
+    entry->mesh_geometry_stamped.uuid = uuid;
+    entry->mesh_materials_stamped.uuid = uuid;
+    entry->mesh_vertex_colors_stamped.uuid = uuid;
+
+    // Spatial queries and the configured cost layers are answered right away for the new mesh
+    entry->bvh();
+    for (const std::string& layer : parseVertexCostLayers(config.costLayers))
     {
-        // Prepare finalize algorithm
-        lvr2::TextureFinalizer<Vec> finalize(clusterBiMap);
-        finalize.setVertexNormals(vertexNormals);
-        if (vertexColors)
-        {
-            finalize.setVertexColors(*vertexColors);
-        }
-
-        // Materializer for face materials (colors and/or textures)
-        lvr2::Materializer<Vec> materializer(
-            mesh,
-            clusterBiMap,
-            faceNormals,
-            *surface
-        );
-
-        // Set texturizer
-        lvr2::Texturizer<Vec> texturizer(
-            config.texelSize,
-            config.texMinClusterSize,
-            config.texMaxClusterSize
-        );
-        materializer.setTexturizer(texturizer);
-
-        // Generate materials
-        lvr2::MaterializerResult<Vec> matResult = materializer.generateMaterials();
-        // Add data to finalize algorithm
-        finalize.setMaterializerResult(matResult);
+        entry->vertexCosts(layer, config.costRadius);
+    }
 
-        mesh_buffer = finalize.apply(mesh);
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        cache_entry = entry;
     }
-    else
+
+    // Writing happens in the background, the entry is served from memory until then
+    if (mesh_store)
     {
-        // Finalize mesh (convert it to simple `MeshBuffer`)
-        lvr2::SimpleFinalizer<Vec> finalize;
-        finalize.setNormalData(vertexNormals);
-        mesh_buffer = finalize.apply(mesh);
+        mesh_store->store(entry);
     }
 
-    ROS_INFO_STREAM("Reconstruction finished!");
-    return true;
+    return entry;
+}
+
+bool Reconstruction::createMeshBufferFromPointBuffer(
+    const ReconstructionConfig& config,
+    PointBufferPtr& point_buffer,
+    lvr2::MeshBufferPtr& mesh_buffer
+)
+{
+#ifdef LVR_ROS_MPI
+    // Tiles of the cloud are reconstructed by all MPI ranks
+    return reconstructDistributed(config, point_buffer, mesh_buffer);
+#else
+    return reconstructMeshBuffer(config, point_buffer, mesh_buffer);
+#endif
 }
 
 /**********************************************************************************************************************/
 // Utility & Main
 
+ReconstructionConfig Reconstruction::currentConfig()
+{
+    std::lock_guard<std::mutex> lock(config_mutex);
+    return config;
+}
+
 float *Reconstruction::getStatsCoeffs(std::string filename) const
 {
     float *result = new float[14];
@@ -574,12 +1265,25 @@ float *Reconstruction::getStatsCoeffs(std::string filename) const
 
 int main(int argc, char **args)
 {
+#ifdef LVR_ROS_MPI
+    // Only rank 0 is a ROS node, the other ranks reconstruct the tiles it sends
+    if (lvr_ros::initDistributedReconstruction(argc, args) != 0)
+    {
+        lvr_ros::runTileWorker();
+        lvr_ros::finishDistributedReconstruction();
+        return 0;
+    }
+#endif
     ros::init(argc, args, "reconstruction");
     lvr_ros::Reconstruction reconstruction;
-    // ros::spin();
 
+    // Services and reconstruction are spun by the threads of the node, the global queue only holds the rest
+    ros::spin(); // spin() will not return until the node has been shutdown
 
-    ros::MultiThreadedSpinner spinner(4); // Use 4 threads
-    spinner.spin(); // spin() will not return until the node has been shutdown
+    // Write a running trace
+    lvr_ros::stopTrace();
+#ifdef LVR_ROS_MPI
+    lvr_ros::finishDistributedReconstruction();
+#endif
     return 0;
 }
@@ -0,0 +1,456 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_benchmark.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ros/console.h>
+#include <ros/package.h>
+#include <ros/time.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <lvr2/io/ModelFactory.hpp>
+
+#include "lvr_ros/conversions.h"
+#include "lvr_ros/reconstruction_pipeline.h"
+#include "lvr_ros/trace.h"
+
+/*
+ * Runs the reconstruction pipeline of the reconstruction node offline and reports the cost of every stage as JSON.
+ *
+ * Usage: reconstruction_benchmark <points.ply|points.h5|cloud.bag> [options]
+ *
+ *   --config <file>          Parameter file, defaults to config/lvr_params.yaml of this package
+ *   --topic <topic>          Point cloud topic of a bag file, the first point cloud of any topic otherwise
+ *   --repeat <n>             Repetitions of every parameter set, 3 by default
+ *   --set <name>=<value>     Overrides a parameter of the file, can be given multiple times
+ *   --sweep <name>=<v1,v2>   Runs every combination of the swept values, can be given multiple times
+ *   --output <file>          Writes the JSON report to the file instead of stdout
+ *
+ * Example: reconstruction_benchmark scan.ply --sweep voxelsize=0.05,0.1,0.2 --sweep kn=10,50 --repeat 5
+ *
+ * Wall and CPU time are measured for every stage, the CPU time sums up all threads of the process. The peak
+ * memory is the high-water mark of the resident set size within the stage or repetition. It is reset through
+ * /proc/self/clear_refs, kernels without it report the high-water mark of the whole process instead.
+ */
+
+using Clock = std::chrono::steady_clock;
+
+/// Consumed CPU time of all threads of the process in seconds
+static double cpuTime()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+/// Resets the peak resident set size to the current one, returns false if the kernel does not support it
+static bool resetPeakMemory()
+{
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+    clear_refs.flush();
+    return static_cast<bool>(clear_refs);
+}
+
+/// Peak resident set size in KiB since the last reset, of the whole process if it can not be read
+static long peakMemory()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+        {
+            return std::stol(line.substr(6));
+        }
+    }
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/// Numbers are written as they are, everything else as string
+static std::string jsonValue(const std::string& value)
+{
+    char* end = nullptr;
+    std::strtod(value.c_str(), &end);
+    if (!value.empty() && end == value.c_str() + value.size())
+    {
+        return value;
+    }
+    return lvr_ros::jsonString(value);
+}
+
+static double median(std::vector<double> values)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    const size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+static bool splitAssignment(const std::string& text, std::string& name, std::string& value)
+{
+    const size_t equals = text.find('=');
+    if (equals == std::string::npos || equals == 0)
+    {
+        std::cerr << "Expected <name>=<value>, got \"" << text << "\"!" << std::endl;
+        return false;
+    }
+    name = text.substr(0, equals);
+    value = text.substr(equals + 1);
+    return true;
+}
+
+static std::vector<std::string> splitList(const std::string& list)
+{
+    std::vector<std::string> values;
+    std::istringstream stream(list);
+    std::string value;
+    while (std::getline(stream, value, ','))
+    {
+        if (!value.empty())
+        {
+            values.push_back(value);
+        }
+    }
+    return values;
+}
+
+/// Reads the first point cloud of the topic, or of any topic if none is given
+static bool readBagPointCloud(const std::string& filename, const std::string& topic, lvr2::PointBuffer& buffer)
+{
+    rosbag::Bag bag(filename, rosbag::bagmode::Read);
+    std::unique_ptr<rosbag::View> view = topic.empty()
+        ? std::unique_ptr<rosbag::View>(new rosbag::View(bag))
+        : std::unique_ptr<rosbag::View>(new rosbag::View(bag, rosbag::TopicQuery(topic)));
+    for (const rosbag::MessageInstance& message : *view)
+    {
+        sensor_msgs::PointCloud2::ConstPtr cloud = message.instantiate<sensor_msgs::PointCloud2>();
+        if (cloud)
+        {
+            return lvr_ros::fromPointCloud2ToPointBuffer(*cloud, buffer);
+        }
+    }
+    std::cerr << "No point cloud found in \"" << filename << "\"!" << std::endl;
+    return false;
+}
+
+static lvr2::PointBufferPtr readPointBuffer(const std::string& filename, const std::string& topic)
+{
+    if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".bag") == 0)
+    {
+        lvr2::PointBufferPtr buffer(new lvr2::PointBuffer);
+        return readBagPointCloud(filename, topic, *buffer) ? buffer : lvr2::PointBufferPtr();
+    }
+
+    lvr2::ModelPtr model = lvr2::ModelFactory::readModel(filename);
+    if (!model || !model->m_pointCloud)
+    {
+        std::cerr << "No point cloud found in \"" << filename << "\"!" << std::endl;
+        return lvr2::PointBufferPtr();
+    }
+    return model->m_pointCloud;
+}
+
+/// Writes one repetition of the pipeline as JSON object, returns false if the reconstruction failed
+static bool runPipeline(
+    const lvr_ros::ReconstructionConfig& config,
+    const lvr2::PointBufferPtr& points,
+    std::ostream& json,
+    double& wall_time,
+    double& cpu_time
+)
+{
+    // The pipeline adds computed normals to the buffer, every repetition starts from the same channels
+    lvr2::PointBufferPtr point_buffer(new lvr2::PointBuffer(*points));
+    lvr2::MeshBufferPtr mesh_buffer;
+
+    std::vector<std::string> stages;
+    std::vector<double> stage_wall, stage_cpu;
+    std::vector<long> stage_memory;
+    long run_memory = 0;
+    resetPeakMemory();
+    const Clock::time_point start = Clock::now();
+    const double start_cpu = cpuTime();
+    auto endStage = [&]()
+    {
+        if (!stages.empty())
+        {
+            stage_wall.back() = std::chrono::duration<double>(Clock::now() - start).count() - stage_wall.back();
+            stage_cpu.back() = cpuTime() - start_cpu - stage_cpu.back();
+            stage_memory.back() = peakMemory();
+            run_memory = std::max(run_memory, stage_memory.back());
+        }
+    };
+
+    const bool success = lvr_ros::reconstructMeshBuffer(
+        config,
+        point_buffer,
+        mesh_buffer,
+        [&](const std::string& stage)
+        {
+            endStage();
+            // Hold the start offsets until the stage ends
+            stages.push_back(stage);
+            stage_wall.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+            stage_cpu.push_back(cpuTime() - start_cpu);
+            stage_memory.push_back(0);
+            resetPeakMemory();
+        }
+    );
+    endStage();
+    run_memory = std::max(run_memory, peakMemory());
+    wall_time = std::chrono::duration<double>(Clock::now() - start).count();
+    cpu_time = cpuTime() - start_cpu;
+
+    const size_t num_vertices = success && mesh_buffer ? mesh_buffer->numVertices() : 0;
+    const size_t num_faces = success && mesh_buffer ? mesh_buffer->numFaces() : 0;
+    size_t mesh_bytes = 0;
+    if (num_vertices > 0)
+    {
+        // Positions and face indices, plus the optional normals and colors
+        mesh_bytes = num_vertices * 3 * sizeof(float) + num_faces * 3 * sizeof(unsigned int);
+        if (mesh_buffer->hasVertexNormals())
+        {
+            mesh_bytes += num_vertices * 3 * sizeof(float);
+        }
+        if (mesh_buffer->hasVertexColors())
+        {
+            mesh_bytes += num_vertices * 3;
+        }
+    }
+
+    json << "{\"success\": " << (success ? "true" : "false")
+        << ", \"wall_s\": " << wall_time
+        << ", \"cpu_s\": " << cpu_time
+        << ", \"peak_memory_kib\": " << run_memory
+        << ", \"vertices\": " << num_vertices
+        << ", \"faces\": " << num_faces
+        << ", \"mesh_bytes\": " << mesh_bytes
+        << ", \"stages\": [";
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+        json << (i ? ", " : "") << "{\"name\": " << lvr_ros::jsonString(stages[i])
+            << ", \"wall_s\": " << stage_wall[i]
+            << ", \"cpu_s\": " << stage_cpu[i]
+            << ", \"peak_memory_kib\": " << stage_memory[i] << "}";
+    }
+    json << "]}";
+    return success;
+}
+
+int main(int argc, char **args)
+{
+    std::string input, topic, output;
+    std::string config_file = ros::package::getPath("lvr_ros") + "/config/lvr_params.yaml";
+    int repetitions = 3;
+    std::vector<std::pair<std::string, std::string>> overrides;
+    std::vector<std::pair<std::string, std::vector<std::string>>> sweeps;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = args[i];
+        const bool has_value = i + 1 < argc;
+        std::string name, value;
+        if (arg == "--config" && has_value)
+        {
+            config_file = args[++i];
+        }
+        else if (arg == "--topic" && has_value)
+        {
+            topic = args[++i];
+        }
+        else if (arg == "--repeat" && has_value)
+        {
+            repetitions = std::max(1, std::atoi(args[++i]));
+        }
+        else if (arg == "--output" && has_value)
+        {
+            output = args[++i];
+        }
+        else if (arg == "--set" && has_value)
+        {
+            if (!splitAssignment(args[++i], name, value))
+            {
+                return 1;
+            }
+            overrides.emplace_back(name, value);
+        }
+        else if (arg == "--sweep" && has_value)
+        {
+            if (!splitAssignment(args[++i], name, value) || splitList(value).empty())
+            {
+                return 1;
+            }
+            sweeps.emplace_back(name, splitList(value));
+        }
+        else if (input.empty() && arg.compare(0, 2, "--") != 0)
+        {
+            input = arg;
+        }
+        else
+        {
+            std::cerr << "Unknown or incomplete option \"" << arg << "\"!" << std::endl;
+            return 1;
+        }
+    }
+    if (input.empty())
+    {
+        std::cerr << "Usage: reconstruction_benchmark <points.ply|points.h5|cloud.bag> [--config <file>] "
+            "[--topic <topic>] [--repeat <n>] [--set <name>=<value>] [--sweep <name>=<v1,v2,...>] "
+            "[--output <file>]" << std::endl;
+        return 1;
+    }
+
+    // Time stamps of the messages work without a ROS master
+    ros::Time::init();
+    if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Warn))
+    {
+        ros::console::notifyLoggerLevelsChanged();
+    }
+
+    lvr_ros::ReconstructionConfig base_config;
+    if (!lvr_ros::loadReconstructionConfig(config_file, base_config))
+    {
+        return 1;
+    }
+    for (const auto& parameter : overrides)
+    {
+        if (!lvr_ros::setReconstructionParameter(base_config, parameter.first, parameter.second))
+        {
+            std::cerr << "Invalid parameter " << parameter.first << "=" << parameter.second << "!" << std::endl;
+            return 1;
+        }
+    }
+
+    for (const auto& sweep : sweeps)
+    {
+        for (const std::string& value : sweep.second)
+        {
+            lvr_ros::ReconstructionConfig config = base_config;
+            if (!lvr_ros::setReconstructionParameter(config, sweep.first, value))
+            {
+                std::cerr << "Invalid parameter " << sweep.first << "=" << value << "!" << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    const lvr2::PointBufferPtr points = readPointBuffer(input, topic);
+    if (!points)
+    {
+        return 1;
+    }
+
+    std::ofstream file;
+    if (!output.empty())
+    {
+        file.open(output);
+        if (!file)
+        {
+            std::cerr << "Could not open \"" << output << "\"!" << std::endl;
+            return 1;
+        }
+    }
+
+    // Keep stdout clean for the report, the progress output of the pipeline goes to stderr
+    std::streambuf* stdout_buffer = std::cout.rdbuf(std::cerr.rdbuf());
+    std::ostringstream json;
+    json << std::setprecision(6);
+
+    json << "{\"input\": " << lvr_ros::jsonString(input)
+        << ", \"config\": " << lvr_ros::jsonString(config_file)
+        << ", \"points\": " << points->numPoints()
+        << ", \"overrides\": {";
+    for (size_t i = 0; i < overrides.size(); i++)
+    {
+        json << (i ? ", " : "") << lvr_ros::jsonString(overrides[i].first) << ": " << jsonValue(overrides[i].second);
+    }
+    json << "}, \"runs\": [";
+
+    // Odometer over the swept values, a single run without sweeps
+    std::vector<size_t> combination(sweeps.size(), 0);
+    bool all_succeeded = true;
+    for (bool first = true; ; first = false)
+    {
+        lvr_ros::ReconstructionConfig config = base_config;
+        json << (first ? "" : ", ") << "{\"parameters\": {";
+        for (size_t i = 0; i < sweeps.size(); i++)
+        {
+            const std::string& value = sweeps[i].second[combination[i]];
+            lvr_ros::setReconstructionParameter(config, sweeps[i].first, value);
+            json << (i ? ", " : "") << lvr_ros::jsonString(sweeps[i].first) << ": " << jsonValue(value);
+        }
+        json << "}, \"repetitions\": [";
+
+        std::vector<double> wall_times, cpu_times;
+        for (int repetition = 0; repetition < repetitions; repetition++)
+        {
+            double wall_time, cpu_time;
+            if (repetition > 0)
+            {
+                json << ", ";
+            }
+            all_succeeded &= runPipeline(config, points, json, wall_time, cpu_time);
+            wall_times.push_back(wall_time);
+            cpu_times.push_back(cpu_time);
+        }
+        json << "], \"median_wall_s\": " << median(wall_times)
+            << ", \"median_cpu_s\": " << median(cpu_times) << "}";
+
+        size_t i = 0;
+        while (i < sweeps.size() && ++combination[i] == sweeps[i].second.size())
+        {
+            combination[i++] = 0;
+        }
+        if (i == sweeps.size())
+        {
+            break;
+        }
+    }
+    json << "]}" << std::endl;
+
+    std::cout.rdbuf(stdout_buffer);
+    (output.empty() ? std::cout : file) << json.str();
+    return all_succeeded ? 0 : 1;
+}
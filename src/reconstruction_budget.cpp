@@ -0,0 +1,254 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_budget.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#include "lvr_ros/reconstruction_budget.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace lvr_ros
+{
+
+/// Smallest voxel size of the estimates, a voxel size of 0 would give infinitely many cells
+static const double MIN_VOXELSIZE = 1e-6;
+
+/// Points and surface cells in millions, so that all coefficients have a similar magnitude
+static void costFeatures(size_t num_points, double cells, double x[3])
+{
+    x[0] = 1.0;
+    x[1] = num_points * 1e-6;
+    x[2] = cells * 1e-6;
+}
+
+ReconstructionCostModel::ReconstructionCostModel(double forgetting)
+    : forgetting(std::min(std::max(forgetting, 1e-3), 1.0))
+{
+    // Seconds of a fixed overhead, per million points and per million surface cells on a few cores
+    coefficients[0] = 0.1;
+    coefficients[1] = 5.0;
+    coefficients[2] = 10.0;
+
+    // Variances of the initial coefficients, they are corrected quickly
+    const double variances[3] = {1.0, 25.0, 100.0};
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            covariance[i][j] = i == j ? variances[i] : 0.0;
+        }
+    }
+}
+
+double ReconstructionCostModel::estimateFeatures(const double x[3]) const
+{
+    // Negative coefficients may occur in between, they would favor larger problems
+    double time = 0.0;
+    for (int i = 0; i < 3; i++)
+    {
+        time += std::max(coefficients[i], 0.0) * x[i];
+    }
+    return time;
+}
+
+double ReconstructionCostModel::estimate(size_t num_points, const float extent[3], float voxelsize) const
+{
+    double x[3];
+    costFeatures(num_points, estimateSurfaceCells(extent, voxelsize), x);
+    std::lock_guard<std::mutex> lock(mutex);
+    return estimateFeatures(x);
+}
+
+void ReconstructionCostModel::update(size_t num_points, const float extent[3], float voxelsize, double seconds)
+{
+    double x[3];
+    costFeatures(num_points, estimateSurfaceCells(extent, voxelsize), x);
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Recursive least squares with exponential forgetting
+    double px[3];
+    double denominator = forgetting;
+    for (int i = 0; i < 3; i++)
+    {
+        px[i] = covariance[i][0] * x[0] + covariance[i][1] * x[1] + covariance[i][2] * x[2];
+        denominator += x[i] * px[i];
+    }
+    double error = seconds;
+    for (int i = 0; i < 3; i++)
+    {
+        error -= coefficients[i] * x[i];
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        coefficients[i] += px[i] / denominator * error;
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            covariance[i][j] = (covariance[i][j] - px[i] * px[j] / denominator) / forgetting;
+        }
+    }
+    num_samples++;
+}
+
+ReconstructionBudgetChoice ReconstructionCostModel::choose(
+    size_t num_points,
+    const float extent[3],
+    float voxelsize,
+    double budget,
+    size_t min_points
+) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ReconstructionBudgetChoice choice;
+    choice.fits = false;
+    for (int step = 0; step <= 8; step++)
+    {
+        const float step_voxelsize = voxelsize * std::pow(2.0f, step * 0.5f);
+        const double cells = estimateSurfaceCells(extent, step_voxelsize);
+        // More cells than points end the subsampling right away, the cast must not overflow
+        const size_t min_step_points = std::max(
+            min_points,
+            static_cast<size_t>(std::min(cells, static_cast<double>(num_points)))
+        );
+        for (size_t step_points = num_points; ; step_points /= 2)
+        {
+            double x[3];
+            costFeatures(step_points, cells, x);
+            choice.voxelsize = step_voxelsize;
+            choice.num_points = step_points;
+            choice.estimated_time = estimateFeatures(x);
+            if (choice.estimated_time <= budget)
+            {
+                choice.fits = true;
+                return choice;
+            }
+            if (step_points / 2 < min_step_points)
+            {
+                break;
+            }
+        }
+    }
+    return choice;
+}
+
+size_t ReconstructionCostModel::numSamples() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return num_samples;
+}
+
+double estimateSurfaceCells(const float extent[3], float voxelsize)
+{
+    // A surface through the box covers about the area of one side per pair of axes, at most the whole volume
+    const double cell_size = voxelsize > MIN_VOXELSIZE ? static_cast<double>(voxelsize) : MIN_VOXELSIZE;
+    double size[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        size[axis] = std::max(static_cast<double>(extent[axis]), cell_size) / cell_size;
+    }
+    const double area = size[0] * size[1] + size[1] * size[2] + size[0] * size[2];
+    return std::min(area, size[0] * size[1] * size[2]);
+}
+
+void pointBufferExtent(const lvr2::PointBufferPtr& point_buffer, float extent[3])
+{
+    const size_t num_points = point_buffer->numPoints();
+    const lvr2::floatArr points = point_buffer->getPointArray();
+    float min[3], max[3];
+    std::fill(min, min + 3, std::numeric_limits<float>::max());
+    std::fill(max, max + 3, std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < num_points; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            min[axis] = std::min(min[axis], points[3 * i + axis]);
+            max[axis] = std::max(max[axis], points[3 * i + axis]);
+        }
+    }
+    for (int axis = 0; axis < 3; axis++)
+    {
+        extent[axis] = num_points > 0 ? max[axis] - min[axis] : 0.0f;
+    }
+}
+
+/// Copies the elements of the kept points, width values per point
+template<typename T>
+static boost::shared_array<T> subsampleArray(
+    const boost::shared_array<T>& values,
+    size_t width,
+    size_t num_points,
+    size_t num_kept
+)
+{
+    boost::shared_array<T> kept(new T[num_kept * width]);
+    for (size_t i = 0; i < num_kept; i++)
+    {
+        const size_t index = static_cast<size_t>(static_cast<uint64_t>(i) * num_points / num_kept);
+        std::copy(&values[index * width], &values[index * width] + width, &kept[i * width]);
+    }
+    return kept;
+}
+
+lvr2::PointBufferPtr subsamplePointBuffer(const lvr2::PointBufferPtr& point_buffer, size_t num_points)
+{
+    const size_t num_all = point_buffer->numPoints();
+    if (num_points >= num_all)
+    {
+        return point_buffer;
+    }
+
+    lvr2::PointBufferPtr kept(new lvr2::PointBuffer(
+        subsampleArray(point_buffer->getPointArray(), 3, num_all, num_points),
+        num_points
+    ));
+    if (point_buffer->hasNormals())
+    {
+        kept->setNormalArray(subsampleArray(point_buffer->getNormalArray(), 3, num_all, num_points), num_points);
+    }
+    if (point_buffer->hasColors())
+    {
+        size_t width;
+        const lvr2::ucharArr colors = point_buffer->getColorArray(width);
+        kept->setColorArray(subsampleArray(colors, width, num_all, num_points), num_points, width);
+    }
+    size_t num_intensities;
+    unsigned intensity_width;
+    const lvr2::floatArr intensities = point_buffer->getFloatArray("intensity", num_intensities, intensity_width);
+    if (intensities && num_intensities == num_all)
+    {
+        kept->addFloatChannel(
+            subsampleArray(intensities, intensity_width, num_all, num_points),
+            "intensity",
+            num_points,
+            intensity_width
+        );
+    }
+    return kept;
+}
+
+} // namespace lvr_ros
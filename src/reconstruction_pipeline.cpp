@@ -0,0 +1,680 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_pipeline.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ros/console.h>
+#include <dynamic_reconfigure/config_tools.h>
+
+#include "lvr_ros/reconstruction_pipeline.h"
+#include "lvr_ros/trace.h"
+#include "lvr_ros/voxel_occupancy.h"
+
+#include <lvr2/algorithm/CleanupAlgorithms.hpp>
+#include <lvr2/algorithm/ClusterAlgorithms.hpp>
+#include <lvr2/algorithm/FinalizeAlgorithms.hpp>
+#include <lvr2/algorithm/NormalAlgorithms.hpp>
+#include <lvr2/algorithm/ReductionAlgorithms.hpp>
+#include <lvr2/algorithm/Texturizer.hpp>
+#include <lvr2/attrmaps/AttrMaps.hpp>
+#include <lvr2/geometry/BaseVector.hpp>
+#include <lvr2/geometry/HalfEdgeMesh.hpp>
+#include <lvr2/geometry/Normal.hpp>
+#include <lvr2/reconstruction/AdaptiveKSearchSurface.hpp>
+#include <lvr2/reconstruction/BilinearFastBox.hpp>
+#include <lvr2/reconstruction/FastReconstruction.hpp>
+#include <lvr2/reconstruction/PointsetGrid.hpp>
+#include <lvr2/reconstruction/PointsetSurface.hpp>
+#include <lvr2/reconstruction/SearchTree.hpp>
+#include <lvr2/util/ClusterBiMap.hpp>
+#include <lvr2/util/Panic.hpp>
+
+#if defined CUDA_FOUND
+    #define GPU_FOUND
+
+    #include <lvr2/reconstruction/cuda/CudaSurface.hpp>
+    typedef lvr2::CudaSurface GpuSurface;
+#elif defined OPENCL_FOUND
+    #define GPU_FOUND
+
+    #include <lvr2/reconstruction/opencl/ClSurface.hpp>
+    typedef lvr2::ClSurface GpuSurface;
+#endif
+
+namespace lvr_ros
+{
+
+using Vec = lvr2::BaseVector<float>;
+using PointBufferPtr = lvr2::PointBufferPtr;
+
+/// Guards the static surface of lvr2::BilinearFastBox, PMC grids of concurrent reconstructions are serialized
+static std::mutex box_surface_mutex;
+
+/**
+ * Interpolates the "intensity" channel of the point buffer at the vertices of the mesh buffer with inverse
+ * distance weighting of the k nearest points, and adds it to the mesh buffer as "intensity" channel.
+ */
+static void transferPointIntensities(
+    const PointBufferPtr& point_buffer,
+    const lvr2::PointsetSurfacePtr<Vec>& surface,
+    const lvr2::MeshBufferPtr& mesh_buffer,
+    int k
+)
+{
+    size_t num_intensities;
+    unsigned width;
+    lvr2::floatArr intensities = point_buffer->getFloatArray("intensity", num_intensities, width);
+    const size_t num_points = std::min<size_t>(num_intensities, point_buffer->numPoints());
+    const size_t num_vertices = mesh_buffer->numVertices();
+    if (!intensities || width != 1 || num_points == 0 || num_vertices == 0 || k < 1)
+    {
+        return;
+    }
+
+    const auto search_tree = surface->searchTree();
+    const lvr2::floatArr points = point_buffer->getPointArray();
+    const lvr2::floatArr vertices = mesh_buffer->getVertices();
+    lvr2::floatArr vertex_intensities(new float[num_vertices]);
+
+    // Every thread reuses its neighbor buffers for a block of vertices
+    #pragma omp parallel
+    {
+        LVR_ROS_TRACE_SPAN(thread_span, "intensity_thread");
+        std::vector<size_t> neighbors;
+        std::vector<float> distances;
+
+        #pragma omp for schedule(dynamic, 1024)
+        for (size_t i = 0; i < num_vertices; i++)
+        {
+            const Vec vertex(vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]);
+            neighbors.clear();
+            distances.clear();
+            search_tree->kSearch(vertex, k, neighbors, distances);
+
+            double weight_sum = 0;
+            double intensity_sum = 0;
+            for (const size_t index : neighbors)
+            {
+                if (index >= num_points || !std::isfinite(intensities[index]))
+                {
+                    continue;
+                }
+                const float* point = &points[3 * index];
+                const Vec offset = Vec(point[0], point[1], point[2]) - vertex;
+                const double weight = 1.0 / (offset.length() + 1e-6);
+                weight_sum += weight;
+                intensity_sum += weight * intensities[index];
+            }
+            vertex_intensities[i] = weight_sum > 0
+                ? static_cast<float>(intensity_sum / weight_sum)
+                : std::numeric_limits<float>::quiet_NaN();
+        }
+    }
+    mesh_buffer->addFloatChannel(vertex_intensities, "intensity", num_vertices, 1);
+}
+
+bool reconstructMeshBuffer(
+    const ReconstructionConfig& config,
+    PointBufferPtr& point_buffer,
+    lvr2::MeshBufferPtr& mesh_buffer,
+    const ReconstructionStageCallback& stage,
+    const lvr2::BoundingBox<Vec>& grid_bounds
+)
+{
+    LVR_ROS_TRACE_SPAN(span, "reconstruct_mesh_buffer");
+    LVR_ROS_TRACE_ARG(span, "points", point_buffer->numPoints());
+
+    // Spans of the stages end with the begin of the next stage or with the pipeline
+#ifdef LVR_ROS_TRACING
+    std::unique_ptr<TraceSpan> stage_span;
+#endif
+    auto beginStage = [&](const char* name)
+    {
+#ifdef LVR_ROS_TRACING
+        stage_span.reset();
+        stage_span.reset(new TraceSpan(name));
+#endif
+        if (stage)
+        {
+            stage(name);
+        }
+    };
+
+    // Create a point cloud manager
+    beginStage("surface");
+    std::string pcm_name = config.pcm;
+    lvr2::PointsetSurfacePtr<Vec> surface;
+    bool use_gpu = config.useGPU;
+
+    // Create point set surface object
+    if (pcm_name == "PCL")
+    {
+        lvr2::panic("PCL not supported right now!");
+    }
+    else if (
+        pcm_name == "STANN" ||
+        pcm_name == "FLANN" ||
+        pcm_name == "NABO" ||
+        pcm_name == "NANOFLANN"
+        )
+    {
+        surface = std::make_shared < lvr2::AdaptiveKSearchSurface < Vec >> (
+            point_buffer,
+            pcm_name,
+            config.kn,
+            config.ki,
+            config.kd,
+            config.ransac
+        );
+    }
+    else
+    {
+        ROS_ERROR_STREAM("Unable to create PointCloudManager.");
+        ROS_ERROR_STREAM("Unknown option '" << pcm_name << "'.");
+        ROS_ERROR_STREAM("Available PCMs are: ");
+        ROS_ERROR_STREAM("STANN, STANN_RANSAC, PCL");
+        return 0;
+    }
+
+    // Set search config for normal estimation and distance evaluation
+    surface->setKd(config.kd);
+    surface->setKi(config.ki);
+    surface->setKn(config.kn);
+
+    // Calculate normals if necessary
+    beginStage("normals");
+    if (!point_buffer->hasNormals() || config.recalcNormals)
+    {
+        if(use_gpu){
+            #ifdef GPU_FOUND
+                size_t num_points = point_buffer->numPoints();
+                lvr2::floatArr points = point_buffer->getPointArray();
+                lvr2::floatArr normals = lvr2::floatArr(new float[ num_points * 3 ]);
+                ROS_INFO_STREAM("Generate GPU kd-tree...");
+                GpuSurface gpu_surface(points, num_points);
+                ROS_INFO_STREAM("GPU kd-tree done.");
+
+                gpu_surface.setKn(config.kn);
+                gpu_surface.setKi(config.ki);
+                gpu_surface.setFlippoint(config.flipx, config.flipy, config.flipz);
+                ROS_INFO_STREAM("Start normal calculation...");
+                gpu_surface.calculateNormals();
+                gpu_surface.getNormals(normals);
+                ROS_INFO_STREAM("Normal computation done.");
+
+                point_buffer->setNormalArray(normals, num_points * 3);
+                gpu_surface.freeGPU();
+            #else
+                ROS_ERROR("\"use_gpu\" is active, but GPU driver not installed!");
+                surface->calculateSurfaceNormals();
+            #endif
+        }
+        else
+        {
+            surface->calculateSurfaceNormals();
+        }
+    }
+    else
+    {
+        ROS_INFO_STREAM("Using given normals.");
+    }
+
+    // Create an empty mesh
+    lvr2::HalfEdgeMesh <Vec> mesh;
+
+    // Determine whether to use the face budget, intersections or voxelsize, the occupancy pass belongs to the grid
+    beginStage("grid");
+    float resolution;
+    bool useVoxelsize;
+    if (config.targetFaces > 0 && point_buffer->numPoints() > 0)
+    {
+        resolution = voxelsizeForTargetFaces(
+            point_buffer->getPointArray().get(),
+            point_buffer->numPoints(),
+            config.targetFaces
+        );
+        useVoxelsize = true;
+        ROS_INFO_STREAM("Voxel size " << resolution << " for about " << config.targetFaces << " faces.");
+    }
+    else if (config.intersections > 0)
+    {
+        resolution = config.intersections;
+        useVoxelsize = false;
+    }
+    else
+    {
+        resolution = config.voxelsize;
+        useVoxelsize = true;
+    }
+
+    // Create a point set grid for reconstruction
+    std::string decomposition = config.decomposition;
+
+    // Fail safe check
+    if (decomposition != "MC" && decomposition != "PMC" && decomposition != "SF")
+    {
+        ROS_ERROR_STREAM("Unsupported decomposition type " << decomposition << ". Defaulting to PMC.");
+        decomposition = "PMC";
+    }
+
+    std::shared_ptr <lvr2::GridBase> grid;
+    std::unique_ptr <lvr2::FastReconstructionBase<Vec>> reconstruction;
+    std::unique_lock<std::mutex> box_lock(box_surface_mutex, std::defer_lock);
+    if (decomposition == "MC")
+    {
+        lvr2::panic("MC decomposition type not supported right now!");
+    }
+    else if (decomposition == "PMC")
+    {
+        // The boxes of all grids share one static surface, it must not change until the mesh is extracted
+        box_lock.lock();
+        lvr2::BilinearFastBox<Vec>::m_surface = surface;
+        auto ps_grid = std::make_shared<lvr2::PointsetGrid<Vec, lvr2::BilinearFastBox<Vec>>>(
+            resolution,
+            surface,
+            grid_bounds.isValid() ? grid_bounds : surface->getBoundingBox(),
+            useVoxelsize,
+            !config.noExtrusion
+        );
+        ps_grid->calcDistanceValues();
+        grid = ps_grid;
+        reconstruction = std::make_unique<lvr2::FastReconstruction<Vec, lvr2::BilinearFastBox<Vec>>>(ps_grid);
+    }
+    else if (decomposition == "SF")
+    {
+        lvr2::panic("SF decomposition type not supported right now!");
+    }
+
+    // Create mesh
+    beginStage("marching_cubes");
+    reconstruction->getMesh(mesh);
+    if (box_lock.owns_lock())
+    {
+        box_lock.unlock();
+    }
+
+
+    // =======================================================================
+    // Optimize and finalize mesh
+    // =======================================================================
+    beginStage("cleanup");
+    if(config.rda != 0)
+    {
+        removeDanglingCluster(mesh, static_cast<size_t>(config.rda));
+    }
+
+    // Magic number from lvr1 `cleanContours`...
+    cleanContours(mesh, config.cleanContours, 0.0001);
+
+    naiveFillSmallHoles(mesh, static_cast<size_t>(config.fillHoles), false);
+
+    beginStage("planes");
+    auto faceNormals = calcFaceNormals(mesh);
+
+    lvr2::ClusterBiMap <lvr2::FaceHandle> clusterBiMap;
+    if (config.optimizePlanes)
+    {
+        clusterBiMap = iterativePlanarClusterGrowing(
+            mesh,
+            faceNormals,
+            config.pnt,
+            config.planeIterations,
+            config.mp
+        );
+
+        if (config.smallRegionThreshold > 0)
+        {
+            deleteSmallPlanarCluster(
+                mesh,
+                clusterBiMap,
+                static_cast<size_t>(config.smallRegionThreshold)
+            );
+        }
+    }
+    else
+    {
+        clusterBiMap = planarClusterGrowing(mesh, faceNormals, config.pnt);
+    }
+
+    // Calc normaBaseVecTls for vertices
+    beginStage("vertex_normals");
+    auto vertexNormals = calcVertexNormals(mesh, faceNormals, *surface);
+
+    // Prepare color data for finalizing
+    beginStage("colors");
+    auto vertexColors = calcColorFromPointCloud(mesh, surface);
+
+    // When using textures ...
+    beginStage("finalize");
+    if (config.generateTextures)
+    {
+        // Prepare finalize algorithm
+        lvr2::TextureFinalizer<Vec> finalize(clusterBiMap);
+        finalize.setVertexNormals(vertexNormals);
+        if (vertexColors)
+        {
+            finalize.setVertexColors(*vertexColors);
+        }
+
+        // Materializer for face materials (colors and/or textures)
+        lvr2::Materializer<Vec> materializer(
+            mesh,
+            clusterBiMap,
+            faceNormals,
+            *surface
+        );
+
+        // Set texturizer
+        lvr2::Texturizer<Vec> texturizer(
+            config.texelSize,
+            config.texMinClusterSize,
+            config.texMaxClusterSize
+        );
+        materializer.setTexturizer(texturizer);
+
+        // Generate materials
+        lvr2::MaterializerResult<Vec> matResult = materializer.generateMaterials();
+        // Add data to finalize algorithm
+        finalize.setMaterializerResult(matResult);
+
+        mesh_buffer = finalize.apply(mesh);
+    }
+    else
+    {
+        // Finalize mesh (convert it to simple `MeshBuffer`)
+        lvr2::SimpleFinalizer<Vec> finalize;
+        finalize.setNormalData(vertexNormals);
+        mesh_buffer = finalize.apply(mesh);
+    }
+
+    // Sensor intensities are kept per vertex for classification
+    beginStage("intensity");
+    transferPointIntensities(point_buffer, surface, mesh_buffer, config.intensityNeighbors);
+
+    LVR_ROS_TRACE_ARG(span, "vertices", mesh_buffer->numVertices());
+    LVR_ROS_TRACE_ARG(span, "faces", mesh_buffer->numFaces());
+
+    ROS_INFO_STREAM("Reconstruction finished!");
+    return true;
+}
+
+bool postProcessMeshBuffer(
+    const ReconstructionConfig& config,
+    const PostProcessGoal& goal,
+    lvr2::MeshBufferPtr& mesh_buffer
+)
+{
+    const size_t num_vertices = mesh_buffer->numVertices();
+    const size_t num_faces = mesh_buffer->numFaces();
+    lvr2::floatArr vertices = mesh_buffer->getVertices();
+    lvr2::indexArray faces = mesh_buffer->getFaceIndices();
+    if (num_vertices == 0 || num_faces == 0 || !vertices || !faces)
+    {
+        ROS_ERROR_STREAM("Can not post process an empty mesh!");
+        return false;
+    }
+
+    // Build the half-edge mesh, faces which would make it non-manifold are skipped
+    lvr2::HalfEdgeMesh <Vec> mesh;
+    std::vector<lvr2::VertexHandle> handles;
+    handles.reserve(num_vertices);
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        handles.push_back(mesh.addVertex(Vec(vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2])));
+    }
+
+    size_t num_skipped = 0;
+    for (size_t i = 0; i < num_faces; i++)
+    {
+        const unsigned int a = faces[3 * i], b = faces[3 * i + 1], c = faces[3 * i + 2];
+        if (a >= num_vertices || b >= num_vertices || c >= num_vertices || a == b || b == c || a == c
+            || !mesh.isFaceInsertionValid(handles[a], handles[b], handles[c]))
+        {
+            num_skipped++;
+            continue;
+        }
+        mesh.addFace(handles[a], handles[b], handles[c]);
+    }
+    if (num_skipped > 0)
+    {
+        ROS_WARN_STREAM("Skipped " << num_skipped << " degenerate or non-manifold faces.");
+    }
+
+    // Intensities follow their vertex handles through the steps
+    size_t num_intensities;
+    unsigned intensity_width;
+    const lvr2::floatArr intensities = mesh_buffer->getFloatArray("intensity", num_intensities, intensity_width);
+    const bool has_intensities = intensities && intensity_width == 1 && num_intensities == num_vertices;
+    lvr2::DenseVertexMap<float> vertex_intensities;
+    if (has_intensities)
+    {
+        for (size_t i = 0; i < num_vertices; i++)
+        {
+            vertex_intensities.insert(handles[i], intensities[i]);
+        }
+    }
+
+    // The same optimization steps as in the reconstruction
+    if (goal.remove_dangling_clusters && config.rda != 0)
+    {
+        removeDanglingCluster(mesh, static_cast<size_t>(config.rda));
+    }
+
+    if (goal.clean_contours)
+    {
+        cleanContours(mesh, config.cleanContours, 0.0001);
+    }
+
+    if (goal.fill_holes)
+    {
+        naiveFillSmallHoles(mesh, static_cast<size_t>(config.fillHoles), false);
+    }
+
+    auto faceNormals = calcFaceNormals(mesh);
+
+    if (goal.reduction_ratio > 0)
+    {
+        // Every edge collapse removes two faces
+        const float ratio = std::min(goal.reduction_ratio, 1.0f);
+        const size_t count = static_cast<size_t>((mesh.numFaces() / 2) * ratio);
+        const size_t num_collapsed = simpleMeshReduction(mesh, count, faceNormals);
+        ROS_INFO_STREAM("Collapsed " << num_collapsed << " edges.");
+    }
+
+    if (goal.optimize_planes)
+    {
+        lvr2::ClusterBiMap <lvr2::FaceHandle> clusterBiMap = iterativePlanarClusterGrowing(
+            mesh,
+            faceNormals,
+            config.pnt,
+            config.planeIterations,
+            config.mp
+        );
+
+        if (config.smallRegionThreshold > 0)
+        {
+            deleteSmallPlanarCluster(
+                mesh,
+                clusterBiMap,
+                static_cast<size_t>(config.smallRegionThreshold)
+            );
+        }
+    }
+
+    // Without a point cloud, the vertex normals are interpolated from the faces
+    auto vertexNormals = calcVertexNormals(mesh, faceNormals);
+    lvr2::SimpleFinalizer<Vec> finalize;
+    finalize.setNormalData(vertexNormals);
+    mesh_buffer = finalize.apply(mesh);
+
+    // The finalizer writes the remaining vertices in the order of their handles
+    if (has_intensities && mesh_buffer->numVertices() == mesh.numVertices())
+    {
+        lvr2::floatArr kept_intensities(new float[mesh.numVertices()]);
+        size_t index = 0;
+        for (const auto vertex : mesh.vertices())
+        {
+            kept_intensities[index++] = vertex_intensities[vertex];
+        }
+        mesh_buffer->addFloatChannel(kept_intensities, "intensity", mesh.numVertices(), 1);
+    }
+
+    ROS_INFO_STREAM("Post processing finished!");
+    return true;
+}
+
+/// Removes leading and trailing white space
+static std::string trim(const std::string& text)
+{
+    const size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos)
+    {
+        return "";
+    }
+    return text.substr(begin, text.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+/// Removes matching single or double quotes around a value
+static std::string unquote(const std::string& value)
+{
+    if (value.size() >= 2 && (value.front() == '"' || value.front() == '\'') && value.back() == value.front())
+    {
+        return value.substr(1, value.size() - 2);
+    }
+    return value;
+}
+
+bool setReconstructionParameter(ReconstructionConfig& config, const std::string& name, const std::string& value)
+{
+    for (const auto& description : ReconstructionConfig::__getParamDescriptions__())
+    {
+        if (description->name != name)
+        {
+            continue;
+        }
+
+        // Go through a config message, so the generated code assigns the matching member
+        dynamic_reconfigure::Config message;
+        size_t parsed = 0;
+        try
+        {
+            if (description->type == "int")
+            {
+                dynamic_reconfigure::ConfigTools::appendParameter(message, name, std::stoi(value, &parsed));
+            }
+            else if (description->type == "double")
+            {
+                dynamic_reconfigure::ConfigTools::appendParameter(message, name, std::stod(value, &parsed));
+            }
+            else if (description->type == "bool")
+            {
+                std::string lower = value;
+                for (char& c : lower)
+                {
+                    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                }
+                if (lower != "true" && lower != "false" && lower != "1" && lower != "0")
+                {
+                    return false;
+                }
+                dynamic_reconfigure::ConfigTools::appendParameter(message, name, lower == "true" || lower == "1");
+                parsed = value.size();
+            }
+            else
+            {
+                dynamic_reconfigure::ConfigTools::appendParameter(message, name, unquote(value));
+                parsed = value.size();
+            }
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+        if (parsed != value.size())
+        {
+            return false;
+        }
+
+        description->fromMessage(message, config);
+        config.__clamp__();
+        return true;
+    }
+    return false;
+}
+
+bool loadReconstructionConfig(const std::string& filename, ReconstructionConfig& config)
+{
+    std::ifstream file(filename);
+    if (!file)
+    {
+        ROS_ERROR_STREAM("Could not open parameter file \"" << filename << "\"!");
+        return false;
+    }
+
+    config = ReconstructionConfig::__getDefault__();
+    std::string line;
+    while (std::getline(file, line))
+    {
+        // Cut off comments outside of quoted values
+        char quote = 0;
+        for (size_t i = 0; i < line.size(); i++)
+        {
+            if (quote && line[i] == quote)
+            {
+                quote = 0;
+            }
+            else if (!quote && (line[i] == '"' || line[i] == '\''))
+            {
+                quote = line[i];
+            }
+            else if (!quote && line[i] == '#')
+            {
+                line.resize(i);
+                break;
+            }
+        }
+
+        const size_t colon = line.find(':');
+        if (colon == std::string::npos)
+        {
+            continue;
+        }
+        const std::string name = trim(line.substr(0, colon));
+        const std::string value = trim(line.substr(colon + 1));
+        if (!setReconstructionParameter(config, name, value))
+        {
+            ROS_WARN_STREAM("Skipping parameter \"" << name << "\" with value \"" << value << "\" from \""
+                << filename << "\".");
+        }
+    }
+    return true;
+}
+
+} // namespace lvr_ros
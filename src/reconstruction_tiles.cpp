@@ -0,0 +1,174 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_tiles.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+#include "lvr_ros/reconstruction_tiles.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace lvr_ros
+{
+
+/// Bisects the points of the range until every part is a tile
+static void splitTiles(
+    const float* points,
+    std::vector<uint32_t>::iterator begin,
+    std::vector<uint32_t>::iterator end,
+    size_t num_tiles,
+    ReconstructionTile bounds,
+    std::vector<ReconstructionTile>& tiles
+)
+{
+    if (num_tiles <= 1 || end - begin < 2)
+    {
+        tiles.push_back(bounds);
+        return;
+    }
+
+    float min[3], max[3];
+    std::fill(min, min + 3, std::numeric_limits<float>::max());
+    std::fill(max, max + 3, std::numeric_limits<float>::lowest());
+    for (auto it = begin; it != end; ++it)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            min[axis] = std::min(min[axis], points[3 * *it + axis]);
+            max[axis] = std::max(max[axis], points[3 * *it + axis]);
+        }
+    }
+    int axis = 0;
+    for (int i = 1; i < 3; i++)
+    {
+        if (max[i] - min[i] > max[axis] - min[axis])
+        {
+            axis = i;
+        }
+    }
+
+    // The point counts of both halves are proportional to their number of tiles
+    const size_t left_tiles = num_tiles / 2;
+    const auto middle = begin + (end - begin) * left_tiles / num_tiles;
+    std::nth_element(begin, middle, end, [&](uint32_t a, uint32_t b)
+    {
+        return points[3 * a + axis] < points[3 * b + axis];
+    });
+    const float split = points[3 * *middle + axis];
+
+    ReconstructionTile left = bounds, right = bounds;
+    left.max[axis] = split;
+    right.min[axis] = split;
+    splitTiles(points, begin, middle, left_tiles, left, tiles);
+    splitTiles(points, middle, end, num_tiles - left_tiles, right, tiles);
+}
+
+void partitionPoints(
+    const float* points,
+    size_t num_points,
+    size_t num_tiles,
+    float overlap,
+    std::vector<ReconstructionTile>& tiles
+)
+{
+    tiles.clear();
+    std::vector<uint32_t> order(num_points);
+    std::iota(order.begin(), order.end(), 0);
+
+    ReconstructionTile everything;
+    std::fill(everything.min, everything.min + 3, -std::numeric_limits<float>::infinity());
+    std::fill(everything.max, everything.max + 3, std::numeric_limits<float>::infinity());
+    splitTiles(points, order.begin(), order.end(), std::max<size_t>(num_tiles, 1), everything, tiles);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t t = 0; t < tiles.size(); t++)
+    {
+        ReconstructionTile& tile = tiles[t];
+        for (size_t i = 0; i < num_points; i++)
+        {
+            const float* point = &points[3 * i];
+            if (point[0] >= tile.min[0] - overlap && point[0] < tile.max[0] + overlap
+                && point[1] >= tile.min[1] - overlap && point[1] < tile.max[1] + overlap
+                && point[2] >= tile.min[2] - overlap && point[2] < tile.max[2] + overlap)
+            {
+                tile.point_indices.push_back(static_cast<uint32_t>(i));
+            }
+        }
+    }
+}
+
+void cropTileMesh(
+    const ReconstructionTile& tile,
+    const float* vertices,
+    const float* normals,
+    const float* intensities,
+    size_t num_vertices,
+    const unsigned int* faces,
+    size_t num_faces,
+    TileMesh& mesh
+)
+{
+    mesh = TileMesh();
+    std::vector<uint32_t> remap(num_vertices, std::numeric_limits<uint32_t>::max());
+    for (size_t f = 0; f < num_faces; f++)
+    {
+        const unsigned int* face = &faces[3 * f];
+        if (face[0] >= num_vertices || face[1] >= num_vertices || face[2] >= num_vertices)
+        {
+            continue;
+        }
+
+        bool inside = true;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const float centroid = (vertices[3 * face[0] + axis] + vertices[3 * face[1] + axis]
+                + vertices[3 * face[2] + axis]) / 3;
+            inside &= centroid >= tile.min[axis] && centroid < tile.max[axis];
+        }
+        if (!inside)
+        {
+            continue;
+        }
+
+        for (int k = 0; k < 3; k++)
+        {
+            const unsigned int v = face[k];
+            if (remap[v] == std::numeric_limits<uint32_t>::max())
+            {
+                remap[v] = static_cast<uint32_t>(mesh.vertices.size() / 3);
+                mesh.vertices.insert(mesh.vertices.end(), &vertices[3 * v], &vertices[3 * v + 3]);
+                if (normals)
+                {
+                    mesh.normals.insert(mesh.normals.end(), &normals[3 * v], &normals[3 * v + 3]);
+                }
+                if (intensities)
+                {
+                    mesh.intensities.push_back(intensities[v]);
+                }
+            }
+            mesh.faces.push_back(remap[v]);
+        }
+    }
+}
+
+} // namespace lvr_ros
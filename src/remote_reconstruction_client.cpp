@@ -0,0 +1,169 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * remote_reconstruction_client.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#include <algorithm>
+
+#include "lvr_ros/remote_reconstruction_client.h"
+#include "lvr_ros/conversions.h"
+
+namespace lvr_ros
+{
+
+/**********************************************************************************************************************/
+// Constructor
+
+RemoteReconstructionClient::RemoteReconstructionClient()
+    : action_client(node_handle, "reconstruct_batch", false)
+{
+    ros::NodeHandle nh("~");
+    nh.param<int>("numClouds", num_clouds, 1);
+    nh.param<int>("compressionLevel", compression_level, 3);
+    nh.param<int>("maxPendingBatches", max_pending_batches, 2);
+    num_clouds = std::max(num_clouds, 1);
+    max_pending_batches = std::max(max_pending_batches, 1);
+
+    current_batch.clouds.reserve(num_clouds);
+    uuid_publisher = node_handle.advertise<std_msgs::String>("mesh_uuid", 10);
+    cloud_subscriber = node_handle.subscribe(
+        "/pointcloud",
+        num_clouds,
+        &RemoteReconstructionClient::pointCloudCallback,
+        this
+    );
+    retry_timer = node_handle.createTimer(ros::Duration(1.0), &RemoteReconstructionClient::retryCallback, this);
+    ROS_INFO_STREAM("Send batches of " << num_clouds << " point clouds to the remote reconstruction.");
+}
+
+/**********************************************************************************************************************/
+// Callbacks
+
+void RemoteReconstructionClient::pointCloudCallback(const sensor_msgs::PointCloud2::ConstPtr& cloud)
+{
+    // Clouds are compressed as they arrive, so that the batch is sent without delay once it is complete
+    current_batch.clouds.emplace_back();
+    if (!fromPointCloud2ToCompressedPointCloud(*cloud, current_batch.clouds.back(), compression_level))
+    {
+        ROS_ERROR_STREAM("Could not compress the point cloud, it is skipped.");
+        current_batch.clouds.pop_back();
+        return;
+    }
+    if (current_batch.clouds.size() < static_cast<size_t>(num_clouds))
+    {
+        return;
+    }
+
+    if (pending_batches.size() >= static_cast<size_t>(max_pending_batches))
+    {
+        ROS_WARN_STREAM("The remote reconstruction can not keep up, drop the oldest pending batch.");
+        pending_batches.pop_front();
+    }
+    pending_batches.push_back(lvr_ros::ReconstructBatchGoal());
+    pending_batches.back().clouds.swap(current_batch.clouds);
+    current_batch.clouds.reserve(num_clouds);
+    sendNextBatch();
+}
+
+void RemoteReconstructionClient::batchDone(
+    const actionlib::SimpleClientGoalState& state,
+    const lvr_ros::ReconstructBatchResultConstPtr& result
+)
+{
+    batch_active = false;
+    const size_t num_meshes = result ? std::count_if(
+        result->uuids.begin(),
+        result->uuids.end(),
+        [](const std::string& uuid) { return !uuid.empty(); }
+    ) : 0;
+    ROS_INFO_STREAM("Remote reconstruction finished with state " << state.toString() << ": "
+        << num_meshes << " meshes in " << (ros::WallTime::now() - batch_start).toSec() << " s.");
+    sendNextBatch();
+}
+
+void RemoteReconstructionClient::batchFeedback(const lvr_ros::ReconstructBatchFeedbackConstPtr& feedback)
+{
+    if (feedback->uuid.empty())
+    {
+        ROS_WARN_STREAM("Remote reconstruction of cloud " << feedback->completed << " failed.");
+        return;
+    }
+    ROS_INFO_STREAM("Remote reconstruction of cloud " << feedback->completed << ": " << feedback->uuid);
+    std_msgs::String uuid;
+    uuid.data = feedback->uuid;
+    uuid_publisher.publish(uuid);
+}
+
+void RemoteReconstructionClient::retryCallback(const ros::TimerEvent& event)
+{
+    sendNextBatch();
+}
+
+/**********************************************************************************************************************/
+// Sending
+
+void RemoteReconstructionClient::sendNextBatch()
+{
+    if (batch_active || pending_batches.empty())
+    {
+        return;
+    }
+    if (!action_client.isServerConnected())
+    {
+        ROS_WARN_STREAM_THROTTLE(5.0, "The remote reconstruction is not available, keep "
+            << pending_batches.size() << " batches pending.");
+        return;
+    }
+
+    // A new goal would preempt the active one, so only one batch is sent at a time
+    size_t num_bytes = 0;
+    for (const auto& cloud : pending_batches.front().clouds)
+    {
+        num_bytes += cloud.data.size();
+    }
+    ROS_INFO_STREAM("Send batch of " << pending_batches.front().clouds.size() << " point clouds with "
+        << num_bytes / 1024 << " KiB.");
+
+    batch_active = true;
+    batch_start = ros::WallTime::now();
+    action_client.sendGoal(
+        pending_batches.front(),
+        boost::bind(&RemoteReconstructionClient::batchDone, this, _1, _2),
+        BatchActionClient::SimpleActiveCallback(),
+        boost::bind(&RemoteReconstructionClient::batchFeedback, this, _1)
+    );
+    pending_batches.pop_front();
+}
+
+} // namespace lvr_ros
+
+
+int main(int argc, char **args)
+{
+    ros::init(argc, args, "remote_reconstruction_client");
+    lvr_ros::RemoteReconstructionClient client;
+
+    // A single thread serves the clouds and the action client, see RemoteReconstructionClient
+    ros::spin();
+    return 0;
+}
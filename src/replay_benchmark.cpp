@@ -0,0 +1,456 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * replay_benchmark.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+
+#include <ros/console.h>
+#include <ros/package.h>
+#include <ros/time.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include "lvr_ros/conversions.h"
+#include "lvr_ros/mesh_cache.h"
+#include "lvr_ros/organized_mesh.h"
+#include "lvr_ros/reconstruction_pipeline.h"
+#include "lvr_ros/trace.h"
+#include "lvr_ros/vertex_costs.h"
+
+/*
+ * Replays the point clouds of a bag through the /pointcloud -> /mesh_geometry path of the reconstruction node
+ * in-process and reports latency, drops and queue depths as JSON.
+ *
+ * Usage: replay_benchmark <cloud.bag> [options]
+ *
+ *   --topic <topic>          Point cloud topic, all point clouds of the bag otherwise
+ *   --config <file>          Parameter file, defaults to config/lvr_params.yaml of this package
+ *   --set <name>=<value>     Overrides a parameter of the file, can be given multiple times
+ *   --rate <hz>              Feeds the clouds at a fixed rate
+ *   --speed <factor>         Feeds the clouds with the timing of the bag, scaled by the factor (default 1)
+ *   --fast                   Feeds the next cloud as soon as the queue has space, nothing is dropped
+ *   --queue <n>              Size of the cloud queue, 1 like the subscriber of the node
+ *   --loop <n>               Replays the bag n times
+ *   --output <file>          Writes the JSON report to the file instead of stdout
+ *
+ * A cloud which arrives at a full queue replaces the oldest queued cloud, which counts as dropped, as with a
+ * ROS subscriber. The latency of a cloud is the time from its arrival until the mesh messages are ready for
+ * publishing, including the time it waited in the queue.
+ */
+
+using Clock = std::chrono::steady_clock;
+
+struct QueuedCloud
+{
+    sensor_msgs::PointCloud2::ConstPtr cloud;
+    Clock::time_point arrival;
+};
+
+/// Bounded queue between the feeding and the reconstruction thread
+class CloudQueue
+{
+public:
+    explicit CloudQueue(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {}
+
+    /// Adds the cloud, drops the oldest one or waits for space if the queue is full, returns the queue depth
+    size_t push(QueuedCloud cloud, bool wait)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (wait)
+        {
+            not_full.wait(lock, [this] { return clouds.size() < capacity; });
+        }
+        else if (clouds.size() == capacity)
+        {
+            clouds.pop_front();
+            num_dropped++;
+        }
+        clouds.push_back(std::move(cloud));
+        const size_t depth = clouds.size();
+        max_depth = std::max(max_depth, depth);
+        depth_sum += depth;
+        num_pushed++;
+        not_empty.notify_one();
+        return depth;
+    }
+
+    /// Takes the oldest cloud, returns false once the queue is closed and empty
+    bool pop(QueuedCloud& cloud)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return !clouds.empty() || closed; });
+        if (clouds.empty())
+        {
+            return false;
+        }
+        cloud = std::move(clouds.front());
+        clouds.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+    }
+
+    size_t numDropped() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return num_dropped;
+    }
+
+    size_t maxDepth() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return max_depth;
+    }
+
+    /// Mean depth of the queue right after the arrival of a cloud
+    double meanDepth() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return num_pushed ? static_cast<double>(depth_sum) / num_pushed : 0;
+    }
+
+private:
+    const size_t capacity;
+    mutable std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<QueuedCloud> clouds;
+    bool closed = false;
+    size_t num_dropped = 0;
+    size_t num_pushed = 0;
+    size_t max_depth = 0;
+    size_t depth_sum = 0;
+};
+
+/**
+ * The work of the point cloud callback of the node up to publishing: reconstruction, conversion to the mesh
+ * messages and the eagerly computed data of the cache entry.
+ */
+static bool processCloud(const lvr_ros::ReconstructionConfig& config, const sensor_msgs::PointCloud2& cloud)
+{
+    lvr2::MeshBufferPtr mesh_buffer;
+    if (config.organizedClouds && cloud.height > 1)
+    {
+        mesh_buffer.reset(new lvr2::MeshBuffer);
+        if (!lvr_ros::organizedCloudToMeshBuffer(
+            cloud,
+            *mesh_buffer,
+            config.organizedMaxDepthJump,
+            config.organizedNormalWindow
+        ))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        lvr2::PointBufferPtr point_buffer(new lvr2::PointBuffer);
+        if (!lvr_ros::fromPointCloud2ToPointBuffer(cloud, *point_buffer)
+            || !lvr_ros::reconstructMeshBuffer(config, point_buffer, mesh_buffer))
+        {
+            return false;
+        }
+    }
+
+    auto entry = boost::make_shared<lvr_ros::MeshCacheEntry>();
+    if (!lvr_ros::fromMeshBufferToMeshMessages(
+            mesh_buffer,
+            entry->mesh_geometry_stamped.mesh_geometry,
+            entry->mesh_materials_stamped.mesh_materials,
+            entry->mesh_vertex_colors_stamped.mesh_vertex_colors,
+            entry->textures,
+            "replay"
+    ))
+    {
+        return false;
+    }
+    entry->mesh_geometry_stamped.header = cloud.header;
+    entry->bvh();
+    for (const std::string& layer : lvr_ros::parseVertexCostLayers(config.costLayers))
+    {
+        entry->vertexCosts(layer, config.costRadius);
+    }
+    return true;
+}
+
+/// Writes the nearest rank percentiles of the values in seconds as JSON object
+static void writePercentiles(std::ostream& json, std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    json << "{";
+    const std::vector<std::pair<const char*, double>> ranks = {{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"max", 1}};
+    for (size_t i = 0; i < ranks.size(); i++)
+    {
+        double value = 0;
+        if (!values.empty())
+        {
+            const size_t rank = static_cast<size_t>(std::ceil(ranks[i].second * values.size()));
+            value = values[std::min(values.size(), std::max<size_t>(rank, 1)) - 1];
+        }
+        json << (i ? ", " : "") << "\"" << ranks[i].first << "\": " << value;
+    }
+    json << "}";
+}
+
+int main(int argc, char **args)
+{
+    std::string input, topic, output;
+    std::string config_file = ros::package::getPath("lvr_ros") + "/config/lvr_params.yaml";
+    std::vector<std::pair<std::string, std::string>> overrides;
+    double rate = 0;
+    double speed = 1;
+    bool fast = false;
+    size_t queue_size = 1;
+    int loops = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = args[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--topic" && has_value)
+        {
+            topic = args[++i];
+        }
+        else if (arg == "--config" && has_value)
+        {
+            config_file = args[++i];
+        }
+        else if (arg == "--set" && has_value)
+        {
+            const std::string assignment = args[++i];
+            const size_t equals = assignment.find('=');
+            if (equals == std::string::npos || equals == 0)
+            {
+                std::cerr << "Expected <name>=<value>, got \"" << assignment << "\"!" << std::endl;
+                return 1;
+            }
+            overrides.emplace_back(assignment.substr(0, equals), assignment.substr(equals + 1));
+        }
+        else if (arg == "--rate" && has_value)
+        {
+            rate = std::atof(args[++i]);
+        }
+        else if (arg == "--speed" && has_value)
+        {
+            speed = std::atof(args[++i]);
+        }
+        else if (arg == "--fast")
+        {
+            fast = true;
+        }
+        else if (arg == "--queue" && has_value)
+        {
+            queue_size = std::max(1, std::atoi(args[++i]));
+        }
+        else if (arg == "--loop" && has_value)
+        {
+            loops = std::max(1, std::atoi(args[++i]));
+        }
+        else if (arg == "--output" && has_value)
+        {
+            output = args[++i];
+        }
+        else if (input.empty() && arg.compare(0, 2, "--") != 0)
+        {
+            input = arg;
+        }
+        else
+        {
+            std::cerr << "Unknown or incomplete option \"" << arg << "\"!" << std::endl;
+            return 1;
+        }
+    }
+    if (input.empty() || (!fast && rate <= 0 && speed <= 0))
+    {
+        std::cerr << "Usage: replay_benchmark <cloud.bag> [--topic <topic>] [--config <file>] "
+            "[--set <name>=<value>] [--rate <hz> | --speed <factor> | --fast] [--queue <n>] [--loop <n>] "
+            "[--output <file>]" << std::endl;
+        return 1;
+    }
+
+    ros::Time::init();
+    if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Warn))
+    {
+        ros::console::notifyLoggerLevelsChanged();
+    }
+
+    lvr_ros::ReconstructionConfig config;
+    if (!lvr_ros::loadReconstructionConfig(config_file, config))
+    {
+        return 1;
+    }
+    for (const auto& parameter : overrides)
+    {
+        if (!lvr_ros::setReconstructionParameter(config, parameter.first, parameter.second))
+        {
+            std::cerr << "Invalid parameter " << parameter.first << "=" << parameter.second << "!" << std::endl;
+            return 1;
+        }
+    }
+
+    // The clouds are read up front, so reading the bag does not disturb the replay
+    std::vector<std::pair<ros::Time, sensor_msgs::PointCloud2::ConstPtr>> clouds;
+    {
+        rosbag::Bag bag(input, rosbag::bagmode::Read);
+        std::unique_ptr<rosbag::View> view = topic.empty()
+            ? std::unique_ptr<rosbag::View>(new rosbag::View(bag))
+            : std::unique_ptr<rosbag::View>(new rosbag::View(bag, rosbag::TopicQuery(topic)));
+        for (const rosbag::MessageInstance& message : *view)
+        {
+            sensor_msgs::PointCloud2::ConstPtr cloud = message.instantiate<sensor_msgs::PointCloud2>();
+            if (cloud)
+            {
+                clouds.emplace_back(message.getTime(), cloud);
+            }
+        }
+    }
+    if (clouds.empty())
+    {
+        std::cerr << "No point cloud found in \"" << input << "\"!" << std::endl;
+        return 1;
+    }
+
+    std::ofstream file;
+    if (!output.empty())
+    {
+        file.open(output);
+        if (!file)
+        {
+            std::cerr << "Could not open \"" << output << "\"!" << std::endl;
+            return 1;
+        }
+    }
+
+    // Keep stdout clean for the report, the progress output of the pipeline goes to stderr
+    std::streambuf* stdout_buffer = std::cout.rdbuf(std::cerr.rdbuf());
+
+    CloudQueue queue(queue_size);
+    std::vector<double> latencies, processing_times, waiting_times;
+    size_t num_failed = 0;
+    const Clock::time_point start = Clock::now();
+
+    std::thread reconstruction_thread([&]()
+    {
+        QueuedCloud queued;
+        while (queue.pop(queued))
+        {
+            const Clock::time_point begin = Clock::now();
+            if (!processCloud(config, *queued.cloud))
+            {
+                num_failed++;
+                continue;
+            }
+            const Clock::time_point end = Clock::now();
+            latencies.push_back(std::chrono::duration<double>(end - queued.arrival).count());
+            processing_times.push_back(std::chrono::duration<double>(end - begin).count());
+            waiting_times.push_back(std::chrono::duration<double>(begin - queued.arrival).count());
+        }
+    });
+
+    // Feed the clouds with the configured timing
+    size_t num_fed = 0;
+    Clock::duration loop_offset = Clock::duration::zero();
+    for (int loop = 0; loop < loops; loop++)
+    {
+        const Clock::time_point loop_start = start + loop_offset;
+        for (size_t i = 0; i < clouds.size(); i++)
+        {
+            if (!fast)
+            {
+                const double offset = rate > 0 ? i / rate : (clouds[i].first - clouds.front().first).toSec() / speed;
+                std::this_thread::sleep_until(
+                    loop_start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(offset))
+                );
+            }
+            queue.push({clouds[i].second, Clock::now()}, fast);
+            num_fed++;
+        }
+        // The next loop starts one cloud period after the last cloud
+        loop_offset = Clock::now() - start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(rate > 0 ? 1 / rate : 0)
+        );
+    }
+    queue.close();
+    reconstruction_thread.join();
+    const double duration = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::ostringstream json;
+    json << std::setprecision(6);
+    json << "{\"input\": " << lvr_ros::jsonString(input)
+        << ", \"config\": " << lvr_ros::jsonString(config_file)
+        << ", \"mode\": " << lvr_ros::jsonString(fast ? "fast" : rate > 0 ? "rate" : "bag")
+        << ", \"rate_hz\": " << rate
+        << ", \"speed\": " << speed
+        << ", \"queue_size\": " << queue_size
+        << ", \"clouds\": " << num_fed
+        << ", \"processed\": " << latencies.size()
+        << ", \"failed\": " << num_failed
+        << ", \"dropped\": " << queue.numDropped()
+        << ", \"duration_s\": " << duration
+        << ", \"input_rate_hz\": " << num_fed / duration
+        << ", \"sustained_rate_hz\": " << latencies.size() / duration
+        << ", \"max_queue_depth\": " << queue.maxDepth()
+        << ", \"mean_queue_depth\": " << queue.meanDepth()
+        << ", \"latency_s\": ";
+    writePercentiles(json, latencies);
+    json << ", \"processing_s\": ";
+    writePercentiles(json, processing_times);
+    json << ", \"queue_wait_s\": ";
+    writePercentiles(json, waiting_times);
+    json << ", \"overrides\": {";
+    for (size_t i = 0; i < overrides.size(); i++)
+    {
+        json << (i ? ", " : "") << lvr_ros::jsonString(overrides[i].first) << ": "
+            << lvr_ros::jsonString(overrides[i].second);
+    }
+    json << "}}" << std::endl;
+
+    std::cout.rdbuf(stdout_buffer);
+    (output.empty() ? std::cout : file) << json.str();
+    return 0;
+}
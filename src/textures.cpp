@@ -0,0 +1,370 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * textures.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#include "lvr_ros/textures.h"
+
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <ros/console.h>
+
+namespace lvr_ros
+{
+
+/// OpenCV type of a texture image, -1 for unsupported encodings
+static int imageType(const std::string& encoding)
+{
+    if (encoding == "mono8")
+    {
+        return CV_8UC1;
+    }
+    if (encoding == "rgb8" || encoding == "bgr8")
+    {
+        return CV_8UC3;
+    }
+    if (encoding == "rgba8" || encoding == "bgra8")
+    {
+        return CV_8UC4;
+    }
+    return -1;
+}
+
+/// Wraps the image data of a texture without copying it
+static cv::Mat imageMat(const sensor_msgs::Image& image)
+{
+    return cv::Mat(
+        image.height,
+        image.width,
+        imageType(image.encoding),
+        const_cast<uint8_t*>(image.data.data()),
+        image.step
+    );
+}
+
+bool packTextureAtlas(
+    const mesh_msgs::MeshGeometry& mesh_geometry,
+    mesh_msgs::MeshMaterials& mesh_materials,
+    std::vector<mesh_msgs::MeshTexture>& textures,
+    int page_size,
+    int padding
+)
+{
+    if (textures.empty())
+    {
+        return true;
+    }
+
+    const std::string encoding = textures[0].image.encoding;
+    const int type = imageType(encoding);
+    if (type < 0)
+    {
+        ROS_WARN_STREAM("Texture encoding \"" << encoding << "\" is not supported by the texture atlas!");
+        return false;
+    }
+    for (const auto& texture : textures)
+    {
+        if (texture.image.encoding != encoding)
+        {
+            ROS_WARN_STREAM("Textures of different encodings can not be packed into a texture atlas!");
+            return false;
+        }
+    }
+
+    const size_t num_vertices = mesh_geometry.vertices.size();
+    if (mesh_materials.vertex_tex_coords.size() != num_vertices)
+    {
+        ROS_WARN_STREAM("Texture coordinates are missing, can not create a texture atlas!");
+        return false;
+    }
+
+    // Texture of every vertex, texture coordinates can only be rewritten if it is unique
+    std::vector<int32_t> vertex_texture(num_vertices, -1);
+    for (size_t c = 0; c < mesh_materials.clusters.size() && c < mesh_materials.cluster_materials.size(); c++)
+    {
+        const uint32_t material_index = mesh_materials.cluster_materials[c];
+        if (material_index >= mesh_materials.materials.size())
+        {
+            continue;
+        }
+        const mesh_msgs::MeshMaterial& material = mesh_materials.materials[material_index];
+        if (!material.has_texture || material.texture_index >= textures.size())
+        {
+            continue;
+        }
+        const int32_t texture_index = static_cast<int32_t>(material.texture_index);
+        for (uint32_t face_index : mesh_materials.clusters[c].face_indices)
+        {
+            for (uint32_t vertex_index : mesh_geometry.faces[face_index].vertex_indices)
+            {
+                int32_t& current = vertex_texture[vertex_index];
+                if (current >= 0 && current != texture_index)
+                {
+                    ROS_WARN_STREAM("Vertices are shared between different textures, can not create a texture atlas!");
+                    return false;
+                }
+                current = texture_index;
+            }
+        }
+    }
+
+    struct Placement
+    {
+        size_t page;
+        int x, y;
+    };
+    struct Page
+    {
+        int width = 0, height = 0;
+    };
+
+    std::vector<size_t> order(textures.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&textures](size_t a, size_t b)
+    {
+        const auto& image_a = textures[a].image;
+        const auto& image_b = textures[b].image;
+        return image_a.height != image_b.height ? image_a.height > image_b.height : image_a.width > image_b.width;
+    });
+
+    // Shelf packing, every shelf is as high as its first texture
+    std::vector<Placement> placements(textures.size());
+    std::vector<Page> pages;
+    size_t shelf_page = 0;
+    int shelf_y = 0, shelf_height = 0, shelf_x = 0;
+    bool has_shelf_page = false;
+    for (size_t index : order)
+    {
+        const int width = static_cast<int>(textures[index].image.width) + 2 * padding;
+        const int height = static_cast<int>(textures[index].image.height) + 2 * padding;
+
+        if (width > page_size || height > page_size)
+        {
+            placements[index] = Placement{pages.size(), 0, 0};
+            pages.emplace_back();
+            pages.back().width = width;
+            pages.back().height = height;
+            continue;
+        }
+
+        if (has_shelf_page && shelf_x + width > page_size)
+        {
+            // Start a new shelf
+            shelf_y += shelf_height;
+            shelf_x = 0;
+            shelf_height = 0;
+        }
+        if (!has_shelf_page || shelf_y + height > page_size)
+        {
+            // Start a new page
+            shelf_page = pages.size();
+            pages.emplace_back();
+            has_shelf_page = true;
+            shelf_x = shelf_y = shelf_height = 0;
+        }
+
+        placements[index] = Placement{shelf_page, shelf_x, shelf_y};
+        shelf_x += width;
+        shelf_height = std::max(shelf_height, height);
+        pages[shelf_page].width = std::max(pages[shelf_page].width, shelf_x);
+        pages[shelf_page].height = std::max(pages[shelf_page].height, shelf_y + height);
+    }
+
+    std::vector<cv::Mat> page_images(pages.size());
+    for (size_t p = 0; p < pages.size(); p++)
+    {
+        page_images[p] = cv::Mat::zeros(pages[p].height, pages[p].width, type);
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+        const Placement& placement = placements[i];
+        const cv::Mat image = imageMat(textures[i].image);
+        cv::Mat target = page_images[placement.page](
+            cv::Rect(placement.x, placement.y, image.cols + 2 * padding, image.rows + 2 * padding)
+        );
+        cv::copyMakeBorder(image, target, padding, padding, padding, padding, cv::BORDER_REPLICATE);
+    }
+
+    // Texture coordinates relative to the pages
+    #pragma omp parallel for
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        const int32_t texture_index = vertex_texture[i];
+        if (texture_index < 0)
+        {
+            continue;
+        }
+        const Placement& placement = placements[texture_index];
+        const Page& page = pages[placement.page];
+        const sensor_msgs::Image& image = textures[texture_index].image;
+        mesh_msgs::MeshVertexTexCoords& tex_coords = mesh_materials.vertex_tex_coords[i];
+        tex_coords.u = (placement.x + padding + tex_coords.u * image.width) / page.width;
+        tex_coords.v = (placement.y + padding + tex_coords.v * image.height) / page.height;
+    }
+
+    for (auto& material : mesh_materials.materials)
+    {
+        if (material.has_texture && material.texture_index < textures.size())
+        {
+            material.texture_index = static_cast<uint32_t>(placements[material.texture_index].page);
+        }
+    }
+
+    std::vector<mesh_msgs::MeshTexture> page_textures(pages.size());
+    for (size_t p = 0; p < pages.size(); p++)
+    {
+        const cv::Mat& image = page_images[p];
+        mesh_msgs::MeshTexture& texture = page_textures[p];
+        texture.uuid = textures[0].uuid;
+        texture.texture_index = static_cast<uint32_t>(p);
+        texture.image.height = image.rows;
+        texture.image.width = image.cols;
+        texture.image.encoding = encoding;
+        texture.image.is_bigendian = 0;
+        texture.image.step = static_cast<uint32_t>(image.step);
+        texture.image.data.assign(image.data, image.data + image.step * image.rows);
+    }
+    textures.swap(page_textures);
+    return true;
+}
+
+std::vector<mesh_msgs::MeshTexture> createTextureMipmaps(const mesh_msgs::MeshTexture& texture)
+{
+    std::vector<mesh_msgs::MeshTexture> levels;
+    if (imageType(texture.image.encoding) < 0)
+    {
+        ROS_ERROR_STREAM("Texture encoding \"" << texture.image.encoding << "\" is not supported for mipmaps!");
+        return levels;
+    }
+
+    cv::Mat previous = imageMat(texture.image);
+    while (previous.cols > 1 || previous.rows > 1)
+    {
+        // Halving with INTER_AREA uses the vectorized box filter of OpenCV
+        cv::Mat level;
+        cv::resize(previous, level, cv::Size((previous.cols + 1) / 2, (previous.rows + 1) / 2), 0, 0, cv::INTER_AREA);
+
+        levels.emplace_back();
+        mesh_msgs::MeshTexture& level_texture = levels.back();
+        level_texture.uuid = texture.uuid;
+        level_texture.texture_index = texture.texture_index;
+        level_texture.image.header = texture.image.header;
+        level_texture.image.height = level.rows;
+        level_texture.image.width = level.cols;
+        level_texture.image.encoding = texture.image.encoding;
+        level_texture.image.is_bigendian = 0;
+        level_texture.image.step = static_cast<uint32_t>(level.cols * level.elemSize());
+        level_texture.image.data.resize(level_texture.image.step * level.rows);
+        for (int row = 0; row < level.rows; row++)
+        {
+            std::copy(
+                level.ptr(row),
+                level.ptr(row) + level_texture.image.step,
+                level_texture.image.data.begin() + row * level_texture.image.step
+            );
+        }
+        previous = imageMat(level_texture.image);
+    }
+    return levels;
+}
+
+bool compressTexture(
+    const mesh_msgs::MeshTexture& texture,
+    const std::string& format,
+    int quality,
+    sensor_msgs::CompressedImage& image
+)
+{
+    const std::string& encoding = texture.image.encoding;
+    if (imageType(encoding) < 0)
+    {
+        ROS_ERROR_STREAM("Texture encoding \"" << encoding << "\" can not be compressed!");
+        return false;
+    }
+
+    std::string extension;
+    std::vector<int> params;
+    if (format == "png")
+    {
+        extension = ".png";
+        params = {cv::IMWRITE_PNG_COMPRESSION, std::min(std::max(quality, 0), 9)};
+    }
+    else if (format == "jpeg")
+    {
+        extension = ".jpg";
+        params = {cv::IMWRITE_JPEG_QUALITY, std::min(std::max(quality, 1), 100)};
+    }
+    else if (format == "webp")
+    {
+        extension = ".webp";
+        params = {cv::IMWRITE_WEBP_QUALITY, std::min(std::max(quality, 1), 100)};
+    }
+    else
+    {
+        ROS_ERROR_STREAM("Unknown texture format \"" << format << "\", use png, jpeg or webp!");
+        return false;
+    }
+
+    // OpenCV expects BGR(A) channel order, jpeg has no alpha channel
+    const cv::Mat source = imageMat(texture.image);
+    cv::Mat converted;
+    if (encoding == "rgb8")
+    {
+        cv::cvtColor(source, converted, cv::COLOR_RGB2BGR);
+    }
+    else if (encoding == "rgba8")
+    {
+        cv::cvtColor(source, converted, format == "jpeg" ? cv::COLOR_RGBA2BGR : cv::COLOR_RGBA2BGRA);
+    }
+    else if (encoding == "bgra8" && format == "jpeg")
+    {
+        cv::cvtColor(source, converted, cv::COLOR_BGRA2BGR);
+    }
+    else
+    {
+        converted = source;
+    }
+
+    std::vector<uint8_t> data;
+    if (!cv::imencode(extension, converted, data, params))
+    {
+        ROS_ERROR_STREAM("Could not encode texture " << texture.texture_index << " as " << format << "!");
+        return false;
+    }
+
+    image.header = texture.image.header;
+    image.format = format;
+    image.data.swap(data);
+    return true;
+}
+
+} // namespace lvr_ros
@@ -0,0 +1,222 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * trace.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+#include "lvr_ros/trace.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <ros/console.h>
+
+namespace lvr_ros
+{
+
+/// Recordings are bounded, later spans are counted but dropped
+static const size_t MAX_TRACE_EVENTS = 1 << 20;
+
+struct TraceEvent
+{
+    const char* name;
+    std::string args;
+    int64_t start;
+    int64_t duration;
+    long thread;
+};
+
+static std::atomic<bool> tracing(false);
+static std::mutex trace_mutex;
+static std::string trace_filename;
+static std::vector<TraceEvent> trace_events;
+static size_t num_dropped_events = 0;
+
+static int64_t traceClock()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+static long threadId()
+{
+    static thread_local const long id = syscall(SYS_gettid);
+    return id;
+}
+
+/// Writes the events and clears them, expects the trace mutex to be held
+static bool writeTrace()
+{
+    std::ofstream file(trace_filename);
+    if (!file)
+    {
+        ROS_ERROR_STREAM("Could not write the trace file \"" << trace_filename << "\"!");
+        trace_events.clear();
+        return false;
+    }
+
+    const long process = getpid();
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    file << "{\"ph\": \"M\", \"name\": \"process_name\", \"pid\": " << process
+        << ", \"tid\": 0, \"args\": {\"name\": \"lvr_ros\"}}";
+    for (const TraceEvent& event : trace_events)
+    {
+        file << ",\n{\"ph\": \"X\", \"name\": ";
+        file << jsonString(event.name);
+        file << ", \"pid\": " << process << ", \"tid\": " << event.thread
+            << ", \"ts\": " << event.start << ", \"dur\": " << event.duration
+            << ", \"args\": {" << event.args << "}}";
+    }
+    file << "\n]}\n";
+
+    ROS_INFO_STREAM("Wrote " << trace_events.size() << " spans to \"" << trace_filename << "\".");
+    if (num_dropped_events > 0)
+    {
+        ROS_WARN_STREAM("Dropped " << num_dropped_events << " spans beyond the trace limit.");
+    }
+    trace_events.clear();
+    return static_cast<bool>(file);
+}
+
+bool startTrace(const std::string& filename)
+{
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    bool success = true;
+    if (tracing)
+    {
+        success = writeTrace();
+    }
+    trace_filename = filename;
+    num_dropped_events = 0;
+    tracing = true;
+    ROS_INFO_STREAM("Recording trace for \"" << filename << "\".");
+    return success;
+}
+
+bool stopTrace()
+{
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (!tracing)
+    {
+        return true;
+    }
+    tracing = false;
+    return writeTrace();
+}
+
+bool isTracing()
+{
+    return tracing.load(std::memory_order_relaxed);
+}
+
+TraceSpan::TraceSpan(const char* name)
+    : name(name), active(isTracing()), start(active ? traceClock() : 0)
+{
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (!active || !isTracing())
+    {
+        return;
+    }
+    TraceEvent event{name, std::move(args), start, traceClock() - start, threadId()};
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (trace_events.size() < MAX_TRACE_EVENTS)
+    {
+        trace_events.push_back(std::move(event));
+    }
+    else
+    {
+        num_dropped_events++;
+    }
+}
+
+void TraceSpan::arg(const char* key, const std::string& value)
+{
+    if (!active)
+    {
+        return;
+    }
+    appendArg(key, jsonString(value));
+}
+
+void TraceSpan::arg(const char* key, double value)
+{
+    if (!active)
+    {
+        return;
+    }
+    // JSON has no literals for them, chrome://tracing and Perfetto would reject the whole file
+    if (std::isnan(value))
+    {
+        appendArg(key, "\"NaN\"");
+        return;
+    }
+    if (std::isinf(value))
+    {
+        appendArg(key, value > 0 ? "\"Infinity\"" : "\"-Infinity\"");
+        return;
+    }
+    std::ostringstream json;
+    json << value;
+    appendArg(key, json.str());
+}
+
+void TraceSpan::appendArg(const char* key, const std::string& json_value)
+{
+    args += (args.empty() ? "" : ", ") + jsonString(key) + ": " + json_value;
+}
+
+std::string jsonString(const std::string& text)
+{
+    std::ostringstream json;
+    json << '"';
+    for (const char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            json << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            json << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+        }
+        else
+        {
+            json << c;
+        }
+    }
+    json << '"';
+    return json.str();
+}
+
+} // namespace lvr_ros
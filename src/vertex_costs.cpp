@@ -0,0 +1,325 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * vertex_costs.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#include "lvr_ros/vertex_costs.h"
+#include "lvr_ros/trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include <ros/console.h>
+
+namespace lvr_ros
+{
+
+static const char* const VERTEX_COST_LAYERS[] = {"slope", "roughness", "height_diff", "border"};
+
+static bool isVertexCostLayer(const std::string& layer)
+{
+    return std::find(std::begin(VERTEX_COST_LAYERS), std::end(VERTEX_COST_LAYERS), layer)
+        != std::end(VERTEX_COST_LAYERS);
+}
+
+std::vector<std::string> parseVertexCostLayers(const std::string& layers)
+{
+    std::vector<std::string> result;
+    std::stringstream stream(layers);
+    std::string layer;
+    while (std::getline(stream, layer, ','))
+    {
+        layer.erase(0, layer.find_first_not_of(" \t"));
+        layer.erase(layer.find_last_not_of(" \t") + 1);
+        if (layer.empty())
+        {
+            continue;
+        }
+        if (!isVertexCostLayer(layer))
+        {
+            ROS_WARN_STREAM("Unknown vertex cost layer \"" << layer << "\"!");
+            continue;
+        }
+        result.push_back(layer);
+    }
+    return result;
+}
+
+/// Edges of every vertex in compressed rows, with one entry per adjacent face
+struct VertexAdjacency
+{
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> neighbors;
+};
+
+static void buildVertexAdjacency(const mesh_msgs::MeshGeometry& mesh_geometry, VertexAdjacency& adjacency)
+{
+    const size_t num_vertices = mesh_geometry.vertices.size();
+    adjacency.offsets.assign(num_vertices + 1, 0);
+    for (const auto& face : mesh_geometry.faces)
+    {
+        for (const uint32_t index : face.vertex_indices)
+        {
+            adjacency.offsets[index + 1] += 2;
+        }
+    }
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        adjacency.offsets[i + 1] += adjacency.offsets[i];
+    }
+
+    adjacency.neighbors.resize(adjacency.offsets.back());
+    std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (const auto& face : mesh_geometry.faces)
+    {
+        const auto& indices = face.vertex_indices;
+        for (int k = 0; k < 3; k++)
+        {
+            const uint32_t index = indices[k];
+            adjacency.neighbors[fill[index]++] = indices[(k + 1) % 3];
+            adjacency.neighbors[fill[index]++] = indices[(k + 2) % 3];
+        }
+    }
+
+    #pragma omp parallel for
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        std::sort(
+            adjacency.neighbors.begin() + adjacency.offsets[i],
+            adjacency.neighbors.begin() + adjacency.offsets[i + 1]
+        );
+    }
+}
+
+static bool hasValidFaces(const mesh_msgs::MeshGeometry& mesh_geometry)
+{
+    const size_t num_vertices = mesh_geometry.vertices.size();
+    for (const auto& face : mesh_geometry.faces)
+    {
+        for (const uint32_t index : face.vertex_indices)
+        {
+            if (index >= num_vertices)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void computeVertexNormals(const mesh_msgs::MeshGeometry& mesh_geometry, std::vector<float>& normals)
+{
+    const auto& vertices = mesh_geometry.vertices;
+    const size_t num_vertices = vertices.size();
+    normals.assign(num_vertices * 3, 0.0f);
+
+    if (mesh_geometry.vertex_normals.size() == num_vertices)
+    {
+        for (size_t i = 0; i < num_vertices; i++)
+        {
+            normals[3 * i + 0] = mesh_geometry.vertex_normals[i].x;
+            normals[3 * i + 1] = mesh_geometry.vertex_normals[i].y;
+            normals[3 * i + 2] = mesh_geometry.vertex_normals[i].z;
+        }
+    }
+    else
+    {
+        // The cross product weights every face normal with the face area
+        for (const auto& face : mesh_geometry.faces)
+        {
+            const auto& a = vertices[face.vertex_indices[0]];
+            const auto& b = vertices[face.vertex_indices[1]];
+            const auto& c = vertices[face.vertex_indices[2]];
+            const double ux = b.x - a.x, uy = b.y - a.y, uz = b.z - a.z;
+            const double vx = c.x - a.x, vy = c.y - a.y, vz = c.z - a.z;
+            const double nx = uy * vz - uz * vy;
+            const double ny = uz * vx - ux * vz;
+            const double nz = ux * vy - uy * vx;
+            for (const uint32_t index : face.vertex_indices)
+            {
+                normals[3 * index + 0] += nx;
+                normals[3 * index + 1] += ny;
+                normals[3 * index + 2] += nz;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        float* normal = &normals[3 * i];
+        const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (length > 0)
+        {
+            normal[0] /= length;
+            normal[1] /= length;
+            normal[2] /= length;
+        }
+    }
+}
+
+static inline float normalAngle(const float* a, const float* b)
+{
+    const float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    return std::acos(std::min(std::max(dot, -1.0f), 1.0f));
+}
+
+bool computeVertexCosts(
+    const mesh_msgs::MeshGeometry& mesh_geometry,
+    const std::string& layer,
+    double radius,
+    std::vector<float>& costs
+)
+{
+    if (!isVertexCostLayer(layer))
+    {
+        return false;
+    }
+
+    const auto& vertices = mesh_geometry.vertices;
+    const size_t num_vertices = vertices.size();
+    LVR_ROS_TRACE_SPAN(span, "vertex_costs");
+    LVR_ROS_TRACE_ARG(span, "layer", layer);
+    LVR_ROS_TRACE_ARG(span, "vertices", num_vertices);
+    costs.assign(num_vertices, 0.0f);
+    if (!hasValidFaces(mesh_geometry))
+    {
+        ROS_ERROR_STREAM("Could not compute the vertex costs \"" << layer << "\", the mesh has invalid faces!");
+        costs.clear();
+        return false;
+    }
+
+    if (layer == "slope")
+    {
+        std::vector<float> normals;
+        computeVertexNormals(mesh_geometry, normals);
+        #pragma omp parallel for
+        for (size_t i = 0; i < num_vertices; i++)
+        {
+            costs[i] = std::acos(std::min(std::max(normals[3 * i + 2], -1.0f), 1.0f));
+        }
+        return true;
+    }
+
+    VertexAdjacency adjacency;
+    buildVertexAdjacency(mesh_geometry, adjacency);
+
+    if (layer == "border")
+    {
+        // An edge which belongs to only one face occurs once in the sorted neighbors of its vertices
+        #pragma omp parallel for
+        for (size_t i = 0; i < num_vertices; i++)
+        {
+            const uint32_t begin = adjacency.offsets[i];
+            const uint32_t end = adjacency.offsets[i + 1];
+            for (uint32_t j = begin; j < end; )
+            {
+                uint32_t k = j + 1;
+                while (k < end && adjacency.neighbors[k] == adjacency.neighbors[j])
+                {
+                    k++;
+                }
+                if (k - j == 1)
+                {
+                    costs[i] = 1.0f;
+                    break;
+                }
+                j = k;
+            }
+        }
+        return true;
+    }
+
+    std::vector<float> normals;
+    if (layer == "roughness")
+    {
+        computeVertexNormals(mesh_geometry, normals);
+    }
+    const bool roughness = !normals.empty();
+    const double squared_radius = radius * radius;
+
+    #pragma omp parallel
+    {
+        LVR_ROS_TRACE_SPAN(thread_span, "vertex_costs_thread");
+
+        // Every thread marks the visited vertices with the index of the current vertex plus one
+        std::vector<uint32_t> visited(num_vertices, 0);
+        std::vector<uint32_t> queue;
+
+        #pragma omp for schedule(dynamic, 256)
+        for (size_t i = 0; i < num_vertices; i++)
+        {
+            const uint32_t mark = static_cast<uint32_t>(i) + 1;
+            const auto& center = vertices[i];
+            queue.clear();
+            queue.push_back(static_cast<uint32_t>(i));
+            visited[i] = mark;
+
+            double min_z = center.z;
+            double max_z = center.z;
+            double angle_sum = 0;
+            for (size_t head = 0; head < queue.size(); head++)
+            {
+                const uint32_t current = queue[head];
+                const auto& point = vertices[current];
+                min_z = std::min(min_z, point.z);
+                max_z = std::max(max_z, point.z);
+                if (roughness)
+                {
+                    angle_sum += normalAngle(&normals[3 * i], &normals[3 * current]);
+                }
+
+                for (uint32_t j = adjacency.offsets[current]; j < adjacency.offsets[current + 1]; j++)
+                {
+                    const uint32_t neighbor = adjacency.neighbors[j];
+                    if (visited[neighbor] == mark)
+                    {
+                        continue;
+                    }
+                    visited[neighbor] = mark;
+
+                    const auto& other = vertices[neighbor];
+                    const double dx = other.x - center.x;
+                    const double dy = other.y - center.y;
+                    const double dz = other.z - center.z;
+                    if (dx * dx + dy * dy + dz * dz <= squared_radius)
+                    {
+                        queue.push_back(neighbor);
+                    }
+                }
+            }
+
+            if (roughness)
+            {
+                costs[i] = static_cast<float>(angle_sum / queue.size());
+            }
+            else
+            {
+                costs[i] = static_cast<float>(max_z - min_z);
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace lvr_ros
@@ -0,0 +1,185 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * vertex_welding.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#include "lvr_ros/vertex_welding.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace lvr_ros
+{
+
+/// Quantized position and raw attribute bits of a vertex, the index breaks ties
+struct WeldKey
+{
+    std::array<int64_t, 3> cell;
+    std::array<uint32_t, 3> attributes;
+    uint32_t index;
+
+    bool sameVertex(const WeldKey& other) const
+    {
+        return cell == other.cell && attributes == other.attributes;
+    }
+
+    bool operator<(const WeldKey& other) const
+    {
+        if (cell != other.cell)
+        {
+            return cell < other.cell;
+        }
+        if (attributes != other.attributes)
+        {
+            return attributes < other.attributes;
+        }
+        return index < other.index;
+    }
+};
+
+static inline uint32_t floatBits(float value)
+{
+    // Positive and negative zero are equal
+    if (value == 0)
+    {
+        value = 0;
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline int64_t quantize(float value, double inv_epsilon)
+{
+    if (inv_epsilon > 0)
+    {
+        return static_cast<int64_t>(std::llround(value * inv_epsilon));
+    }
+    return floatBits(value);
+}
+
+/// Sorts blocks in parallel and merges them pairwise in parallel rounds
+template<typename T>
+static void parallelSort(std::vector<T>& values)
+{
+    const size_t block_size = 1 << 16;
+    const size_t size = values.size();
+    if (size <= block_size)
+    {
+        std::sort(values.begin(), values.end());
+        return;
+    }
+
+    const size_t num_blocks = (size + block_size - 1) / block_size;
+    #pragma omp parallel for
+    for (size_t block = 0; block < num_blocks; block++)
+    {
+        std::sort(values.begin() + block * block_size, values.begin() + std::min(size, (block + 1) * block_size));
+    }
+
+    for (size_t width = block_size; width < size; width *= 2)
+    {
+        const size_t num_merges = (size + 2 * width - 1) / (2 * width);
+        #pragma omp parallel for
+        for (size_t merge = 0; merge < num_merges; merge++)
+        {
+            const size_t begin = merge * 2 * width;
+            const size_t middle = std::min(size, begin + width);
+            const size_t end = std::min(size, begin + 2 * width);
+            std::inplace_merge(values.begin() + begin, values.begin() + middle, values.begin() + end);
+        }
+    }
+}
+
+size_t weldVertices(
+    const float* positions,
+    size_t num_vertices,
+    float epsilon,
+    const float* attributes,
+    unsigned attribute_width,
+    std::vector<uint32_t>& remap,
+    std::vector<uint32_t>& kept
+)
+{
+    const double inv_epsilon = epsilon > 0 ? 1.0 / epsilon : 0;
+    attribute_width = attributes ? std::min(attribute_width, 3u) : 0;
+
+    std::vector<WeldKey> keys(num_vertices);
+    #pragma omp parallel for
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        WeldKey& key = keys[i];
+        for (int k = 0; k < 3; k++)
+        {
+            key.cell[k] = quantize(positions[3 * i + k], inv_epsilon);
+        }
+        key.attributes.fill(0);
+        for (unsigned k = 0; k < attribute_width; k++)
+        {
+            key.attributes[k] = floatBits(attributes[attribute_width * i + k]);
+        }
+        key.index = static_cast<uint32_t>(i);
+    }
+    parallelSort(keys);
+
+    // The first key of every group has the lowest index, all vertices of the group point to it
+    std::vector<uint32_t> representative(num_vertices);
+    std::vector<uint8_t> is_kept(num_vertices, 0);
+    size_t group_begin = 0;
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        if (!keys[i].sameVertex(keys[group_begin]))
+        {
+            group_begin = i;
+        }
+        representative[keys[i].index] = keys[group_begin].index;
+        if (i == group_begin)
+        {
+            is_kept[keys[i].index] = 1;
+        }
+    }
+
+    kept.clear();
+    std::vector<uint32_t> new_index(num_vertices, std::numeric_limits<uint32_t>::max());
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        if (is_kept[i])
+        {
+            new_index[i] = static_cast<uint32_t>(kept.size());
+            kept.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    remap.resize(num_vertices);
+    #pragma omp parallel for
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        remap[i] = new_index[representative[i]];
+    }
+    return kept.size();
+}
+
+} // namespace lvr_ros
@@ -0,0 +1,141 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * voxel_occupancy.cpp
+ *
+ * Author: Sebastian Pütz <spuetz@uos.de>
+ *
+ */
+
+
+#include "lvr_ros/voxel_occupancy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace lvr_ros
+{
+
+/// Voxels per axis of the finest level as power of two, 3 * 20 bits fit into a Morton code
+static const int OCCUPANCY_LEVELS = 20;
+
+/// Faces marching cubes creates on average in a voxel the surface passes through
+static const double FACES_PER_VOXEL = 2.0;
+
+/// Spreads the lower 21 bits of the value to every third bit
+static inline uint64_t spreadBits(uint64_t value)
+{
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffffULL;
+    value = (value | value << 16) & 0x1f0000ff0000ffULL;
+    value = (value | value << 8) & 0x100f00f00f00f00fULL;
+    value = (value | value << 4) & 0x10c30c30c30c30c3ULL;
+    value = (value | value << 2) & 0x1249249249249249ULL;
+    return value;
+}
+
+void computeVoxelOccupancy(const float* points, size_t num_points, VoxelOccupancy& occupancy)
+{
+    occupancy.occupied.clear();
+    float min[3], max[3];
+    std::fill(min, min + 3, std::numeric_limits<float>::max());
+    std::fill(max, max + 3, std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < num_points; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            min[axis] = std::min(min[axis], points[3 * i + axis]);
+            max[axis] = std::max(max[axis], points[3 * i + axis]);
+        }
+    }
+    const float longest_side = num_points > 0 ? std::max({max[0] - min[0], max[1] - min[1], max[2] - min[2]}) : 0.0f;
+    const uint64_t max_index = (1u << OCCUPANCY_LEVELS) - 1;
+    occupancy.voxelsize = std::max(longest_side, std::numeric_limits<float>::min()) / (max_index + 1);
+    if (num_points == 0)
+    {
+        return;
+    }
+
+    std::vector<uint64_t> voxels(num_points);
+    #pragma omp parallel for
+    for (size_t i = 0; i < num_points; i++)
+    {
+        uint64_t code = 0;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const double index = std::floor((points[3 * i + axis] - min[axis]) / occupancy.voxelsize);
+            code |= spreadBits(std::min(static_cast<uint64_t>(std::max(index, 0.0)), max_index)) << axis;
+        }
+        voxels[i] = code;
+    }
+    std::sort(voxels.begin(), voxels.end());
+    voxels.erase(std::unique(voxels.begin(), voxels.end()), voxels.end());
+
+    // The parents of sorted voxels are sorted as well
+    occupancy.occupied.push_back(voxels.size());
+    for (int level = 1; level <= OCCUPANCY_LEVELS; level++)
+    {
+        for (uint64_t& voxel : voxels)
+        {
+            voxel >>= 3;
+        }
+        voxels.erase(std::unique(voxels.begin(), voxels.end()), voxels.end());
+        occupancy.occupied.push_back(voxels.size());
+    }
+}
+
+float voxelsizeForOccupiedVoxels(const VoxelOccupancy& occupancy, size_t num_points, double occupied_voxels)
+{
+    if (occupancy.occupied.empty())
+    {
+        return occupancy.voxelsize;
+    }
+
+    // The finest level with at least two points per voxel, and the first level within the target
+    size_t finest = 0;
+    while (finest + 1 < occupancy.occupied.size() && occupancy.occupied[finest] * 2 > num_points)
+    {
+        finest++;
+    }
+    size_t level = finest;
+    while (level + 1 < occupancy.occupied.size() && occupancy.occupied[level] > occupied_voxels)
+    {
+        level++;
+    }
+    if (level == finest || occupancy.occupied[level] > occupied_voxels)
+    {
+        return occupancy.voxelsize * std::ldexp(1.0f, static_cast<int>(level));
+    }
+
+    // The number of voxels on a surface falls by about a factor of four per level
+    const double finer = std::log(static_cast<double>(occupancy.occupied[level - 1]));
+    const double coarser = std::log(static_cast<double>(occupancy.occupied[level]));
+    const double t = finer > coarser ? (finer - std::log(std::max(occupied_voxels, 1.0))) / (finer - coarser) : 1.0;
+    return occupancy.voxelsize * std::pow(2.0f, static_cast<float>(level - 1 + std::min(std::max(t, 0.0), 1.0)));
+}
+
+float voxelsizeForTargetFaces(const float* points, size_t num_points, size_t target_faces)
+{
+    VoxelOccupancy occupancy;
+    computeVoxelOccupancy(points, num_points, occupancy);
+    return voxelsizeForOccupiedVoxels(occupancy, num_points, target_faces / FACES_PER_VOXEL);
+}
+
+} // namespace lvr_ros